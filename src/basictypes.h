@@ -63,5 +63,14 @@ typedef uint32_t			angle_t;
 #define GCCNOWARN
 #endif
 
+// Compiles a single function for AVX2 without enabling it for the rest of the
+// file, so that inline code shared with other files cannot pick up AVX2
+// instructions. Such functions may only run after CheckCPUID found AVX2.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64))
+#define AVX2_TARGET						__attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define AVX2_TARGET
+#endif
+
 
 #endif
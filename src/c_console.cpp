@@ -807,6 +807,13 @@ void AddToConsole (int printlevel, const char *text)
 	conbuffer->AddText(printlevel, text, Logfile);
 }
 
+static thread_local TArray<FCapturedPrint> *PrintCapture;
+
+void C_SetPrintCapture (TArray<FCapturedPrint> *capture)
+{
+	PrintCapture = capture;
+}
+
 /* Adds a string to the console and also to the notify buffer */
 int PrintString (int printlevel, const char *outline)
 {
@@ -815,6 +822,12 @@ int PrintString (int printlevel, const char *outline)
 		return 0;
 	}
 
+	if (PrintCapture != NULL)
+	{
+		PrintCapture->Push({ printlevel, outline });
+		return (int)strlen (outline);
+	}
+
 	if (printlevel != PRINT_LOG)
 	{
 		I_PrintStr (outline);
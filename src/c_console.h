@@ -36,6 +36,7 @@
 
 #include <stdarg.h>
 #include "basictypes.h"
+#include "zstring.h"
 
 struct event_t;
 
@@ -67,6 +68,16 @@ void AddToConsole (int printlevel, const char *string);
 int PrintString (int printlevel, const char *string);
 int VPrintf (int printlevel, const char *format, va_list parms) GCCFORMAT(2);
 
+// Worker threads may not touch the console. While a capture buffer is set for
+// the calling thread all its output is collected there so that the main
+// thread can print it later.
+struct FCapturedPrint
+{
+	int PrintLevel;
+	FString Text;
+};
+void C_SetPrintCapture (TArray<FCapturedPrint> *capture);
+
 void C_DrawConsole ();
 void C_ToggleConsole (void);
 void C_FullConsole (void);
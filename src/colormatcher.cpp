@@ -34,15 +34,23 @@
 ** It was, but the results were not as good as I would like, so I didn't
 ** actually use it. But I did keep the code around in case I ever felt like
 ** revisiting the problem. I never did, so now it's relegated to the mists
-** of SVN history, and this is just a thin wrapper around BestColor().
+** of SVN history.
+**
+** What it does now is split the RGB cube into 64x64x64 cells and record
+** for each of them which palette entries can possibly be the closest
+** color for anything inside the cell. Pick then only compares against
+** those few entries and always returns exactly what BestColor() would.
 **
 */
 
 #include <stdlib.h>
+#include <limits.h>
 
 #include "doomtype.h"
 #include "colormatcher.h"
 #include "v_palette.h"
+#include "templates.h"
+#include "taskgraph.h"
 
 FColorMatcher::FColorMatcher ()
 {
@@ -62,18 +70,165 @@ FColorMatcher::FColorMatcher (const FColorMatcher &other)
 FColorMatcher &FColorMatcher::operator= (const FColorMatcher &other)
 {
 	Pal = other.Pal;
+	CellStart = other.CellStart;
+	Candidates = other.Candidates;
 	return *this;
 }
 
 void FColorMatcher::SetPalette (const uint32_t *palette)
 {
 	Pal = (const PalEntry *)palette;
+	BuildCells ();
 }
 
-uint8_t FColorMatcher::Pick (int r, int g, int b)
+uint8_t FColorMatcher::PickExact (int r, int g, int b)
 {
 	if (Pal == NULL)
 		return 1;
 
 	return (uint8_t)BestColor ((uint32_t *)Pal, r, g, b);
 }
+
+uint8_t FColorMatcher::Pick (int r, int g, int b)
+{
+	if (CellStart.Size() == 0 || ((r | g | b) & ~255))
+		return PickExact (r, g, b);
+
+	int cell = ((r >> 2) << 12) | ((g >> 2) << 6) | (b >> 2);
+	const uint8_t *cand = &Candidates[0] + CellStart[cell];
+	const uint8_t *end = &Candidates[0] + CellStart[cell + 1];
+
+	// The candidates are sorted, so keeping the first of several equally
+	// close colors gives the same result as BestColor.
+	int bestcolor = *cand;
+	int bestdist = INT_MAX;
+	for (; cand < end; ++cand)
+	{
+		int x = r - Pal[*cand].r;
+		int y = g - Pal[*cand].g;
+		int z = b - Pal[*cand].b;
+		int dist = x*x + y*y + z*z;
+		if (dist < bestdist)
+		{
+			bestdist = dist;
+			bestcolor = *cand;
+		}
+	}
+	return (uint8_t)bestcolor;
+}
+
+//==========================================================================
+//
+// Squared distances from a color to the nearest and the farthest point of
+// the box [lo, lo+size) on every axis.
+//
+//==========================================================================
+
+static inline int AxisMin (int v, int lo, int size)
+{
+	int d = v < lo ? lo - v : v >= lo + size ? v - (lo + size - 1) : 0;
+	return d * d;
+}
+
+static inline int AxisMax (int v, int lo, int size)
+{
+	int d = MAX(abs(v - lo), abs(v - (lo + size - 1)));
+	return d * d;
+}
+
+static void BoxDistances (const PalEntry &pe, int r, int g, int b, int size, int &mindist, int &maxdist)
+{
+	mindist = AxisMin (pe.r, r, size) + AxisMin (pe.g, g, size) + AxisMin (pe.b, b, size);
+	maxdist = AxisMax (pe.r, r, size) + AxisMax (pe.g, g, size) + AxisMax (pe.b, b, size);
+}
+
+//==========================================================================
+//
+// An entry can only be the closest color for a point in a box if it is
+// not farther away than the farthest point of the box is from some other
+// entry. Entries are filtered like this first for 16x16x16 cells and then
+// for the 4x4x4 cells inside them.
+//
+//==========================================================================
+
+static void FilterCandidates (const PalEntry *pal, const uint8_t *in, int count, int r, int g, int b, int size, TArray<uint8_t> &out)
+{
+	int mindist[256];
+	int limit = INT_MAX;
+
+	for (int i = 0; i < count; i++)
+	{
+		int maxdist;
+		BoxDistances (pal[in[i]], r, g, b, size, mindist[i], maxdist);
+		limit = MIN(limit, maxdist);
+	}
+	for (int i = 0; i < count; i++)
+	{
+		if (mindist[i] <= limit)
+		{
+			out.Push (in[i]);
+		}
+	}
+}
+
+void FColorMatcher::BuildCells ()
+{
+	CellStart.Clear ();
+	Candidates.Clear ();
+	if (Pal == NULL)
+		return;
+
+	// Same range BestColor searches by default.
+	uint8_t all[254];
+	for (int i = 0; i < 254; i++)
+	{
+		all[i] = i + 1;
+	}
+
+	CellStart.Resize (64*64*64 + 1);
+
+	// One task for each slab of 16 red values, which covers 4 red cells.
+	TArray<uint8_t> slabs[16];
+	FTaskGraph tasks;
+	for (int slab = 0; slab < 16; slab++)
+	{
+		tasks.AddTask ("color matcher", [=, &slabs, &all]()
+		{
+			TArray<uint8_t> coarse[16][16];
+			for (int g = 0; g < 16; g++)
+			{
+				for (int b = 0; b < 16; b++)
+				{
+					FilterCandidates (Pal, all, 254, slab * 16, g * 16, b * 16, 16, coarse[g][b]);
+				}
+			}
+
+			TArray<uint8_t> &out = slabs[slab];
+			for (int r = slab * 4; r < slab * 4 + 4; r++)
+			{
+				for (int g = 0; g < 64; g++)
+				{
+					for (int b = 0; b < 64; b++)
+					{
+						const TArray<uint8_t> &in = coarse[g >> 2][b >> 2];
+						CellStart[(r << 12) | (g << 6) | b] = out.Size();
+						FilterCandidates (Pal, &in[0], in.Size(), r * 4, g * 4, b * 4, 4, out);
+					}
+				}
+			}
+		});
+	}
+	tasks.Run ();
+
+	unsigned base = 0;
+	for (int slab = 0; slab < 16; slab++)
+	{
+		for (int cell = slab << 14; cell < (slab + 1) << 14; cell++)
+		{
+			CellStart[cell] += base;
+		}
+		Candidates.Append (slabs[slab]);
+		base += slabs[slab].Size();
+	}
+	CellStart[64*64*64] = base;
+}
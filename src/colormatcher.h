@@ -34,6 +34,8 @@
 #ifndef __COLORMATCHER_H__
 #define __COLORMATCHER_H__
 
+#include "tarray.h"
+
 class FColorMatcher
 {
 public:
@@ -47,11 +49,19 @@ public:
 	{
 		return Pick(pe.r, pe.g, pe.b);
 	}
+	uint8_t PickExact (int r, int g, int b);
 
 	FColorMatcher &operator= (const FColorMatcher &other);
 
 private:
+	void BuildCells ();
+
 	const PalEntry *Pal;
+
+	// For every RGB666 cell the palette entries that can be the closest
+	// color of some RGB value in it, so Pick only has to check those.
+	TArray<uint32_t> CellStart;
+	TArray<uint8_t> Candidates;
 };
 
 extern FColorMatcher ColorMatcher;
@@ -97,6 +97,8 @@
 #include "vm.h"
 #include "types.h"
 #include "r_data/r_vanillatrans.h"
+#include "d_profile.h"
+#include "taskgraph.h"
 
 EXTERN_CVAR(Bool, hud_althud)
 void DrawHUD();
@@ -215,6 +217,7 @@ bool singletics = false;	// debug flag to cancel adaptiveness
 FString startmap;
 bool autostart;
 FString StoredWarp;
+static FString RenderBench;
 bool advancedemo;
 FILE *debugfile;
 FILE *hashfile;
@@ -2207,6 +2210,26 @@ static void CheckCmdLine()
 		}
 	}
 
+	// -renderbench map x y z angle starts the map, benchmarks the view from
+	// the given position and exits. See the renderbench command. It never
+	// opens a window, so there is no game to fall back to if this fails.
+	p = Args->CheckParm("-renderbench");
+	if (p)
+	{
+		if (p >= Args->NumArgs() - 5)
+		{
+			I_FatalError("Usage: -renderbench <map> <x> <y> <z> <angle>");
+		}
+		const char *benchmap = Args->GetArg(p + 1);
+		if (!P_CheckMapData(benchmap))
+		{
+			I_FatalError("Can't find map %s", benchmap);
+		}
+		startmap = benchmap;
+		autostart = true;
+		RenderBench.Format("renderbench %s %s %s %s quit", Args->GetArg(p + 2), Args->GetArg(p + 3), Args->GetArg(p + 4), Args->GetArg(p + 5));
+	}
+
 	if (devparm)
 	{
 		Printf ("%s", GStrings("D_DEVSTR"));
@@ -2311,6 +2334,13 @@ void D_DoomMain (void)
 
 	if (!batchrun) Printf(PRINT_LOG, "%s version %s\n", GAMENAME, GetVersionString());
 
+	v = Args->CheckValue("-tracestartup");
+	if (v != NULL)
+	{
+		D_StartProfile(v);
+		atterm(D_WriteProfile);
+	}
+
 	D_DoomInit();
 
 	extern void D_ConfirmSendStats();
@@ -2336,6 +2366,8 @@ void D_DoomMain (void)
 
 	do
 	{
+		FProfileScope startup(restart ? "Restart" : "Startup");
+		FProfileScope phase("PClass::StaticInit");
 		PClass::StaticInit();
 		PType::StaticInit();
 
@@ -2405,6 +2437,7 @@ void D_DoomMain (void)
 			Printf("Notice: File hashing is incredibly verbose. Expect loading files to take much longer than usual.\n");
 		}
 
+		phase.Next("W_Init");
 		if (!batchrun) Printf ("W_Init: Init WADfiles.\n");
 		Wads.InitMultipleFiles (allwads);
 		allwads.Clear();
@@ -2413,6 +2446,7 @@ void D_DoomMain (void)
 
 		GameConfig->DoKeySetup(gameinfo.ConfigName);
 
+		phase.Next("ParseCVarInfo");
 		// Now that wads are loaded, define mod-specific cvars.
 		ParseCVarInfo();
 
@@ -2424,28 +2458,69 @@ void D_DoomMain (void)
 			exec = NULL;
 		}
 
-		// [RH] Initialize localizable strings.
-		GStrings.LoadStrings (false);
+		phase.End();
+		{
+			// The LANGUAGE lumps get parsed on a worker thread while the
+			// main thread sets up the video system, which has to stay there.
+			//
+			// The other definition lumps stay on the main thread below, because
+			// each of them depends on state set up by an earlier one:
+			// - SNDINFO needs S_Init and fills the global sound table that
+			//   MAPINFO, TERRAIN and the actor defaults look sounds up in.
+			// - Textures register in TexMan, which fonts, GLDEFS, DECALDEF
+			//   and TERRAIN all look up, so it has to finish before them.
+			// - Fonts also create the translation tables used by the console.
+			// - GLDEFS and DECALDEF attach their definitions to actor classes,
+			//   so they need PClassActor::StaticInit.
+			// - TERRAIN is only parsed by P_Init, after all of the above.
+			// - KEYCONF executes console commands and sets CVars.
+			//
+			// The only MD5s computed at startup are for NERVE.WAD and the Mac
+			// Hexen IWAD, inside W_Init. They are skipped unless the file size
+			// already matches, so there is nothing to gain there.
+			FTaskGraph tasks;
+
+			// [RH] Initialize localizable strings.
+			int readlang = tasks.AddTask("ReadLanguageLumps", []()
+			{
+				SetLanguageIDs ();
+				GStrings.ReadLanguageLumps ();
+			}, {}, FTaskGraph::MainThread);
+			tasks.AddTask("ParseLanguageLumps", []() { GStrings.ParseLanguageLumps (false); }, { readlang });
+
+			int fontcolors = tasks.AddTask("V_InitFontColors", []()
+			{
+				V_InitFontColors ();
 
-		V_InitFontColors ();
+				// [RH] Moved these up here so that we can do most of our
+				//		startup output in a fullscreen console.
 
-		// [RH] Moved these up here so that we can do most of our
-		//		startup output in a fullscreen console.
+				CT_Init ();
+			}, {}, FTaskGraph::MainThread);
 
-		CT_Init ();
+			int iinit = tasks.AddTask("I_Init", []()
+			{
+				if (!restart)
+				{
+					if (!batchrun) Printf ("I_Init: Setting up machine state.\n");
+					I_Init ();
+				}
+			}, { fontcolors }, FTaskGraph::MainThread);
 
-		if (!restart)
-		{
-			if (!batchrun) Printf ("I_Init: Setting up machine state.\n");
-			I_Init ();
-		}
+			tasks.AddTask("V_Init", []()
+			{
+				if (!batchrun) Printf ("V_Init: allocate screen.\n");
+				V_Init (!!restart);
+			}, { iinit }, FTaskGraph::MainThread);
 
-		if (!batchrun) Printf ("V_Init: allocate screen.\n");
-		V_Init (!!restart);
+			tasks.Run();
+		}
 
 		// Base systems have been inited; enable cvar callbacks
+		// The language CVar is CVAR_NOINITCALL so this won't reload the strings.
 		FBaseCVar::EnableCallbacks ();
 
+		phase.Next("S_Init");
 		if (!batchrun) Printf ("S_Init: Setting up sound.\n");
 		S_Init ();
 
@@ -2459,42 +2534,53 @@ void D_DoomMain (void)
 			StartScreen = new FStartupScreen(0);
 		}
 
+		phase.Next("ParseCompatibility");
 		ParseCompatibility();
 
 		CheckCmdLine();
 
+		phase.Next("S_ParseReverbDef");
 		// [RH] Load sound environments
 		S_ParseReverbDef ();
 
 		// [RH] Parse any SNDINFO lumps
+		phase.Next("S_InitData");
 		if (!batchrun) Printf ("S_InitData: Load sound definitions.\n");
 		S_InitData ();
 
 		// [RH] Parse through all loaded mapinfo lumps
+		phase.Next("G_ParseMapInfo");
 		if (!batchrun) Printf ("G_ParseMapInfo: Load map definitions.\n");
 		G_ParseMapInfo (iwad_info->MapInfo);
 		ReadStatistics();
 
+		phase.Next("S_ParseMusInfo");
 		// MUSINFO must be parsed after MAPINFO
 		S_ParseMusInfo();
 
+		phase.Next("FTextureManager::Init");
 		if (!batchrun) Printf ("Texman.Init: Init texture manager.\n");
 		TexMan.Init();
 		C_InitConback();
 
 		StartScreen->Progress();
+		phase.Next("V_InitFonts");
 		V_InitFonts();
 
 		// [CW] Parse any TEAMINFO lumps.
+		phase.Next("ParseTeamInfo");
 		if (!batchrun) Printf ("ParseTeamInfo: Load team definitions.\n");
 		TeamLibrary.ParseTeamInfo ();
 
+		phase.Next("R_ParseTrnslate");
 		R_ParseTrnslate();
+		phase.Next("PClassActor::StaticInit");
 		PClassActor::StaticInit ();
 
 		// [GRB] Initialize player class list
 		SetupPlayerClasses ();
 
+		phase.Next("D_LoadWadSettings");
 		// [RH] Load custom key and weapon settings from WADs
 		D_LoadWadSettings ();
 
@@ -2506,15 +2592,19 @@ void D_DoomMain (void)
 
 		StartScreen->Progress ();
 
+		phase.Next("ParseGLDefs");
 		ParseGLDefs();
 
+		phase.Next("R_Init");
 		if (!batchrun) Printf ("R_Init: Init %s refresh subsystem.\n", gameinfo.ConfigName.GetChars());
 		StartScreen->LoadingStatus ("Loading graphics", 0x3f);
 		R_Init ();
 
+		phase.Next("FDecalLib::ReadAllDecals");
 		if (!batchrun) Printf ("DecalLibrary: Load decals.\n");
 		DecalLibrary.ReadAllDecals ();
 
+		phase.Next("Dehacked");
 		// Load embedded Dehacked patches
 		D_LoadDehLumps(FromIWAD);
 
@@ -2544,9 +2634,11 @@ void D_DoomMain (void)
 		// Create replacements for dehacked pickups
 		FinishDehPatch();
 
+		phase.Next("M_Init");
 		if (!batchrun) Printf("M_Init: Init menus.\n");
 		M_Init();
 
+		phase.Next("RemoveUnusedSymbols");
 		// clean up the compiler symbols which are not needed any longer.
 		RemoveUnusedSymbols();
 
@@ -2564,6 +2656,7 @@ void D_DoomMain (void)
 		bglobal.spawn_tries = 0;
 		bglobal.wanted_botnum = bglobal.getspawned.Size();
 
+		phase.Next("P_Init");
 		if (!batchrun) Printf ("P_Init: Init Playloop state.\n");
 		StartScreen->LoadingStatus ("Init game engine", 0x3f);
 		AM_StaticInit();
@@ -2571,6 +2664,7 @@ void D_DoomMain (void)
 
 		P_SetupWeapons_ntohton();
 
+		phase.Next("SBarInfo::Load");
 		//SBarInfo support. Note that the first SBARINFO lump contains the mugshot definition so it even needs to be read when a regular status bar is being used.
 		SBarInfo::Load();
 		HUD_InitHud();
@@ -2593,13 +2687,16 @@ void D_DoomMain (void)
 
 		if (!restart)
 		{
+			phase.Next("D_CheckNetGame");
 			if (!batchrun) Printf ("D_CheckNetGame: Checking network game status.\n");
 			StartScreen->LoadingStatus ("Checking network game status.", 0x3f);
 			D_CheckNetGame ();
 		}
 
+		phase.Next("UpdateVanillaTransparency");
 		// [SP] Force vanilla transparency auto-detection to re-detect our game lumps now
 		UpdateVanillaTransparency();
+		phase.End();
 
 		// [RH] Lock any cvars that should be locked now that we're
 		// about to begin the game.
@@ -2634,9 +2731,21 @@ void D_DoomMain (void)
 				throw CNoRunExit();
 			}
 
-			V_Init2();
-			gl_PatchMenu();	// removes unapplicable entries for old hardware. This cannot be done in MENUDEF because at the point it gets parsed it doesn't have the needed info.
+			phase.Next("V_Init2");
+			if (RenderBench.IsNotEmpty())
+			{
+				// The benchmark only renders into canvases.
+				V_InitHeadless();
+			}
+			else
+			{
+				V_Init2();
+				gl_PatchMenu();	// removes unapplicable entries for old hardware. This cannot be done in MENUDEF because at the point it gets parsed it doesn't have the needed info.
+			}
 			UpdateJoystickMenu(NULL);
+			phase.End();
+			startup.End();
+			D_WriteProfile();
 
 			v = Args->CheckValue ("-loadgame");
 			if (v)
@@ -2682,6 +2791,10 @@ void D_DoomMain (void)
 								AddCommandString(StoredWarp.LockBuffer());
 								StoredWarp = NULL;
 							}
+							if (RenderBench.IsNotEmpty())
+							{
+								AddCommandString(RenderBench.LockBuffer());
+							}
 						}
 						else
 						{
@@ -2706,6 +2819,8 @@ void D_DoomMain (void)
 			M_InitVideoModesMenu();
 			D_StartTitle ();				// start up intro loop
 			setmodeneeded = false;			// This may be set to true here, but isn't needed for a restart
+			startup.End();
+			D_WriteProfile();
 		}
 
 		D_DoAnonStats();
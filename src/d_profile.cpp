@@ -0,0 +1,183 @@
+/*
+** d_profile.cpp
+** Startup and level load phase profiler with Chrome trace output
+**
+**---------------------------------------------------------------------------
+** Copyright 2018 The GZDoom development team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Events are only collected while a trace file has been requested with
+** -tracestartup <file>. The file gets rewritten after startup and after
+** each level load so that it always contains everything recorded so far.
+**
+*/
+
+#define RAPIDJSON_48BITPOINTER_OPTIMIZATION 0
+#define RAPIDJSON_HAS_CXX11_RVALUE_REFS 1
+#define RAPIDJSON_HAS_CXX11_RANGE_FOR 1
+
+#include <mutex>
+#include <atomic>
+#include "rapidjson/rapidjson.h"
+#include "rapidjson/writer.h"
+#include "d_profile.h"
+#include "tarray.h"
+#include "zstring.h"
+#include "doomtype.h"
+#include "files.h"
+
+struct FProfileEvent
+{
+	FString Name;
+	FString Detail;
+	const char *Category;
+	uint64_t Start;
+	uint64_t End;
+	int Thread;
+};
+
+bool ProfileActive;
+
+static FString ProfileFile;
+static uint64_t ProfileBase;
+static TArray<FProfileEvent> ProfileEvents;
+static std::mutex ProfileMutex;
+static std::atomic<int> ProfileThreadCount;
+
+//==========================================================================
+//
+// Small sequential thread ids read better in the trace viewer than
+// whatever the OS hands out.
+//
+//==========================================================================
+
+static int GetProfileThread()
+{
+	static thread_local int id = -1;
+	if (id < 0) id = ProfileThreadCount++;
+	return id;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void D_StartProfile(const char *filename)
+{
+	ProfileFile = filename;
+	ProfileBase = I_nsTime();
+	ProfileActive = true;
+	GetProfileThread();	// make the calling thread #0
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void D_AddProfileEvent(const char *name, const char *category, uint64_t startns, uint64_t endns, const char *detail)
+{
+	if (!ProfileActive) return;
+
+	FProfileEvent ev;
+	ev.Name = name;
+	if (detail != nullptr) ev.Detail = detail;
+	ev.Category = category;
+	ev.Start = startns;
+	ev.End = endns;
+	ev.Thread = GetProfileThread();
+
+	std::lock_guard<std::mutex> lock(ProfileMutex);
+	ProfileEvents.Push(std::move(ev));
+}
+
+//==========================================================================
+//
+// Writes all events collected so far as complete ('X') events.
+//
+//==========================================================================
+
+void D_WriteProfile()
+{
+	if (!ProfileActive) return;
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key("traceEvents");
+	writer.StartArray();
+	{
+		std::lock_guard<std::mutex> lock(ProfileMutex);
+		for (auto &ev : ProfileEvents)
+		{
+			uint64_t start = ev.Start >= ProfileBase ? ev.Start - ProfileBase : 0;
+			uint64_t dur = ev.End >= ev.Start ? ev.End - ev.Start : 0;
+
+			writer.StartObject();
+			writer.Key("name");
+			writer.String(ev.Name.GetChars());
+			writer.Key("cat");
+			writer.String(ev.Category);
+			writer.Key("ph");
+			writer.String("X");
+			writer.Key("ts");
+			writer.Double(start / 1000.);
+			writer.Key("dur");
+			writer.Double(dur / 1000.);
+			writer.Key("pid");
+			writer.Int(1);
+			writer.Key("tid");
+			writer.Int(ev.Thread);
+			if (ev.Detail.IsNotEmpty())
+			{
+				writer.Key("args");
+				writer.StartObject();
+				writer.Key("detail");
+				writer.String(ev.Detail.GetChars());
+				writer.EndObject();
+			}
+			writer.EndObject();
+		}
+	}
+	writer.EndArray();
+	writer.Key("displayTimeUnit");
+	writer.String("ms");
+	writer.EndObject();
+
+	FileWriter *fw = FileWriter::Open(ProfileFile);
+	if (fw == nullptr)
+	{
+		Printf("Unable to write startup trace '%s'\n", ProfileFile.GetChars());
+		return;
+	}
+	fw->Write(buffer.GetString(), buffer.GetSize());
+	delete fw;
+}
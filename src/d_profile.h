@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include "i_time.h"
+#include "stats.h"
+
+// Startup and level load phase profiler. Collects timed events which are
+// written out in the Chrome trace event format (chrome://tracing, Perfetto).
+
+extern bool ProfileActive;
+
+void D_StartProfile(const char *filename);
+void D_WriteProfile();
+void D_AddProfileEvent(const char *name, const char *category, uint64_t startns, uint64_t endns, const char *detail = nullptr);
+
+//==========================================================================
+//
+// Scoped timer. Nested scopes show up as nested phases in the trace.
+//
+//==========================================================================
+
+class FProfileScope
+{
+public:
+	FProfileScope(const char *name, const char *category = "startup", const char *detail = nullptr)
+	{
+		Category = category;
+		Detail = detail;
+		if (ProfileActive)
+		{
+			Name = name;
+			Start = I_nsTime();
+		}
+	}
+
+	~FProfileScope()
+	{
+		End();
+	}
+
+	// Ends the scope early, for phases that do not map to a C++ block.
+	void End()
+	{
+		if (Name != nullptr)
+		{
+			D_AddProfileEvent(Name, Category, Start, I_nsTime(), Detail);
+			Name = nullptr;
+		}
+	}
+
+	// Ends the current phase and starts the next one, for long sequences
+	// of phases inside one function.
+	void Next(const char *name, const char *detail = nullptr)
+	{
+		End();
+		Detail = detail;
+		if (ProfileActive)
+		{
+			Name = name;
+			Start = I_nsTime();
+		}
+	}
+
+private:
+	const char *Name = nullptr;
+	const char *Category;
+	const char *Detail;
+	uint64_t Start = 0;
+};
+
+//==========================================================================
+//
+// A cycle_t that also reports each Clock/Unclock pair to the profiler.
+// Used for the existing showloadtimes counters.
+//
+//==========================================================================
+
+class FProfileCycle : public cycle_t
+{
+public:
+	void SetName(const char *name)
+	{
+		Name = name;
+	}
+
+	void Clock()
+	{
+		cycle_t::Clock();
+		if (ProfileActive) Start = I_nsTime();
+	}
+
+	void Unclock()
+	{
+		cycle_t::Unclock();
+		if (ProfileActive && Name != nullptr) D_AddProfileEvent(Name, "level", Start, I_nsTime());
+	}
+
+private:
+	const char *Name = nullptr;
+	uint64_t Start = 0;
+};
@@ -53,7 +53,7 @@ CUSTOM_CVAR (Float, teamdamage, 0.f, CVAR_SERVERINFO)
 	level.teamdamage = self;
 }
 
-CUSTOM_CVAR (String, language, "auto", CVAR_ARCHIVE)
+CUSTOM_CVAR (String, language, "auto", CVAR_ARCHIVE|CVAR_NOINITCALL)
 {
 	SetLanguageIDs ();
 	GStrings.LoadStrings (false);
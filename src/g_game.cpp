@@ -1044,6 +1044,9 @@ void G_Ticker ()
 		}
 	}
 
+	// Report any screenshot that has finished writing in the background.
+	M_FinishScreenShot(false);
+
 	if (ToggleFullscreen)
 	{
 		static char toggle_fullscreen[] = "toggle fullscreen";
@@ -26,6 +26,7 @@ public:
 	virtual void AllocateBuffer(int w, int h, int texelsize) = 0;
 	virtual uint8_t *MapBuffer() = 0;
 	virtual unsigned int CreateTexture(unsigned char * buffer, int w, int h, int texunit, bool mipmap, int translation, const char *name) = 0;
+	virtual unsigned int GetTextureHandle(int translation) = 0;
 
 	virtual void Clean(bool all) = 0;
 	virtual void CleanUnused(SpriteHits &usedtranslations) = 0;
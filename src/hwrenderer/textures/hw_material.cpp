@@ -26,6 +26,7 @@
 #include "stats.h"
 #include "r_utility.h"
 #include "c_dispatch.h"
+#include "r_data/r_translate.h"
 #include "hw_ihwtexture.h"
 #include "hw_material.h"
 
@@ -435,10 +436,7 @@ void FMaterial::Bind(int clampmode, int translation)
 	if (tex->bHasCanvas) clampmode = CLAMP_CAMTEX;
 	else if (tex->bWarped && clampmode <= CLAMP_XY) clampmode = CLAMP_NONE;
 
-	// Textures that are already scaled in the texture lump will not get replaced by hires textures.
-	int flags = mExpanded? CTF_Expand : (gl_texture_usehires && tex->Scale.X == 1 && tex->Scale.Y == 1 && clampmode <= CLAMP_XY)? CTF_CheckHires : 0;
-
-	if (mBaseLayer->BindOrCreate(tex, 0, clampmode, translation, flags))
+	if (mBaseLayer->BindOrCreate(tex, 0, clampmode, translation, GetCreateFlags(clampmode)))
 	{
 		for(unsigned i=0;i<mTextureLayers.Size();i++)
 		{
@@ -466,6 +464,18 @@ void FMaterial::Bind(int clampmode, int translation)
 }
 
 
+//===========================================================================
+// 
+//	The CreateTexBuffer flags for the base layer
+//
+//===========================================================================
+
+int FMaterial::GetCreateFlags(int clampmode) const
+{
+	// Textures that are already scaled in the texture lump will not get replaced by hires textures.
+	return mExpanded? CTF_Expand : (gl_texture_usehires && tex->Scale.X == 1 && tex->Scale.Y == 1 && clampmode <= CLAMP_XY)? CTF_CheckHires : 0;
+}
+
 //===========================================================================
 //
 //
@@ -489,6 +499,48 @@ void FMaterial::PrecacheList(SpriteHits &translations)
 	while(it.NextPair(pair)) Bind(0, pair->Key);
 }
 
+//===========================================================================
+//
+// Requests the buffers that binding this translation would have to create,
+// so that the precache pipeline can build them on a worker thread.
+// Each texture gets added to 'textures' on its first request.
+//
+//===========================================================================
+
+void FMaterial::QueuePrecache(int translation, TArray<FTexture *> &textures)
+{
+	if (mBaseLayer == nullptr) return;
+
+	// Same translation and clamp mode handling as Bind(0, translation) and BindOrCreate.
+	if (translation <= 0)
+	{
+		translation = -translation;
+	}
+	else
+	{
+		auto remap = TranslationToTable(translation);
+		translation = remap == nullptr ? 0 : remap->GetUniqueIndex();
+	}
+	int clampmode = tex->UseType == ETextureType::SWCanvas ? CLAMP_NOFILTER : CLAMP_NONE;
+
+	if (mBaseLayer->GetTextureHandle(translation) == 0)
+	{
+		if (tex->RequestPrecacheBuffer(translation, GetCreateFlags(clampmode) | CTF_ProcessData))
+		{
+			textures.Push(tex);
+		}
+	}
+	for (auto &layer : mTextureLayers)
+	{
+		if (layer.animated) continue;
+		auto systex = ValidateSysTexture(layer.texture, mExpanded);
+		if (systex != nullptr && systex->GetTextureHandle(0) == 0 && layer.texture->RequestPrecacheBuffer(0, CTF_ProcessData))
+		{
+			textures.Push(layer.texture);
+		}
+	}
+}
+
 //===========================================================================
 //
 // Retrieve texture coordinate info for per-wall scaling
@@ -83,6 +83,7 @@ class FMaterial
 
 	IHardwareTexture * ValidateSysTexture(FTexture * tex, bool expand);
 	bool TrimBorders(uint16_t *rect);
+	int GetCreateFlags(int clampmode) const;
 
 public:
 	FTexture *tex;
@@ -93,6 +94,7 @@ public:
 	void SetSpriteRect();
 	void Precache();
 	void PrecacheList(SpriteHits &translations);
+	void QueuePrecache(int translation, TArray<FTexture *> &textures);
 	void AddTextureLayer(FTexture *tex)
 	{
 		FTextureLayer layer = { tex, false };
@@ -33,6 +33,13 @@
 #include "r_data/models/models.h"
 #include "textures/skyboxtexture.h"
 #include "hwrenderer/textures/hw_material.h"
+#include "taskgraph.h"
+
+CVAR(Bool, gl_precache_threaded, true, CVAR_ARCHIVE)
+
+// Textures per batch. Decoded buffers are held until their batch has been
+// uploaded, so this bounds the memory the pipeline needs.
+enum { PRECACHE_BATCH = 64 };
 
 
 //==========================================================================
@@ -67,6 +74,78 @@ static void PrecacheSprite(FTexture *tex, SpriteHits &hits)
 	if (gltex) gltex->PrecacheList(hits);
 }
 
+//==========================================================================
+//
+// PrecacheBatch
+//
+// Decodes and composes the batch's texture images on worker threads.
+// Afterwards the regular precache calls on the main thread only have to
+// upload the prepared buffers.
+//
+//==========================================================================
+
+static void PrecacheBatch(TArray<int> &batch, uint8_t *texhitlist, SpriteHits **spritehitlist)
+{
+	TArray<FTexture *> queued;
+
+	if (gl_precache_threaded)
+	{
+		for (auto i : batch)
+		{
+			FTexture *tex = TexMan.ByIndex(i);
+			if (texhitlist[i] & (FTextureManager::HIT_Wall | FTextureManager::HIT_Flat | FTextureManager::HIT_Sky))
+			{
+				FMaterial *gltex = FMaterial::ValidateTexture(tex, false);
+				if (gltex) gltex->QueuePrecache(0, queued);
+			}
+			if (spritehitlist[i] != nullptr && (*spritehitlist[i]).CountUsed() > 0)
+			{
+				FMaterial *gltex = FMaterial::ValidateTexture(tex, true);
+				if (gltex)
+				{
+					SpriteHits::Iterator it(*spritehitlist[i]);
+					SpriteHits::Pair *pair;
+					while (it.NextPair(pair)) gltex->QueuePrecache(pair->Key, queued);
+				}
+			}
+		}
+	}
+
+	if (queued.Size() > 1)
+	{
+		FTaskGraph tasks;
+		for (auto tex : queued)
+		{
+			tasks.AddTask(tex->Name.IsNotEmpty() ? tex->Name.GetChars() : "BuildPrecacheBuffers", [=]() { tex->BuildPrecacheBuffers(); });
+		}
+		Wads.BeginThreadedAccess();
+		try
+		{
+			tasks.Run();
+		}
+		catch (...)
+		{
+			Wads.EndThreadedAccess();
+			for (auto tex : queued) tex->FreePrecacheBuffers();
+			throw;
+		}
+		Wads.EndThreadedAccess();
+	}
+
+	for (auto i : batch)
+	{
+		FTexture *tex = TexMan.ByIndex(i);
+		PrecacheTexture(tex, texhitlist[i]);
+		if (spritehitlist[i] != nullptr && (*spritehitlist[i]).CountUsed() > 0)
+		{
+			PrecacheSprite(tex, *spritehitlist[i]);
+		}
+	}
+
+	// Anything that did not get picked up is not needed anymore.
+	for (auto tex : queued) tex->FreePrecacheBuffers();
+}
+
 //==========================================================================
 //
 // DFrameBuffer :: Precache
@@ -193,18 +272,27 @@ void hw_PrecacheTexture(uint8_t *texhitlist, TMap<PClassActor*, bool> &actorhitl
 	if (gl_precache)
 	{
 		// cache all used textures
+		TArray<int> batch;
 		for (int i = cnt - 1; i >= 0; i--)
 		{
 			FTexture *tex = TexMan.ByIndex(i);
 			if (tex != nullptr)
 			{
-				PrecacheTexture(tex, texhitlist[i]);
-				if (spritehitlist[i] != nullptr && (*spritehitlist[i]).CountUsed() > 0)
+				bool spritehit = spritehitlist[i] != nullptr && (*spritehitlist[i]).CountUsed() > 0;
+				if (!spritehit && !(texhitlist[i] & (FTextureManager::HIT_Wall | FTextureManager::HIT_Flat | FTextureManager::HIT_Sky)))
+				{
+					PrecacheTexture(tex, texhitlist[i]);	// only unloads it
+					continue;
+				}
+				batch.Push(i);
+				if (batch.Size() == PRECACHE_BATCH)
 				{
-					PrecacheSprite(tex, *spritehitlist[i]);
+					PrecacheBatch(batch, texhitlist, spritehitlist);
+					batch.Clear();
 				}
 			}
 		}
+		if (batch.Size() > 0) PrecacheBatch(batch, texhitlist, spritehitlist);
 
 		// cache all used models
 		FModelRenderer *renderer = screen->CreateModelRenderer(-1);
@@ -31,6 +31,9 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <time.h>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include "r_defs.h"
 
@@ -50,7 +53,9 @@
 #include "c_cvars.h"
 #include "c_dispatch.h"
 #include "c_bind.h"
+#include "c_console.h"
 
+#include "i_system.h"
 #include "i_video.h"
 #include "v_video.h"
 
@@ -59,6 +64,7 @@
 #include "m_png.h"
 
 #include "cmdlib.h"
+#include "doomerrors.h"
 
 #include "g_game.h"
 #include "gi.h"
@@ -566,6 +572,51 @@ static bool FindFreeName (FString &fullname, const char *extension)
 	return false;
 }
 
+//==========================================================================
+//
+// PNG screenshots get encoded and written on a background thread, so that
+// taking one does not stall the game. Its output is printed once it is
+// done. Only one screenshot is written at a time.
+//
+//==========================================================================
+
+static struct FScreenShotWriter
+{
+	std::thread Thread;
+	std::atomic<bool> Done;
+	TArray<FCapturedPrint> Output;
+
+	~FScreenShotWriter()
+	{
+		Wait();
+	}
+
+	void Wait()
+	{
+		if (Thread.joinable()) Thread.join();
+	}
+} ScreenShotWriter;
+
+// Makes sure the file is complete before anything shuts down.
+static void WaitForScreenShot()
+{
+	ScreenShotWriter.Wait();
+}
+
+void M_FinishScreenShot (bool wait)
+{
+	if (!ScreenShotWriter.Thread.joinable() || (!wait && !ScreenShotWriter.Done))
+	{
+		return;
+	}
+	ScreenShotWriter.Wait();
+	for (auto &line : ScreenShotWriter.Output)
+	{
+		PrintString(line.PrintLevel, line.Text);
+	}
+	ScreenShotWriter.Output.Clear();
+}
+
 void M_ScreenShot (const char *filename)
 {
 	FileWriter *file;
@@ -630,24 +681,45 @@ void M_ScreenShot (const char *filename)
 			delete[] buffer;
 			return;
 		}
+
+		FString message;
+		if (!screenshot_quiet)
+		{
+			int slash = -1;
+			if (!longsavemessages) slash = autoname.LastIndexOfAny(":/\\");
+			message.Format("Captured %s\n", autoname.GetChars()+slash+1);
+		}
+
 		if (writepcx)
 		{
 			WritePCXfile(file, buffer, palette, color_type,
 				screen->GetWidth(), screen->GetHeight(), pitch);
+			delete file;
+			delete[] buffer;
+			if (message.IsNotEmpty()) Printf ("%s", message.GetChars());
 		}
 		else
 		{
-			WritePNGfile(file, buffer, palette, color_type,
-				screen->GetWidth(), screen->GetHeight(), pitch, gamma);
-		}
-		delete file;
-		delete[] buffer;
+			// The buffer is already a copy of the screen, so it can be handed
+			// over to the writer thread as it is.
+			int width = screen->GetWidth();
+			int height = screen->GetHeight();
 
-		if (!screenshot_quiet)
-		{
-			int slash = -1;
-			if (!longsavemessages) slash = autoname.LastIndexOfAny(":/\\");
-			Printf ("Captured %s\n", autoname.GetChars()+slash+1);
+			static bool registered = (atterm(WaitForScreenShot), true);
+			(void)registered;
+
+			M_FinishScreenShot(true);
+			ScreenShotWriter.Done = false;
+			ScreenShotWriter.Thread = std::thread([=]()
+			{
+				C_SetPrintCapture(&ScreenShotWriter.Output);
+				WritePNGfile(file, buffer, palette, color_type, width, height, pitch, gamma);
+				delete file;
+				delete[] buffer;
+				if (message.IsNotEmpty()) Printf ("%s", message.GetChars());
+				C_SetPrintCapture(nullptr);
+				ScreenShotWriter.Done = true;
+			});
 		}
 	}
 	else
@@ -696,3 +768,61 @@ FString M_ZLibError(int zerr)
 		return errs[-zerr - 1];
 	}
 }
+
+//==========================================================================
+//
+// M_PruneCacheDirectory
+//
+// Removes the oldest files from a cache directory until the rest fit
+// into limit bytes, along with temporary files left behind by a crash
+// while writing. Returns the size of what is left.
+//
+//==========================================================================
+
+int64_t M_PruneCacheDirectory(const FString &dir, int64_t limit)
+{
+	struct CacheFile
+	{
+		FString Filename;
+		int64_t Size;
+		time_t Time;
+	};
+	TArray<FFileList> list;
+	TArray<CacheFile> files;
+
+	try
+	{
+		ScanDirectory(list, dir);
+	}
+	catch (CRecoverableError &)
+	{
+		return 0;
+	}
+
+	for (auto &entry : list)
+	{
+		struct stat info;
+		if (entry.isDirectory || stat(entry.Filename, &info) != 0) continue;
+
+		if (entry.Filename.Right(4).Compare(".tmp") == 0)
+		{
+			remove(entry.Filename);
+			continue;
+		}
+		files.Push({ entry.Filename, (int64_t)info.st_size, info.st_mtime });
+	}
+
+	std::sort(files.begin(), files.end(), [](const CacheFile &a, const CacheFile &b) { return a.Time > b.Time; });
+
+	unsigned i = 0;
+	int64_t total = 0;
+	for (; i < files.Size() && total + files[i].Size <= limit; i++)
+	{
+		total += files[i].Size;
+	}
+	for (; i < files.Size(); i++)
+	{
+		remove(files[i].Filename);
+	}
+	return total;
+}
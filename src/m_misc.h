@@ -39,6 +39,10 @@ void M_FindResponseFile (void);
 //		Pass a NULL to get the original behavior.
 void M_ScreenShot (const char *filename);
 
+// Prints the results of a screenshot that was written in the background.
+// With wait set this blocks until the screenshot has been written.
+void M_FinishScreenShot (bool wait);
+
 void M_LoadDefaults ();
 
 bool M_SaveDefaults (const char *filename);
@@ -47,6 +51,7 @@ void M_SaveCustomKeys (FConfigFile *config, char *section, char *subsection, siz
 
 
 FString M_ZLibError(int zerrnum);
+int64_t M_PruneCacheDirectory(const FString &dir, int64_t limit);
 
 // Get special directory paths (defined in m_specialpaths.cpp)
 
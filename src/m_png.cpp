@@ -36,6 +36,9 @@
 
 #include <stdlib.h>
 #include <zlib.h>
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
 #ifdef _MSC_VER
 #include <malloc.h>		// for alloca()
 #endif
@@ -46,18 +49,21 @@
 #include "r_defs.h"
 #include "v_video.h"
 #include "m_png.h"
+#include "taskgraph.h"
+#include "c_dispatch.h"
+#include "i_time.h"
+#include "templates.h"
+#include "v_text.h"
+#include "x86.h"
 
 // MACROS ------------------------------------------------------------------
 
-// The maximum size of an IDAT chunk ZDoom will write. This is also the
-// size of the compression buffer it allocates on the stack.
+// The maximum size of an IDAT chunk ZDoom will write.
 #define PNG_WRITE_SIZE	32768
 
-// Set this to 1 to use a simple heuristic to select the filter to apply
-// for each row of RGB image saves. As it turns out, it seems no filtering
-// is the best for Doom screenshots, no matter what the heuristic might
-// determine, so that's why this is 0 here.
-#define USE_FILTER_HEURISTIC 0
+// The size of the pieces the image data gets split into for compressing
+// it on several threads.
+#define PNG_CHUNK_SIZE	(256*1024)
 
 // TYPES -------------------------------------------------------------------
 
@@ -95,6 +101,7 @@ static inline void MakeChunk (void *where, uint32_t type, size_t len);
 static inline void StuffPalette (const PalEntry *from, uint8_t *to);
 static bool WriteIDAT (FileWriter *file, const uint8_t *data, int len);
 static void UnfilterRow (int width, uint8_t *dest, uint8_t *stream, uint8_t *prev, int bpp);
+static void UnfilterRow_C (int width, uint8_t *dest, uint8_t *stream, uint8_t *prev, int bpp);
 static void UnpackPixels (int width, int bytesPerRow, int bitdepth, const uint8_t *rowin, uint8_t *rowout, bool grayscale);
 
 // EXTERNAL DATA DECLARATIONS ----------------------------------------------
@@ -747,141 +754,123 @@ uint32_t CalcSum(Byte *row, int len)
 
 //==========================================================================
 //
-// SelectFilter
-//
-// Performs the heuristic recommended by the PNG spec to decide the
-// (hopefully) best filter to use for this row. To quate:
+// ConvertRows
 //
-//    Select the filter that gives the smallest sum of absolute values of
-//    outputs. (Consider the output bytes as signed differences for this
-//    test.)
+// Copies rows of the bitmap into the PNG image data. Each row gets filter
+// type 0 (none), which works best for Doom screenshots, no matter what the
+// heuristic recommended by the PNG spec might determine.
 //
 //==========================================================================
 
-#if USE_FILTER_HEURISTIC
-static int SelectFilter(Byte row[5][1 + MAXWIDTH*3], Byte prior[MAXWIDTH*3], int width)
+static void ConvertRows(const uint8_t *from, ESSType color_type, int width, int pitch, int firstrow, int numrows, uint8_t *to, int rowbytes)
 {
-	// As it turns out, it seems no filtering is the best for Doom screenshots,
-	// no matter what the heuristic might determine.
-	return 0;
-	uint32_t sum;
-	uint32_t bestsum;
-	int bestfilter;
-	int x;
+	from += (ptrdiff_t)firstrow * pitch;
+	to += (ptrdiff_t)firstrow * rowbytes;
 
-	width *= 3;
-
-	// The first byte of each row holds the filter type, filled in by the caller.
-	// However, the prior row does not contain a filter type, since it's always 0.
-
-	bestsum = 0;
-	bestfilter = 0;
-
-	// None
-	for (x = 1; x <= width; ++x)
+	for (int y = 0; y < numrows; ++y, from += pitch, to += rowbytes)
 	{
-		bestsum += abs((char)row[0][x]);
-	}
+		to[0] = 0;
+		switch (color_type)
+		{
+		case SS_PAL:
+			memcpy(to + 1, from, width);
+			break;
 
-	// Sub
-	row[1][1] = row[0][1];
-	row[1][2] = row[0][2];
-	row[1][3] = row[0][3];
-	sum = abs((char)row[0][1]) + abs((char)row[0][2]) + abs((char)row[0][3]);
-	for (x = 4; x <= width; ++x)
-	{
-		row[1][x] = row[0][x] - row[0][x - 3];
-		sum += abs((char)row[1][x]);
-		if (sum >= bestsum)
-		{ // This isn't going to be any better.
+		case SS_RGB:
+			memcpy(to + 1, from, width * 3);
 			break;
-		}
-	}
-	if (sum < bestsum)
-	{
-		bestsum = sum;
-		bestfilter = 1;
-	}
 
-	// Up
-	sum = 0;
-	for (x = 1; x <= width; ++x)
-	{
-		row[2][x] = row[0][x] - prior[x - 1];
-		sum += abs((char)row[2][x]);
-		if (sum >= bestsum)
-		{ // This isn't going to be any better.
+		case SS_BGRA:
+		{
+			// Swizzle a whole pixel at a time. Each store writes one byte
+			// too many, which the next pixel overwrites.
+			uint8_t *out = to + 1;
+			int x;
+			for (x = 0; x < width - 1; ++x)
+			{
+				uint32_t bgra, rgb;
+				memcpy(&bgra, from + x*4, 4);
+				bgra = LittleLong(bgra);
+				rgb = LittleLong(((bgra >> 16) & 0xff) | (bgra & 0xff00) | ((bgra & 0xff) << 16));
+				memcpy(out + x*3, &rgb, 4);
+			}
+			out[x*3] = from[x*4 + 2];
+			out[x*3 + 1] = from[x*4 + 1];
+			out[x*3 + 2] = from[x*4];
 			break;
 		}
+		}
 	}
-	if (sum < bestsum)
-	{
-		bestsum = sum;
-		bestfilter = 2;
-	}
+}
 
-	// Average
-	row[3][1] = row[0][1] - prior[0] / 2;
-	row[3][2] = row[0][2] - prior[1] / 2;
-	row[3][3] = row[0][3] - prior[2] / 2;
-	sum = abs((char)row[3][1]) + abs((char)row[3][2]) + abs((char)row[3][3]);
-	for (x = 4; x <= width; ++x)
+//==========================================================================
+//
+// CompressChunk
+//
+// Compresses one piece of the image data as raw deflate data. Each piece
+// is primed with the end of the previous one, so splitting the image up
+// costs very little compression. All but the last piece end with a sync
+// flush, which leaves the output at a byte boundary without ending the
+// deflate stream, so the pieces can simply be concatenated.
+//
+//==========================================================================
+
+struct FPNGChunk
+{
+	int FirstRow;
+	int NumRows;
+	TArray<uint8_t> Compressed;
+	uLong Adler;
+	bool Ok;
+};
+
+static void CompressChunk(const uint8_t *data, int rowbytes, FPNGChunk &chunk, bool last, int level)
+{
+	const uint8_t *in = data + (ptrdiff_t)chunk.FirstRow * rowbytes;
+	const uInt len = chunk.NumRows * rowbytes;
+	z_stream stream;
+	int err;
+
+	chunk.Ok = false;
+	chunk.Adler = adler32(adler32(0, Z_NULL, 0), in, len);
+
+	memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
 	{
-		row[3][x] = row[0][x] - (row[0][x - 3] + prior[x - 1]) / 2;
-		sum += (char)row[3][x];
-		if (sum >= bestsum)
-		{ // This isn't going to be any better.
-			break;
-		}
+		return;
 	}
-	if (sum < bestsum)
+	if (in > data)
 	{
-		bestsum = sum;
-		bestfilter = 3;
+		uInt dictsize = (uInt)MIN<ptrdiff_t>(in - data, 32768);
+		deflateSetDictionary(&stream, in - dictsize, dictsize);
 	}
 
-	// Paeth
-	row[4][1] = row[0][1] - prior[0];
-	row[4][2] = row[0][2] - prior[1];
-	row[4][3] = row[0][3] - prior[2];
-	sum = abs((char)row[4][1]) + abs((char)row[4][2]) + abs((char)row[4][3]);
-	for (x = 4; x <= width; ++x)
+	chunk.Compressed.Resize(deflateBound(&stream, len) + 16);
+	stream.next_in = const_cast<Bytef *>(in);
+	stream.avail_in = len;
+	stream.next_out = &chunk.Compressed[0];
+	stream.avail_out = chunk.Compressed.Size();
+
+	for (;;)
 	{
-		Byte a = row[0][x - 3];
-		Byte b = prior[x - 1];
-		Byte c = prior[x - 4];
-		int p = a + b - c;
-		int pa = abs(p - a);
-		int pb = abs(p - b);
-		int pc = abs(p - c);
-		if (pa <= pb && pa <= pc)
-		{
-			row[4][x] = row[0][x] - a;
-		}
-		else if (pb <= pc)
+		err = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if (last ? err == Z_STREAM_END : (err == Z_OK && stream.avail_out != 0))
 		{
-			row[4][x] = row[0][x] - b;
+			chunk.Ok = true;
+			break;
 		}
-		else
+		if (err != Z_OK && err != Z_BUF_ERROR)
 		{
-			row[4][x] = row[0][x] - c;
-		}
-		sum += (char)row[4][x];
-		if (sum >= bestsum)
-		{ // This isn't going to be any better.
 			break;
 		}
+		// Out of room, which deflateBound should have prevented.
+		chunk.Compressed.Resize(chunk.Compressed.Size() * 2);
+		stream.next_out = &chunk.Compressed[stream.total_out];
+		stream.avail_out = chunk.Compressed.Size() - stream.total_out;
 	}
-	if (sum < bestsum)
-	{
-		bestfilter = 4;
-	}
-
-	return bestfilter;
+	chunk.Compressed.Resize(stream.total_out);
+	deflateEnd(&stream);
 }
-#else
-#define SelectFilter(x,y,z)		0
-#endif
 
 //==========================================================================
 //
@@ -890,138 +879,88 @@ static int SelectFilter(Byte row[5][1 + MAXWIDTH*3], Byte prior[MAXWIDTH*3], int
 // Given a bitmap, creates one or more IDAT chunks in the given file.
 // Returns true on success.
 //
+// The bitmap is converted and compressed in pieces of about PNG_CHUNK_SIZE
+// bytes on as many threads as there are cores.
+//
 //==========================================================================
 
 bool M_SaveBitmap(const uint8_t *from, ESSType color_type, int width, int height, int pitch, FileWriter *file)
 {
-#if USE_FILTER_HEURISTIC
-	Byte prior[MAXWIDTH*3];
-	Byte temprow[5][1 + MAXWIDTH*3];
-#else
-	Byte temprow[1][1 + MAXWIDTH*3];
-#endif
-	Byte buffer[PNG_WRITE_SIZE];
-	z_stream stream;
-	int err;
-	int y;
-
-	stream.next_in = Z_NULL;
-	stream.avail_in = 0;
-	stream.zalloc = Z_NULL;
-	stream.zfree = Z_NULL;
-	err = deflateInit (&stream, png_level);
-
-	if (err != Z_OK)
+	const int rowbytes = 1 + width * (color_type == SS_PAL ? 1 : 3);
+	const int rowsperchunk = MAX(1, PNG_CHUNK_SIZE / rowbytes);
+	const int numchunks = (height + rowsperchunk - 1) / rowsperchunk;
+	const int level = png_level;
+	TArray<uint8_t> data(rowbytes * height, true);
+	TArray<FPNGChunk> chunks;
+
+	chunks.Resize(numchunks);
+	for (int i = 0; i < numchunks; ++i)
 	{
-		return false;
+		chunks[i].FirstRow = i * rowsperchunk;
+		chunks[i].NumRows = MIN(rowsperchunk, height - chunks[i].FirstRow);
 	}
 
-	y = height;
-	stream.next_out = buffer;
-	stream.avail_out = sizeof(buffer);
-
-	temprow[0][0] = 0;
-#if USE_FILTER_HEURISTIC
-	temprow[1][0] = 1;
-	temprow[2][0] = 2;
-	temprow[3][0] = 3;
-	temprow[4][0] = 4;
+	auto convert = [&](int i)
+	{
+		ConvertRows(from, color_type, width, pitch, chunks[i].FirstRow, chunks[i].NumRows, &data[0], rowbytes);
+	};
+	auto compress = [&](int i)
+	{
+		CompressChunk(&data[0], rowbytes, chunks[i], i == numchunks - 1, level);
+	};
 
-	// Fill the prior row with 0 for RGB images. Paletted is always filter 0,
-	// so it doesn't need this.
-	if (color_type != SS_PAL)
+	if (numchunks == 1)
 	{
-		memset(prior, 0, width * 3);
+		convert(0);
+		compress(0);
 	}
-#endif
-
-	while (y-- > 0 && err == Z_OK)
+	else
 	{
-		switch (color_type)
-		{
-		case SS_PAL:
-			memcpy(&temprow[0][1], from, width);
-			// always use filter type 0 for paletted images
-			stream.next_in = temprow[0];
-			stream.avail_in = width + 1;
-			break;
-
-		case SS_RGB:
-			memcpy(&temprow[0][1], from, width*3);
-			stream.next_in = temprow[SelectFilter(temprow, prior, width)];
-			stream.avail_in = width * 3 + 1;
-			break;
-
-		case SS_BGRA:
-			for (int x = 0; x < width; ++x)
-			{
-				temprow[0][x*3 + 1] = from[x*4 + 2];
-				temprow[0][x*3 + 2] = from[x*4 + 1];
-				temprow[0][x*3 + 3] = from[x*4];
-			}
-			stream.next_in = temprow[SelectFilter(temprow, prior, width)];
-			stream.avail_in = width * 3 + 1;
-			break;
-		}
-#if USE_FILTER_HEURISTIC
-		if (color_type != SS_PAL)
+		// A piece can be compressed once it and the piece before it,
+		// which is used as the dictionary, have been converted.
+		FTaskGraph graph;
+		int prevconvert = -1;
+		for (int i = 0; i < numchunks; ++i)
 		{
-			// Save this row for filter calculations on the next row.
-			memcpy (prior, &temprow[0][1], stream.avail_in - 1);
+			int thisconvert = graph.AddTask("PNG convert", [&, i]() { convert(i); });
+			if (prevconvert < 0) graph.AddTask("PNG deflate", [&, i]() { compress(i); }, { thisconvert });
+			else graph.AddTask("PNG deflate", [&, i]() { compress(i); }, { prevconvert, thisconvert });
+			prevconvert = thisconvert;
 		}
-#endif
+		graph.Run();
+	}
 
-		from += pitch;
+	// Put the pieces together into one zlib stream.
+	TArray<uint8_t> stream;
+	unsigned header = (0x78 << 8) | ((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+	header += 31 - header % 31;
+	stream.Push(uint8_t(header >> 8));
+	stream.Push(uint8_t(header));
 
-		err = deflate (&stream, (y == 0) ? Z_FINISH : 0);
-		if (err != Z_OK)
-		{
-			break;
-		}
-		while (stream.avail_out == 0)
+	uLong adler = 0;
+	for (int i = 0; i < numchunks; ++i)
+	{
+		if (!chunks[i].Ok)
 		{
-			if (!WriteIDAT (file, buffer, sizeof(buffer)))
-			{
-				return false;
-			}
-			stream.next_out = buffer;
-			stream.avail_out = sizeof(buffer);
-			if (stream.avail_in != 0)
-			{
-				err = deflate (&stream, (y == 0) ? Z_FINISH : 0);
-				if (err != Z_OK)
-				{
-					break;
-				}
-			}
+			return false;
 		}
+		adler = i == 0 ? chunks[i].Adler : adler32_combine(adler, chunks[i].Adler, chunks[i].NumRows * rowbytes);
+		stream.Append(chunks[i].Compressed);
+		chunks[i].Compressed.Reset();
 	}
-
-	while (err == Z_OK)
+	for (int shift = 24; shift >= 0; shift -= 8)
 	{
-		err = deflate (&stream, Z_FINISH);
-		if (err != Z_OK)
-		{
-			break;
-		}
-		if (stream.avail_out == 0)
-		{
-			if (!WriteIDAT (file, buffer, sizeof(buffer)))
-			{
-				return false;
-			}
-			stream.next_out = buffer;
-			stream.avail_out = sizeof(buffer);
-		}
+		stream.Push(uint8_t(adler >> shift));
 	}
 
-	deflateEnd (&stream);
-
-	if (err != Z_STREAM_END)
+	for (unsigned pos = 0; pos < stream.Size(); pos += PNG_WRITE_SIZE)
 	{
-		return false;
+		if (!WriteIDAT(file, &stream[pos], MIN<int>(PNG_WRITE_SIZE, stream.Size() - pos)))
+		{
+			return false;
+		}
 	}
-	return WriteIDAT (file, buffer, sizeof(buffer)-stream.avail_out);
+	return true;
 }
 
 //==========================================================================
@@ -1052,7 +991,7 @@ static bool WriteIDAT (FileWriter *file, const uint8_t *data, int len)
 
 //==========================================================================
 //
-// UnfilterRow
+// UnfilterRow_C
 //
 // Unfilters the given row. Unknown filter types are silently ignored.
 // bpp is bytes per pixel, not bits per pixel.
@@ -1060,7 +999,7 @@ static bool WriteIDAT (FileWriter *file, const uint8_t *data, int len)
 //
 //==========================================================================
 
-void UnfilterRow (int width, uint8_t *dest, uint8_t *row, uint8_t *prev, int bpp)
+static void UnfilterRow_C (int width, uint8_t *dest, uint8_t *row, uint8_t *prev, int bpp)
 {
 	int x;
 
@@ -1135,6 +1074,234 @@ void UnfilterRow (int width, uint8_t *dest, uint8_t *row, uint8_t *prev, int bpp
 	}
 }
 
+#ifndef NO_SSE
+
+//==========================================================================
+//
+// SSE2 unfiltering
+//
+// Sub, Average and Paeth depend on the pixel to the left, so these work
+// on one pixel at a time with its channels spread across the vector lanes,
+// which only pays off for 3 and 4 bytes per pixel. Up has no such
+// dependency and is done 16 bytes at a time for any pixel size. The
+// results are identical to UnfilterRow_C's.
+//
+//==========================================================================
+
+// 3 byte pixels are assembled in a register. Going through memcpy and
+// memory makes every pixel wait for a failed store forward.
+template<int bpp> static inline __m128i LoadPixel (const uint8_t *p)
+{
+	uint32_t v;
+	if (bpp == 4) memcpy (&v, p, 4);
+	else v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return _mm_cvtsi32_si128 (v);
+}
+
+template<int bpp> static inline void StorePixel (uint8_t *p, __m128i v)
+{
+	uint32_t c = _mm_cvtsi128_si32 (v);
+	if (bpp == 4)
+	{
+		memcpy (p, &c, 4);
+	}
+	else
+	{
+		p[0] = uint8_t(c);
+		p[1] = uint8_t(c >> 8);
+		p[2] = uint8_t(c >> 16);
+	}
+}
+
+static inline __m128i Select16 (__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b));
+}
+
+static inline __m128i Abs16 (__m128i v)
+{
+	return _mm_max_epi16 (v, _mm_sub_epi16 (_mm_setzero_si128(), v));
+}
+
+static void UnfilterUp_SSE2 (int width, uint8_t *dest, const uint8_t *row, const uint8_t *prev)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i v = _mm_add_epi8 (_mm_loadu_si128 ((const __m128i *)(row + x)), _mm_loadu_si128 ((const __m128i *)(prev + x)));
+		_mm_storeu_si128 ((__m128i *)(dest + x), v);
+	}
+	for (; x < width; x++)
+	{
+		dest[x] = row[x] + prev[x];
+	}
+}
+
+template<int bpp> static void UnfilterRow_SSE2 (int width, uint8_t *dest, const uint8_t *row, const uint8_t *prev)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const int filter = *row++;
+
+	// Without a pixel to the left, a and c are 0 for the first pixel, which
+	// makes the formulas below reduce to what the PNG spec asks for there.
+	switch (filter)
+	{
+	case 1:		// Sub
+	{
+		__m128i a = zero;
+		for (int x = 0; x < width; x += bpp)
+		{
+			a = _mm_add_epi8 (a, LoadPixel<bpp> (row + x));
+			StorePixel<bpp> (dest + x, a);
+		}
+		break;
+	}
+
+	case 2:		// Up
+		UnfilterUp_SSE2 (width, dest, row, prev);
+		break;
+
+	case 3:		// Average
+	{
+		// pavgb rounds up, the filter rounds down.
+		const __m128i one = _mm_set1_epi8 (1);
+		__m128i a = zero;
+		for (int x = 0; x < width; x += bpp)
+		{
+			__m128i b = LoadPixel<bpp> (prev + x);
+			__m128i avg = _mm_sub_epi8 (_mm_avg_epu8 (a, b), _mm_and_si128 (_mm_xor_si128 (a, b), one));
+			a = _mm_add_epi8 (avg, LoadPixel<bpp> (row + x));
+			StorePixel<bpp> (dest + x, a);
+		}
+		break;
+	}
+
+	case 4:		// Paeth
+	{
+		// a, b and c are kept as 16 bit values.
+		__m128i a = zero, c = zero;
+		for (int x = 0; x < width; x += bpp)
+		{
+			__m128i b = _mm_unpacklo_epi8 (LoadPixel<bpp> (prev + x), zero);
+			__m128i pa = _mm_sub_epi16 (b, c);
+			__m128i pb = _mm_sub_epi16 (a, c);
+			__m128i pc = Abs16 (_mm_add_epi16 (pa, pb));
+			pa = Abs16 (pa);
+			pb = Abs16 (pb);
+
+			// Same tie breaking as the scalar code: a before b before c.
+			__m128i mask = _mm_cmplt_epi16 (pb, pa);
+			__m128i pred = Select16 (mask, b, a);
+			pred = Select16 (_mm_cmplt_epi16 (pc, _mm_min_epi16 (pa, pb)), c, pred);
+
+			__m128i out = _mm_add_epi8 (_mm_packus_epi16 (pred, pred), LoadPixel<bpp> (row + x));
+			StorePixel<bpp> (dest + x, out);
+			a = _mm_unpacklo_epi8 (out, zero);
+			c = b;
+		}
+		break;
+	}
+
+	default:	// Treat everything else as filter type 0 (none)
+		memcpy (dest, row, width);
+		break;
+	}
+}
+
+#endif
+
+//==========================================================================
+//
+// UnfilterRow
+//
+// Picks the fastest unfilter code for the row.
+//
+//==========================================================================
+
+static void UnfilterRow (int width, uint8_t *dest, uint8_t *row, uint8_t *prev, int bpp)
+{
+#ifndef NO_SSE
+	if (CPU.bSSE2)
+	{
+		if (bpp == 4) UnfilterRow_SSE2<4> (width, dest, row, prev);
+		else if (bpp == 3) UnfilterRow_SSE2<3> (width, dest, row, prev);
+		else if (*row == 2) UnfilterUp_SSE2 (width, dest, row + 1, prev);
+		else UnfilterRow_C (width, dest, row, prev, bpp);
+		return;
+	}
+#endif
+	UnfilterRow_C (width, dest, row, prev, bpp);
+}
+
+#ifndef NO_SSE
+
+//==========================================================================
+//
+// Checks that the SSE2 unfilter code produces the same rows as the scalar
+// code for every filter type and times both.
+//
+//==========================================================================
+
+CCMD(png_unfilter_benchmark)
+{
+	static const char *const names[] = { "None", "Sub", "Up", "Average", "Paeth" };
+	const int width = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 8192) : 1024;
+	const int height = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 8192) : 1024;
+
+	if (!CPU.bSSE2)
+	{
+		Printf("This CPU does not support SSE2\n");
+		return;
+	}
+
+	Printf("Unfiltering %dx%d\n", width, height);
+	for (int bpp = 3; bpp <= 4; bpp++)
+	{
+		const int rowbytes = width * bpp;
+		TArray<uint8_t> input((rowbytes + 1) * height, true);
+		TArray<uint8_t> reference(rowbytes * (height + 1), true);
+		TArray<uint8_t> result(rowbytes * (height + 1), true);
+
+		// The first row of the output buffers is the all black row above the image.
+		memset(&reference[0], 0, rowbytes);
+		memset(&result[0], 0, rowbytes);
+
+		for (int filter = 0; filter <= 4; filter++)
+		{
+			uint32_t seed = filter + 1;
+			for (auto &b : input)
+			{
+				seed = seed * 1664525 + 1013904223;
+				b = uint8_t(seed >> 24);
+			}
+			for (int y = 0; y < height; y++)
+			{
+				input[y * (rowbytes + 1)] = filter;
+			}
+
+			uint64_t start = I_nsTime();
+			for (int y = 0; y < height; y++)
+			{
+				UnfilterRow_C(rowbytes, &reference[(y + 1) * rowbytes], &input[y * (rowbytes + 1)], &reference[y * rowbytes], bpp);
+			}
+			double scalartime = (I_nsTime() - start) / 1e6;
+
+			start = I_nsTime();
+			for (int y = 0; y < height; y++)
+			{
+				UnfilterRow(rowbytes, &result[(y + 1) * rowbytes], &input[y * (rowbytes + 1)], &result[y * rowbytes], bpp);
+			}
+			double simdtime = (I_nsTime() - start) / 1e6;
+
+			bool same = !memcmp(&reference[0], &result[0], reference.Size());
+			Printf("%d bpp %-8s C %.2f ms | SSE2 %.2f ms (%.1fx)%s\n", bpp, names[filter], scalartime, simdtime,
+				scalartime / MAX(simdtime, 0.001), same ? "" : TEXTCOLOR_RED " MISMATCH" TEXTCOLOR_NORMAL);
+		}
+	}
+}
+
+#endif
+
 //==========================================================================
 //
 // UnpackPixels
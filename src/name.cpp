@@ -33,9 +33,11 @@
 */
 
 #include <string.h>
+#include <mutex>
 #include "name.h"
 #include "c_dispatch.h"
 #include "c_console.h"
+#include "i_system.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -44,9 +46,6 @@
 // that is just large enough to hold it.
 #define BLOCK_SIZE			4096
 
-// How many entries to grow the NameArray by when it needs to grow.
-#define NAME_GROW_AMOUNT	256
-
 // TYPES -------------------------------------------------------------------
 
 // Name text is stored in a linked list of NameBlock structures. This
@@ -68,6 +67,11 @@ struct FName::NameManager::NameBlock
 FName::NameManager FName::NameData;
 bool FName::NameManager::Inited;
 
+// std::mutex has a constexpr constructor so these are safe to use during
+// static initialization, just like NameData.
+static std::mutex ShardLocks[16];
+static std::mutex ChunkLock;
+
 // Define the predefined names.
 static const char *PredefinedNames[] =
 {
@@ -90,37 +94,11 @@ static const char *PredefinedNames[] =
 
 int FName::NameManager::FindName (const char *text, bool noCreate)
 {
-	if (!Inited)
-	{
-		InitBuckets ();
-	}
-
 	if (text == NULL)
 	{
 		return 0;
 	}
-
-	unsigned int hash = MakeKey (text);
-	unsigned int bucket = hash % HASH_SIZE;
-	int scanner = Buckets[bucket];
-
-	// See if the name already exists.
-	while (scanner >= 0)
-	{
-		if (NameArray[scanner].Hash == hash && stricmp (NameArray[scanner].Text, text) == 0)
-		{
-			return scanner;
-		}
-		scanner = NameArray[scanner].NextHash;
-	}
-
-	// If we get here, then the name does not exist.
-	if (noCreate)
-	{
-		return 0;
-	}
-
-	return AddName (text, hash, bucket);
+	return FindName (text, strlen (text), noCreate);
 }
 
 //==========================================================================
@@ -144,18 +122,12 @@ int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreat
 
 	unsigned int hash = MakeKey (text, textLen);
 	unsigned int bucket = hash % HASH_SIZE;
-	int scanner = Buckets[bucket];
 
 	// See if the name already exists.
-	while (scanner >= 0)
+	int scanner = FindInChain (Buckets[bucket].load (std::memory_order_acquire), text, textLen, hash);
+	if (scanner >= 0)
 	{
-		if (NameArray[scanner].Hash == hash &&
-			strnicmp (NameArray[scanner].Text, text, textLen) == 0 &&
-			NameArray[scanner].Text[textLen] == '\0')
-		{
-			return scanner;
-		}
-		scanner = NameArray[scanner].NextHash;
+		return scanner;
 	}
 
 	// If we get here, then the name does not exist.
@@ -164,7 +136,31 @@ int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreat
 		return 0;
 	}
 
-	return AddName (text, hash, bucket);
+	return AddName (text, textLen, hash, bucket);
+}
+
+//==========================================================================
+//
+// FName :: NameManager :: FindInChain
+//
+// Scans a hash chain starting at the given entry.
+//
+//==========================================================================
+
+int FName::NameManager::FindInChain (int scanner, const char *text, size_t textLen, unsigned int hash) const
+{
+	while (scanner >= 0)
+	{
+		const NameEntry &entry = GetEntry (scanner);
+		if (entry.Hash == hash &&
+			strnicmp (entry.Text, text, textLen) == 0 &&
+			entry.Text[textLen] == '\0')
+		{
+			return scanner;
+		}
+		scanner = entry.NextHash;
+	}
+	return -1;
 }
 
 //==========================================================================
@@ -172,13 +168,17 @@ int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreat
 // FName :: NameManager :: InitBuckets
 //
 // Sets up the hash table and inserts all the default names into the table.
+// This happens during static initialization, so there is only one thread.
 //
 //==========================================================================
 
 void FName::NameManager::InitBuckets ()
 {
 	Inited = true;
-	memset (Buckets, -1, sizeof(Buckets));
+	for (auto &bucket : Buckets)
+	{
+		bucket.store (-1, std::memory_order_relaxed);
+	}
 
 	// Register built-in names. 'None' must be name 0.
 	for (size_t i = 0; i < countof(PredefinedNames); ++i)
@@ -196,40 +196,67 @@ void FName::NameManager::InitBuckets ()
 //
 //==========================================================================
 
-int FName::NameManager::AddName (const char *text, unsigned int hash, unsigned int bucket)
+int FName::NameManager::AddName (const char *text, size_t textLen, unsigned int hash, unsigned int bucket)
 {
+	static_assert(countof(ShardLocks) == NUM_SHARDS, "Shard count mismatch");
+	unsigned int shard = bucket % NUM_SHARDS;
+	std::lock_guard<std::mutex> lock (ShardLocks[shard]);
+
+	// Another thread may have added the same name since we last looked.
+	// That can only have happened while holding this lock, so the chain
+	// seen now is final.
+	int head = Buckets[bucket].load (std::memory_order_acquire);
+	int scanner = FindInChain (head, text, textLen, hash);
+	if (scanner >= 0)
+	{
+		return scanner;
+	}
+
 	char *textstore;
-	NameBlock *block = Blocks;
-	size_t len = strlen (text) + 1;
+	NameBlock *block = Blocks[shard];
+	size_t len = textLen + 1;
 
 	// Get a block large enough for the name. Only the first block in the
 	// list is ever considered for name storage.
 	if (block == NULL || block->NextAlloc + len >= BLOCK_SIZE)
 	{
-		block = AddBlock (len);
+		block = AddBlock (shard, len);
 	}
 
 	// Copy the string into the block.
 	textstore = (char *)block + block->NextAlloc;
-	strcpy (textstore, text);
+	memcpy (textstore, text, textLen);
+	textstore[textLen] = '\0';
 	block->NextAlloc += len;
 
-	// Add an entry for the name to the NameArray
-	if (NumNames >= MaxNames)
+	// Add an entry for the name to the name array
+	int index = NumNames.fetch_add (1, std::memory_order_relaxed);
+	unsigned int chunk = index >> CHUNK_SHIFT;
+	if (chunk >= MAX_CHUNKS)
 	{
-		// If no names have been defined yet, make the first allocation
-		// large enough to hold all the predefined names.
-		MaxNames += MaxNames == 0 ? countof(PredefinedNames) + NAME_GROW_AMOUNT : NAME_GROW_AMOUNT;
+		I_FatalError ("Out of space for names");
+	}
 
-		NameArray = (NameEntry *)M_Realloc (NameArray, MaxNames * sizeof(NameEntry));
+	NameEntry *entries = Chunks[chunk].load (std::memory_order_acquire);
+	if (entries == NULL)
+	{
+		std::lock_guard<std::mutex> chunklock (ChunkLock);
+		entries = Chunks[chunk].load (std::memory_order_relaxed);
+		if (entries == NULL)
+		{
+			entries = (NameEntry *)M_Malloc (CHUNK_SIZE * sizeof(NameEntry));
+			Chunks[chunk].store (entries, std::memory_order_release);
+		}
 	}
 
-	NameArray[NumNames].Text = textstore;
-	NameArray[NumNames].Hash = hash;
-	NameArray[NumNames].NextHash = Buckets[bucket];
-	Buckets[bucket] = NumNames;
+	NameEntry &entry = entries[index & (CHUNK_SIZE - 1)];
+	entry.Text = textstore;
+	entry.Hash = hash;
+	entry.NextHash = head;
 
-	return NumNames++;
+	// Publish the completed entry.
+	Buckets[bucket].store (index, std::memory_order_release);
+	return index;
 }
 
 //==========================================================================
@@ -241,7 +268,7 @@ int FName::NameManager::AddName (const char *text, unsigned int hash, unsigned i
 //
 //==========================================================================
 
-FName::NameManager::NameBlock *FName::NameManager::AddBlock (size_t len)
+FName::NameManager::NameBlock *FName::NameManager::AddBlock (int shard, size_t len)
 {
 	NameBlock *block;
 
@@ -252,8 +279,8 @@ FName::NameManager::NameBlock *FName::NameManager::AddBlock (size_t len)
 	}
 	block = (NameBlock *)M_Malloc (len);
 	block->NextAlloc = sizeof(NameBlock);
-	block->NextBlock = Blocks;
-	Blocks = block;
+	block->NextBlock = Blocks[shard];
+	Blocks[shard] = block;
 	return block;
 }
 
@@ -271,18 +298,27 @@ FName::NameManager::~NameManager()
 
 	C_ClearTabCommands();
 
-	for (block = Blocks; block != NULL; block = next)
+	for (auto &shardblocks : Blocks)
 	{
-		next = block->NextBlock;
-		M_Free (block);
+		for (block = shardblocks; block != NULL; block = next)
+		{
+			next = block->NextBlock;
+			M_Free (block);
+		}
+		shardblocks = NULL;
 	}
-	Blocks = NULL;
 
-	if (NameArray != NULL)
+	for (auto &chunk : Chunks)
+	{
+		NameEntry *entries = chunk.exchange (NULL);
+		if (entries != NULL)
+		{
+			M_Free (entries);
+		}
+	}
+	NumNames = 0;
+	for (auto &bucket : Buckets)
 	{
-		M_Free (NameArray);
-		NameArray = NULL;
+		bucket.store (-1, std::memory_order_relaxed);
 	}
-	NumNames = MaxNames = 0;
-	memset (Buckets, -1, sizeof(Buckets));
 }
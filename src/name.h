@@ -34,6 +34,9 @@
 #ifndef NAME_H
 #define NAME_H
 
+#include <stddef.h>
+#include <atomic>
+
 enum ENamedName
 {
 #define xx(n) NAME_##n,
@@ -58,8 +61,8 @@ public:
 
 	int GetIndex() const { return Index; }
 	operator int() const { return Index; }
-	const char *GetChars() const { return NameData.NameArray[Index].Text; }
-	operator const char *() const { return NameData.NameArray[Index].Text; }
+	const char *GetChars() const { return NameData.GetEntry(Index).Text; }
+	operator const char *() const { return NameData.GetEntry(Index).Text; }
 
 	FName &operator = (const char *text) { Index = NameData.FindName (text, false); return *this; }
 	FName &operator = (const FString &text);
@@ -68,7 +71,7 @@ public:
 
 	int SetName (const char *text, bool noCreate=false) { return Index = NameData.FindName (text, noCreate); }
 
-	bool IsValidName() const { return (unsigned)Index < (unsigned)NameData.NumNames; }
+	bool IsValidName() const { return (unsigned)Index < (unsigned)NameData.NumNames.load(std::memory_order_relaxed); }
 
 	// Note that the comparison operators compare the names' indices, not
 	// their text, so they cannot be used to do a lexicographical sort.
@@ -89,6 +92,7 @@ public:
 protected:
 	int Index;
 
+	// Entries never change once they have been linked into the hash table.
 	struct NameEntry
 	{
 		char *Text;
@@ -96,6 +100,12 @@ protected:
 		int NextHash;
 	};
 
+	// The name table is safe to use from multiple threads. Lookups never
+	// lock: the name entries live in fixed chunks which are never moved and
+	// new entries only get published by atomically replacing the head of
+	// their hash chain. Insertions lock one of NUM_SHARDS shards, selected
+	// by the hash bucket, so two threads adding the same name will always
+	// serialize on the same lock. Every shard has its own text storage.
 	struct NameManager
 	{
 		// No constructor because we can't ensure that it actually gets
@@ -103,18 +113,31 @@ protected:
 		// means this struct must only exist in the program's BSS section.
 		~NameManager();
 
-		enum { HASH_SIZE = 1024 };
+		enum
+		{
+			HASH_SIZE = 8192,
+			NUM_SHARDS = 16,
+			CHUNK_SHIFT = 12,
+			CHUNK_SIZE = 1 << CHUNK_SHIFT,
+			MAX_CHUNKS = 4096
+		};
 		struct NameBlock;
 
-		NameBlock *Blocks;
-		NameEntry *NameArray;
-		int NumNames, MaxNames;
-		int Buckets[HASH_SIZE];
+		NameBlock *Blocks[NUM_SHARDS];
+		std::atomic<NameEntry *> Chunks[MAX_CHUNKS];
+		std::atomic<int> NumNames;
+		std::atomic<int> Buckets[HASH_SIZE];
+
+		NameEntry &GetEntry (int index) const
+		{
+			return Chunks[index >> CHUNK_SHIFT].load(std::memory_order_relaxed)[index & (CHUNK_SIZE - 1)];
+		}
 
 		int FindName (const char *text, bool noCreate);
 		int FindName (const char *text, size_t textlen, bool noCreate);
-		int AddName (const char *text, unsigned int hash, unsigned int bucket);
-		NameBlock *AddBlock (size_t len);
+		int FindInChain (int scanner, const char *text, size_t textlen, unsigned int hash) const;
+		int AddName (const char *text, size_t textlen, unsigned int hash, unsigned int bucket);
+		NameBlock *AddBlock (int shard, size_t len);
 		void InitBuckets ();
 		static bool Inited;
 	};
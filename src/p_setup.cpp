@@ -106,6 +106,7 @@
 #include "scripting/vm/vm.h"
 
 #include "fragglescript/t_fs.h"
+#include "d_profile.h"
 
 #define MISSING_TEXTURE_WARN_LIMIT		20
 
@@ -3646,9 +3647,32 @@ void P_FreeExtraLevelData()
 //
 //===========================================================================
 
+static const char *LoadTimeNames[] =
+{
+	"load vertexes",
+	"load sectors",
+	"load sides",
+	"load lines",
+	"load sides 2",
+	"load lines 2",
+	"loop sides",
+	"load subsectors",
+	"load nodes",
+	"load segs",
+	"load blockmap",
+	"load reject",
+	"group lines",
+	"flood zones",
+	"load things",
+	"translate teleports",
+	"init polys",
+	"precache"
+};
+
 void P_SetupLevel (const char *lumpname, int position)
 {
-	cycle_t times[20];
+	FProfileScope profile("P_SetupLevel", "level", lumpname);
+	FProfileCycle times[20];
 #if 0
 	FMapThing *buildthings;
 	int numbuildthings;
@@ -3666,6 +3690,7 @@ void P_SetupLevel (const char *lumpname, int position)
 	for (i = 0; i < (int)countof(times); ++i)
 	{
 		times[i].Reset();
+		if (i < (int)countof(LoadTimeNames)) times[i].SetName(LoadTimeNames[i]);
 	}
 
 	level.maptype = MAPTYPE_UNKNOWN;
@@ -4247,28 +4272,7 @@ void P_SetupLevel (const char *lumpname, int position)
 		Printf ("---Total load times---\n");
 		for (i = 0; i < 18; ++i)
 		{
-			static const char *timenames[] =
-			{
-				"load vertexes",
-				"load sectors",
-				"load sides",
-				"load lines",
-				"load sides 2",
-				"load lines 2",
-				"loop sides",
-				"load subsectors",
-				"load nodes",
-				"load segs",
-				"load blockmap",
-				"load reject",
-				"group lines",
-				"flood zones",
-				"load things",
-				"translate teleports",
-				"init polys",
-				"precache"
-			};
-			Printf ("Time%3d:%9.4f ms (%s)\n", i, times[i].TimeMS(), timenames[i]);
+			Printf ("Time%3d:%9.4f ms (%s)\n", i, times[i].TimeMS(), LoadTimeNames[i]);
 		}
 	}
 	MapThingsConverted.Clear();
@@ -4284,6 +4288,9 @@ void P_SetupLevel (const char *lumpname, int position)
 	memcpy(&level.loadlines[0], &level.lines[0], level.lines.Size() * sizeof(level.lines[0]));
 	level.loadsides.Resize(level.sides.Size());
 	memcpy(&level.loadsides[0], &level.sides[0], level.sides.Size() * sizeof(level.sides[0]));
+
+	profile.End();
+	D_WriteProfile();
 }
 
 
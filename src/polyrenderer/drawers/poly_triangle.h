@@ -100,6 +100,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "PolySetTransform"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	const Mat4f *objectToClip;
@@ -112,6 +113,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "PolySetCullCCWCommand"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	bool ccw;
@@ -124,6 +126,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "PolySetCullCCWCommand"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	bool twosided;
@@ -136,6 +139,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "PolySetWeaponSceneCommand"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	bool value;
@@ -148,6 +152,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "PolySetViewport"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	int x;
@@ -169,6 +174,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "DrawPolyTriangles"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	PolyDrawArgs args;
@@ -181,6 +187,7 @@ public:
 
 	void Execute(DrawerThread *thread) override;
 	FString DebugInfo() override { return "DrawRect"; }
+	bool SupportsBands() override { return false; }
 
 private:
 	RectDrawArgs args;
@@ -58,7 +58,8 @@ void PolyRenderer::RenderView(player_t *player, DCanvas *target)
 {
 	using namespace swrenderer;
 	
-	R_ExecuteSetViewSize(Viewpoint, Viewwindow);
+	// The target can be smaller than the screen when the scene is rendered at a lower resolution
+	R_ExecuteSetViewSize(Viewpoint, Viewwindow, target->GetWidth(), target->GetHeight());
 
 	RenderTarget = target;
 	RenderToCanvas = false;
@@ -94,7 +95,9 @@ void PolyRenderer::RenderViewToCanvas(AActor *actor, DCanvas *canvas, int x, int
 	// Render:
 	RenderActorView(actor, dontmaplines);
 	Threads.MainThread()->FlushDrawQueue();
+	PolyDrawerWaitCycles.Clock();
 	DrawerThreads::WaitForWorkers();
+	PolyDrawerWaitCycles.Unclock();
 
 	RenderToCanvas = false;
 
@@ -194,14 +197,15 @@ void PolyRenderer::SetSceneViewport()
 	
 	if (!RenderToCanvas) // Rendering to screen
 	{
+		int screenheight = RenderTarget->GetHeight();
 		int height;
 		if (screenblocks >= 10)
-			height = SCREENHEIGHT;
+			height = screenheight;
 		else
-			height = (screenblocks*SCREENHEIGHT / 10) & ~7;
+			height = (screenblocks*screenheight / 10) & ~7;
 
-		int bottom = SCREENHEIGHT - (height + viewwindowy - ((height - viewheight) / 2));
-		PolyTriangleDrawer::SetViewport(Threads.MainThread()->DrawQueue, viewwindowx, SCREENHEIGHT - bottom - height, viewwidth, height, RenderTarget, false);
+		int bottom = screenheight - (height + viewwindowy - ((height - viewheight) / 2));
+		PolyTriangleDrawer::SetViewport(Threads.MainThread()->DrawQueue, viewwindowx, screenheight - bottom - height, viewwidth, height, RenderTarget, false);
 	}
 	else // Rendering to camera texture
 	{
@@ -414,7 +414,9 @@ void RenderPolyPlayerSprites::RenderSprite(PolyRenderThread *thread, DPSprite *p
 
 	// Check for hardware-assisted 2D. If it's available, and this sprite is not
 	// fuzzy, don't draw it until after the switch to 2D mode.
-	if (!noaccel && !renderToCanvas)
+	// The 2D mode is at screen resolution, so a scene rendered at a lower resolution draws them here.
+	bool scaledScene = renderTarget->GetWidth() != SCREENWIDTH || renderTarget->GetHeight() != SCREENHEIGHT;
+	if (!noaccel && !renderToCanvas && !scaledScene)
 	{
 		FRenderStyle style = vis.RenderStyle;
 		style.CheckFuzz();
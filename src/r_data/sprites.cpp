@@ -33,6 +33,7 @@
 #include "r_data/sprites.h"
 #include "r_data/voxels.h"
 #include "vm.h"
+#include "d_profile.h"
 
 void InitModels();
 
@@ -1004,10 +1005,14 @@ void R_InitSprites ()
 		Skins[i].Scale = type->Scale;
 	}
 
+	FProfileScope phase("R_InitSpriteDefs");
 	R_InitSpriteDefs ();
+	phase.Next("R_InitVoxels");
 	R_InitVoxels();		// [RH] Parse VOXELDEF
 	NumStdSprites = sprites.Size();
+	phase.Next("R_InitSkins");
 	R_InitSkins ();		// [RH] Finish loading skin data
+	phase.End();
 
 	// [RH] Set up base skin
 	// [GRB] Each player class has its own base skin
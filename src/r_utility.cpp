@@ -31,6 +31,7 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
 
 #include "templates.h"
 #include "doomdef.h"
@@ -61,6 +62,7 @@
 #include "sbar.h"
 #include "vm.h"
 #include "i_time.h"
+#include "d_profile.h"
 
 
 // EXTERNAL DATA DECLARATIONS ----------------------------------------------
@@ -143,6 +145,7 @@ bool			setsizeneeded;
 unsigned int	R_OldBlend = ~0;
 int 			validcount = 1; 	// increment every time a check is made
 FCanvasTextureInfo *FCanvasTextureInfo::List;
+int FCanvasTextureInfo::UpdateFrame;
 
 DVector3a view;
 DAngle viewpitch;
@@ -258,16 +261,32 @@ void R_SetWindow (FRenderViewpoint &viewpoint, FViewWindow &viewwindow, int wind
 //==========================================================================
 
 void R_ExecuteSetViewSize (FRenderViewpoint &viewpoint, FViewWindow &viewwindow)
+{
+	R_ExecuteSetViewSize (viewpoint, viewwindow, SCREENWIDTH, SCREENHEIGHT);
+}
+
+//==========================================================================
+//
+// R_ExecuteSetViewSize
+//
+// Sets up the view window for a scene rendered at a different size than
+// the screen. The status bar is scaled along with it.
+//
+//==========================================================================
+
+void R_ExecuteSetViewSize (FRenderViewpoint &viewpoint, FViewWindow &viewwindow, int fullWidth, int fullHeight)
 {
 	setsizeneeded = false;
 
-	R_SetWindow (viewpoint, viewwindow, setblocks, SCREENWIDTH, SCREENHEIGHT, StatusBar->GetTopOfStatusbar());
+	int stHeight = StatusBar->GetTopOfStatusbar() * fullHeight / SCREENHEIGHT;
+
+	R_SetWindow (viewpoint, viewwindow, setblocks, fullWidth, fullHeight, stHeight);
 
 	// Handle resize, e.g. smaller view windows with border and/or status bar.
-	viewwindowx = (screen->GetWidth() - viewwidth) >> 1;
+	viewwindowx = (fullWidth - viewwidth) >> 1;
 
 	// Same with base row offset.
-	viewwindowy = (viewwidth == screen->GetWidth()) ? 0 : (StatusBar->GetTopOfStatusbar() - viewheight) >> 1;
+	viewwindowy = (viewwidth == fullWidth) ? 0 : (stHeight - viewheight) >> 1;
 }
 
 //==========================================================================
@@ -406,9 +425,11 @@ void R_Init ()
 	atterm (R_Shutdown);
 
 	StartScreen->Progress();
+	FProfileScope phase("R_InitTranslationTables");
 	R_InitTranslationTables ();
 	R_SetViewSize (screenblocks);
 
+	phase.Next("SWRenderer::Init");
 	if (SWRenderer == NULL)
 	{
 		SWRenderer = CreateSWRenderer();
@@ -1079,21 +1100,46 @@ DEFINE_ACTION_FUNCTION(_TexMan, SetCameraToTexture)
 //
 // FCanvasTextureInfo :: UpdateAll
 //
-// Updates all canvas textures that were visible in the last frame.
+// Updates the canvas textures that were visible since their last update.
+// Each camera is a full extra scene render, so the number rendered per
+// frame can be limited. The ones that have never been rendered go first,
+// followed by those that have waited longest, which makes the cameras
+// take turns when there are more of them than the budget allows.
 //
 //==========================================================================
 
+CVAR(Int, r_cameratexture_budget, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// camera textures rendered per frame, 0 = all
+CVAR(Int, r_cameratexture_interval, 1, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// frames between two updates of a camera texture
+
 void FCanvasTextureInfo::UpdateAll ()
 {
-	FCanvasTextureInfo *probe;
+	TArray<FCanvasTextureInfo *> pending;
+	int interval = MAX(*r_cameratexture_interval, 1);
 
-	for (probe = List; probe != NULL; probe = probe->Next)
+	UpdateFrame++;
+	for (FCanvasTextureInfo *probe = List; probe != NULL; probe = probe->Next)
 	{
-		if (probe->Viewpoint != NULL && probe->Texture->bNeedsUpdate)
+		if (probe->Viewpoint != NULL && probe->Texture->bNeedsUpdate &&
+			(probe->Texture->bFirstUpdate || UpdateFrame - probe->LastUpdate >= interval))
 		{
-			screen->RenderTextureView(probe->Texture, probe->Viewpoint, probe->FOV);
+			pending.Push(probe);
 		}
 	}
+	if (pending.Size() == 0) return;
+
+	std::stable_sort(&pending[0], &pending[0] + pending.Size(), [](FCanvasTextureInfo *a, FCanvasTextureInfo *b)
+	{
+		if (a->Texture->bFirstUpdate != b->Texture->bFirstUpdate) return a->Texture->bFirstUpdate;
+		return a->LastUpdate < b->LastUpdate;
+	});
+
+	unsigned count = pending.Size();
+	if (r_cameratexture_budget > 0) count = MIN<unsigned>(count, r_cameratexture_budget);
+	for (unsigned i = 0; i < count; i++)
+	{
+		screen->RenderTextureView(pending[i]->Texture, pending[i]->Viewpoint, pending[i]->FOV);
+		pending[i]->LastUpdate = UpdateFrame;
+	}
 }
 
 //==========================================================================
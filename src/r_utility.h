@@ -118,6 +118,7 @@ void R_SetViewAngle (FRenderViewpoint &viewpoint, const FViewWindow &viewwindow)
 // Called by startup code.
 void R_Init (void);
 void R_ExecuteSetViewSize (FRenderViewpoint &viewpoint, FViewWindow &viewwindow);
+void R_ExecuteSetViewSize (FRenderViewpoint &viewpoint, FViewWindow &viewwindow, int fullWidth, int fullHeight);
 
 // Called by M_Responder.
 void R_SetViewSize (int blocks);
@@ -138,6 +139,7 @@ struct FCanvasTextureInfo
 	FCanvasTexture *Texture;
 	FTextureID PicNum;
 	double FOV;
+	int LastUpdate = 0;	// value of UpdateFrame when the texture was last rendered
 
 	static void Add (AActor *viewpoint, FTextureID picnum, double fov);
 	static void UpdateAll ();
@@ -147,6 +149,7 @@ struct FCanvasTextureInfo
 
 private:
 	static FCanvasTextureInfo *List;
+	static int UpdateFrame;
 };
 
 
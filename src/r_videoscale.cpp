@@ -22,6 +22,7 @@
 //
 
 #include <math.h>
+#include "templates.h"
 #include "c_dispatch.h"
 #include "c_cvars.h"
 #include "v_video.h"
@@ -51,6 +52,10 @@ namespace
 	{
 		return (x < 0 || x >= NUMSCALEMODES || vScaleTable[x].isValid == false);
 	}
+
+	float DynamicSceneScale = 1.0f;
+	double AverageSceneMS = 0.0;
+	int FramesSinceScaleChange = 0;
 }
 
 CUSTOM_CVAR(Float, vid_scalefactor, 1.0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
@@ -67,6 +72,27 @@ CUSTOM_CVAR(Int, vid_scalemode, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
 CVAR(Bool, vid_cropaspect, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
+// Dynamic resolution for the software renderers. Only the 3D scene is scaled, 2D drawing stays at native resolution.
+CVAR(Bool, vid_dynamicscale, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+CUSTOM_CVAR(Float, vid_dynamicscale_target, 16.6f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 1.0f)
+		self = 1.0f;
+}
+
+CUSTOM_CVAR(Float, vid_dynamicscale_min, 0.5f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 0.25f || self > 1.0f)
+		self = 0.5f;
+}
+
+CUSTOM_CVAR(Float, vid_dynamicscale_max, 1.0f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 0.25f || self > 1.0f)
+		self = 1.0f;
+}
+
 bool ViewportLinearScale()
 {
 	if (isOutOfBounds(vid_scalemode))
@@ -100,11 +126,73 @@ bool ViewportIsScaled43()
 	return vScaleTable[vid_scalemode].isScaled43;
 }
 
+float ViewportDynamicSceneScale()
+{
+	return vid_dynamicscale ? DynamicSceneScale : 1.0f;
+}
+
+//==========================================================================
+//
+// ViewportUpdateDynamicSceneScale
+//
+// Moves the scene scale towards the target frame time. The render time is
+// roughly proportional to the pixel count, which is the square of the
+// scale. The scale is lowered as soon as the average goes above the target,
+// but only raised if the estimated time at the next step stays well below
+// it, so that it does not oscillate around the target.
+//
+//==========================================================================
+
+void ViewportUpdateDynamicSceneScale(double sceneMS)
+{
+	if (!vid_dynamicscale)
+	{
+		DynamicSceneScale = 1.0f;
+		AverageSceneMS = 0.0;
+		FramesSinceScaleChange = 0;
+		return;
+	}
+
+	// Smooth out single slow frames
+	AverageSceneMS = (AverageSceneMS > 0.0) ? AverageSceneMS * 0.9 + sceneMS * 0.1 : sceneMS;
+
+	// Let the average settle after a change before looking at it again
+	if (++FramesSinceScaleChange < 10)
+		return;
+
+	float minScale = MIN<float>(vid_dynamicscale_min, vid_dynamicscale_max);
+	float maxScale = vid_dynamicscale_max;
+	double target = vid_dynamicscale_target;
+
+	float scale = DynamicSceneScale;
+	if (AverageSceneMS > target)
+	{
+		scale *= (float)MAX(sqrt(target / AverageSceneMS), 0.8);
+	}
+	else
+	{
+		float upscale = MIN(scale * 1.05f, maxScale);
+		if (AverageSceneMS * (upscale * upscale) / (scale * scale) < target * 0.85)
+			scale = upscale;
+	}
+	scale = clamp(scale, minScale, maxScale);
+
+	if (scale != DynamicSceneScale)
+	{
+		// Estimate the average at the new scale rather than waiting for it to catch up
+		AverageSceneMS *= (scale * scale) / (DynamicSceneScale * DynamicSceneScale);
+		DynamicSceneScale = scale;
+		FramesSinceScaleChange = 0;
+	}
+}
+
 void R_ShowCurrentScaling()
 {
 	int x1 = screen->GetClientWidth(), y1 = screen->GetClientHeight(), x2 = int(x1 * vid_scalefactor), y2 = int(y1 * vid_scalefactor);
 	Printf("Current Scale: %f\n", (float)(vid_scalefactor));
 	Printf("Real resolution: %i x %i\nEmulated resolution: %i x %i\n", x1, y1, x2, y2);
+	if (vid_dynamicscale)
+		Printf("Dynamic scene scale: %f (%.2f ms scene time)\n", ViewportDynamicSceneScale(), AverageSceneMS);
 }
 
 bool R_CalcsShouldBeBlocked()
@@ -28,4 +28,6 @@ bool ViewportLinearScale();
 int ViewportScaledWidth(int width, int height);
 int ViewportScaledHeight(int width, int height);
 bool ViewportIsScaled43();
+float ViewportDynamicSceneScale();
+void ViewportUpdateDynamicSceneScale(double sceneMS);
 #endif //__VIDEOSCALE_H__
\ No newline at end of file
@@ -35,6 +35,7 @@
 */
 
 #include <zlib.h>
+#include <mutex>
 #include "resourcefile.h"
 #include "cmdlib.h"
 #include "w_wad.h"
@@ -235,10 +236,16 @@ FileReader FResourceLump::NewReader()
 //
 // Caches a lump's content and increases the reference counter
 //
+// This is serialized so that worker threads can read lumps through
+// the cache. Filling it also uses the resource file's shared reader.
+//
 //==========================================================================
 
+static std::recursive_mutex CacheMutex;
+
 void *FResourceLump::CacheLump()
 {
+	std::lock_guard<std::recursive_mutex> lock(CacheMutex);
 	if (Cache != NULL)
 	{
 		if (RefCount > 0) RefCount++;
@@ -258,6 +265,7 @@ void *FResourceLump::CacheLump()
 
 int FResourceLump::ReleaseCache()
 {
+	std::lock_guard<std::recursive_mutex> lock(CacheMutex);
 	if (LumpSize > 0 && RefCount > 0)
 	{
 		if (--RefCount == 0)
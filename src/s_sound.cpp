@@ -82,6 +82,7 @@
 #include "d_player.h"
 #include "g_levellocals.h"
 #include "vm.h"
+#include "d_profile.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -346,7 +347,9 @@ void S_Init ()
 void S_InitData ()
 {
 	LastLocalSndInfo = LastLocalSndSeq = "";
+	FProfileScope phase("S_ParseSndInfo");
 	S_ParseSndInfo (false);
+	phase.Next("S_ParseSndSeq");
 	S_ParseSndSeq (-1);
 }
 
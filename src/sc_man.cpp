@@ -64,10 +64,12 @@
 #include "i_system.h"
 #include "sc_man.h"
 #include "w_wad.h"
+#include "resourcefiles/resourcefile.h"
 #include "cmdlib.h"
 #include "templates.h"
 #include "doomstat.h"
 #include "v_text.h"
+#include "d_profile.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -131,7 +133,7 @@ FScanner::FScanner()
 
 FScanner::~FScanner()
 {
-	// Humm... Nothing to do in here.
+	Close();
 }
 
 //==========================================================================
@@ -177,9 +179,19 @@ FScanner &FScanner::operator=(const FScanner &other)
 	}
 
 	// Copy protected members
+	if (LockedLump != nullptr)
+	{
+		LockedLump->ReleaseCache();
+	}
+	LockedLump = other.LockedLump;
+	if (LockedLump != nullptr)
+	{
+		LockedLump->CacheLump();
+	}
 	ScriptOpen = true;
 	ScriptName = other.ScriptName;
 	ScriptBuffer = other.ScriptBuffer;
+	ScriptStart = other.ScriptStart;
 	ScriptPtr = other.ScriptPtr;
 	ScriptEndPtr = other.ScriptEndPtr;
 	AlreadyGot = other.AlreadyGot;
@@ -301,17 +313,36 @@ void FScanner::OpenString (const char *name, FString buffer)
 //
 // Loads a script from the lump directory
 //
+// Lumps which already end with a newline are scanned directly from the
+// lump's cache, which is kept locked until the scanner is closed. For
+// lumps in memory files this means no copy at all, and for compressed
+// lumps it saves copying the decompressed data once more.
+//
 //==========================================================================
 
 void FScanner :: OpenLumpNum (int lump)
 {
 	Close ();
-	{
-		FMemLump mem = Wads.ReadLump(lump);
-		ScriptBuffer = mem.GetString();
-	}
+	if (ProfileActive) ProfileStart = I_nsTime();
 	ScriptName = Wads.GetLumpFullPath(lump);
 	LumpNum = lump;
+
+	FResourceLump *reslump = Wads.GetLumpRecord(lump);
+	if (reslump != nullptr && reslump->LumpSize > 0)
+	{
+		const char *data = (const char *)reslump->CacheLump();
+		if (data != nullptr)
+		{
+			if (data[reslump->LumpSize - 1] == '\n')
+			{
+				LockedLump = reslump;
+				StartScript(data, data + reslump->LumpSize);
+				return;
+			}
+			ScriptBuffer = FString(data, reslump->LumpSize);
+		}
+		reslump->ReleaseCache();
+	}
 	PrepareScript ();
 }
 
@@ -342,8 +373,21 @@ void FScanner::PrepareScript ()
 		}
 	}
 
-	ScriptPtr = &ScriptBuffer[0];
-	ScriptEndPtr = &ScriptBuffer[ScriptBuffer.Len()];
+	StartScript(&ScriptBuffer[0], &ScriptBuffer[ScriptBuffer.Len()]);
+}
+
+//==========================================================================
+//
+// FScanner :: StartScript
+//
+// Sets up scanning over a buffer which must end with a '\n'.
+//
+//==========================================================================
+
+void FScanner::StartScript (const char *start, const char *end)
+{
+	ScriptStart = ScriptPtr = start;
+	ScriptEndPtr = end;
 	Line = 1;
 	End = false;
 	ScriptOpen = true;
@@ -368,6 +412,12 @@ void FScanner::PrepareScript ()
 
 void FScanner::Close ()
 {
+	EndProfile();
+	if (LockedLump != nullptr)
+	{
+		LockedLump->ReleaseCache();
+		LockedLump = nullptr;
+	}
 	ScriptOpen = false;
 	ScriptBuffer = "";
 	BigStringBuffer = "";
@@ -375,6 +425,23 @@ void FScanner::Close ()
 	String = StringBuffer;
 }
 
+//==========================================================================
+//
+// FScanner :: EndProfile
+//
+// Reports the time this lump was open as one parse event.
+//
+//==========================================================================
+
+void FScanner::EndProfile()
+{
+	if (ProfileStart != 0)
+	{
+		D_AddProfileEvent(Wads.GetLumpFullName(LumpNum), "lump", ProfileStart, I_nsTime(), ScriptName);
+		ProfileStart = 0;
+	}
+}
+
 //==========================================================================
 //
 // FScanner :: SavePos
@@ -435,9 +502,9 @@ void FScanner::RestorePos (const FScanner::SavedPos &pos)
 
 bool FScanner::isText()
 {
-	for(unsigned int i=0;i<ScriptBuffer.Len();i++)
+	for (const char *p = ScriptStart; p < ScriptEndPtr; p++)
 	{
-		int c = ScriptBuffer[i];
+		int c = *p;
 		if (c < ' ' && c != '\n' && c != '\r' && c != '\t') return false;
 	}
 	return true;
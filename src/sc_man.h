@@ -1,6 +1,8 @@
 #ifndef __SC_MAN_H__
 #define __SC_MAN_H__
 
+struct FResourceLump;
+
 class FScanner
 {
 public:
@@ -91,6 +93,7 @@ public:
 
 protected:
 	void PrepareScript();
+	void StartScript(const char *start, const char *end);
 	void CheckOpen();
 	bool ScanString(bool tokens);
 
@@ -99,6 +102,8 @@ protected:
 
 	bool ScriptOpen;
 	FString ScriptBuffer;
+	FResourceLump *LockedLump = nullptr;	// set when scanning directly over a lump's cache instead of ScriptBuffer
+	const char *ScriptStart;
 	const char *ScriptPtr;
 	const char *ScriptEndPtr;
 	char StringBuffer[MAX_STRING_SIZE];
@@ -113,9 +118,11 @@ protected:
 	bool StateOptions;
 	bool Escape;
 	VersionInfo ParseVersion = { 0, 0, 0 };	// no ZScript extensions by default
+	uint64_t ProfileStart = 0;	// set when a lump gets opened while the startup profiler is active
 
 
 	bool ScanValue(bool allowfloat);
+	void EndProfile();
 };
 
 enum
@@ -51,6 +51,7 @@
 #include "v_text.h"
 #include "backend/codegen.h"
 #include "stats.h"
+#include "d_profile.h"
 
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 void InitThingdef();
@@ -369,15 +370,20 @@ void LoadActors()
 	timer.Reset(); timer.Clock();
 	FScriptPosition::ResetErrorCounter();
 
+	FProfileScope phase("InitThingdef");
 	InitThingdef();
 	FScriptPosition::StrictErrors = true;
+	phase.Next("ParseScripts");
 	ParseScripts();
 
 	FScriptPosition::StrictErrors = false;
+	phase.Next("ParseAllDecorate");
 	ParseAllDecorate();
 	SynthesizeFlagFields();
 
+	phase.Next("FunctionBuildList::Build");
 	FunctionBuildList.Build();
+	phase.Next("CheckStates");
 
 	if (FScriptPosition::ErrorCounter > 0)
 	{
@@ -438,6 +444,7 @@ void LoadActors()
 		I_Error("%d errors during actor postprocessing", FScriptPosition::ErrorCounter);
 	}
 
+	phase.End();
 	timer.Unclock();
 	if (!batchrun) Printf("script parsing took %.2f ms\n", timer.TimeMS());
 
@@ -33,6 +33,8 @@
 */
 
 #include <string.h>
+#include <ctype.h>
+#include <algorithm>
 
 #include "stringtable.h"
 #include "cmdlib.h"
@@ -42,6 +44,7 @@
 #include "c_dispatch.h"
 #include "v_text.h"
 #include "gi.h"
+#include "templates.h"
 
 // PassNum identifies which language pass this string is from.
 // PassNum 0 is for DeHacked.
@@ -50,18 +53,41 @@
 
 struct FStringTable::StringEntry
 {
-	StringEntry *Next;
-	char *Name;
+	const char *Name;
+	char *String;
+	uint64_t Hash;
 	uint8_t PassNum;
-	char String[];
 };
 
-FStringTable::FStringTable ()
+// Case insensitive 64 bit FNV-1a. Wide enough that the perfect hash
+// construction below never runs into two names with the same hash.
+static uint64_t HashName (const char *name)
 {
-	for (int i = 0; i < HASH_SIZE; ++i)
+	uint64_t hash = 14695981039346656037ull;
+	for (; *name != '\0'; ++name)
 	{
-		Buckets[i] = NULL;
+		hash ^= (uint8_t)tolower ((unsigned char)*name);
+		hash *= 1099511628211ull;
 	}
+	return hash;
+}
+
+static inline unsigned HashSlot (uint64_t hash, uint32_t seed, unsigned numslots)
+{
+	hash ^= seed * 0x9e3779b97f4a7c15ull;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return unsigned(hash % numslots);
+}
+
+// Linearly searched SetString additions before the hash gets rebuilt.
+enum { MAX_UNHASHED = 64 };
+
+FStringTable::FStringTable ()
+	: Arena (64*1024)
+{
+	HashedCount = 0;
 }
 
 FStringTable::~FStringTable ()
@@ -71,83 +97,117 @@ FStringTable::~FStringTable ()
 
 void FStringTable::FreeData ()
 {
-	for (int i = 0; i < HASH_SIZE; ++i)
-	{
-		StringEntry *entry = Buckets[i], *next;
-		Buckets[i] = NULL;
-		while (entry != NULL)
-		{
-			next = entry->Next;
-			M_Free (entry);
-			entry = next;
-		}
-	}
+	Entries.Clear ();
+	Seeds.Clear ();
+	Slots.Clear ();
+	HashedCount = 0;
+	Arena.FreeAll ();
 }
 
+// Starts over with only the DeHacked strings, which are copied out first
+// because they live in the arena as well.
 void FStringTable::FreeNonDehackedStrings ()
 {
-	for (int i = 0; i < HASH_SIZE; ++i)
-	{
-		StringEntry *entry, *next, **pentry;
+	TArray<FString> dehacked;
 
-		for (pentry = &Buckets[i], entry = *pentry; entry != NULL; )
+	for (auto &entry : Entries)
+	{
+		if (entry.PassNum == 0)
 		{
-			next = entry->Next;
-			if (entry->PassNum != 0)
-			{
-				*pentry = next;
-				M_Free (entry);
-			}
-			else
-			{
-				pentry = &entry->Next;
-			}
-			entry = next;
+			dehacked.Push (entry.Name);
+			dehacked.Push (entry.String);
 		}
 	}
+	FreeData ();
+	for (unsigned i = 0; i < dehacked.Size(); i += 2)
+	{
+		AddEntry (dehacked[i], dehacked[i+1], dehacked[i+1].Len(), 0);
+	}
+}
+
+void FStringTable::AddEntry (const char *name, const char *string, size_t len, int passnum)
+{
+	size_t namelen = strlen (name);
+	char *text = (char *)Arena.Alloc (len + namelen + 2);
+	memcpy (text, string, len);
+	text[len] = '\0';
+	memcpy (text + len + 1, name, namelen + 1);
+
+	StringEntry &entry = Entries[Entries.Reserve(1)];
+	entry.Name = text + len + 1;
+	entry.String = text;
+	entry.Hash = HashName (name);
+	entry.PassNum = passnum;
 }
 
 void FStringTable::LoadStrings (bool enuOnly)
+{
+	ReadLanguageLumps ();
+	ParseLanguageLumps (enuOnly);
+}
+
+// Each lump gets scanned once per language pass so it is only read once here.
+void FStringTable::ReadLanguageLumps ()
 {
 	int lastlump, lump;
+
+	LanguageLumps.Clear ();
+	lastlump = 0;
+
+	while ((lump = Wads.FindLump ("LANGUAGE", &lastlump)) != -1)
+	{
+		auto &ll = LanguageLumps[LanguageLumps.Reserve(1)];
+		ll.Name = Wads.GetLumpFullPath (lump);
+		ll.Text = Wads.ReadLump (lump).GetString ();
+	}
+}
+
+void FStringTable::ParseLanguageLumps (bool enuOnly)
+{
+	TMap<FString, int> index;
 	int i, j;
 
 	FreeNonDehackedStrings ();
 
-	lastlump = 0;
+	for (unsigned k = 0; k < Entries.Size(); ++k)
+	{
+		FString key = Entries[k].Name;
+		key.ToUpper ();
+		index[key] = k;
+	}
 
-	while ((lump = Wads.FindLump ("LANGUAGE", &lastlump)) != -1)
+	for (auto &lump : LanguageLumps)
 	{
 		j = 0;
 		if (!enuOnly)
 		{
-			LoadLanguage (lump, MAKE_ID('*',0,0,0), true, ++j);
+			LoadLanguage (lump, index, MAKE_ID('*',0,0,0), true, ++j);
 			for (i = 0; i < 4; ++i)
 			{
-				LoadLanguage (lump, LanguageIDs[i], true, ++j);
-				LoadLanguage (lump, LanguageIDs[i] & MAKE_ID(0xff,0xff,0,0), true, ++j);
-				LoadLanguage (lump, LanguageIDs[i], false, ++j);
+				LoadLanguage (lump, index, LanguageIDs[i], true, ++j);
+				LoadLanguage (lump, index, LanguageIDs[i] & MAKE_ID(0xff,0xff,0,0), true, ++j);
+				LoadLanguage (lump, index, LanguageIDs[i], false, ++j);
 			}
 		}
 
 		// Fill in any missing strings with the default language
-		LoadLanguage (lump, MAKE_ID('*','*',0,0), true, ++j);
+		LoadLanguage (lump, index, MAKE_ID('*','*',0,0), true, ++j);
 	}
+	LanguageLumps.Clear ();
+	BuildHash ();
 }
 
-void FStringTable::LoadLanguage (int lumpnum, uint32_t code, bool exactMatch, int passnum)
+void FStringTable::LoadLanguage (const LanguageLump &lump, TMap<FString, int> &index, uint32_t code, bool exactMatch, int passnum)
 {
 	static bool errordone = false;
 	const uint32_t orMask = exactMatch ? 0 : MAKE_ID(0,0,0xff,0);
 	uint32_t inCode = 0;
-	StringEntry *entry, **pentry;
-	uint32_t bucket;
-	int cmpval;
 	bool skip = true;
 
 	code |= orMask;
 
-	FScanner sc(lumpnum);
+	FScanner sc;
+	sc.OpenString (lump.Name, lump.Text);
 	sc.SetCMode (true);
 	while (sc.GetString ())
 	{
@@ -250,45 +310,162 @@ void FStringTable::LoadLanguage (int lumpnum, uint32_t code, bool exactMatch, in
 			FString strName (sc.String);
 			sc.MustGetStringName ("=");
 			sc.MustGetString ();
+
 			FString strText (sc.String, ProcessEscapes (sc.String));
 			sc.MustGetString ();
 			while (!sc.Compare (";"))
 			{
-				ProcessEscapes (sc.String);
-				strText += sc.String;
+				strText.AppendCStrPart (sc.String, ProcessEscapes (sc.String));
 				sc.MustGetString ();
 			}
 
 			// Does this string exist? If so, should we overwrite it?
-			bucket = MakeKey (strName.GetChars()) & (HASH_SIZE-1);
-			pentry = &Buckets[bucket];
-			entry = *pentry;
-			cmpval = 1;
-			while (entry != NULL)
+			FString key = strName;
+			key.ToUpper ();
+			int *pindex = index.CheckKey (key);
+			if (pindex == NULL)
 			{
-				cmpval = stricmp (entry->Name, strName.GetChars());
-				if (cmpval >= 0)
-					break;
-				pentry = &entry->Next;
-				entry = *pentry;
+				index[key] = Entries.Size();
+				AddEntry (strName.GetChars(), strText.GetChars(), strText.Len(), passnum);
+			}
+			else if (Entries[*pindex].PassNum >= passnum)
+			{
+				StringEntry &entry = Entries[*pindex];
+				char *text = (char *)Arena.Alloc (strText.Len() + 1);
+				memcpy (text, strText.GetChars(), strText.Len() + 1);
+				entry.String = text;
+				entry.PassNum = passnum;
+			}
+		}
+	}
+}
+
+//==========================================================================
+//
+// FStringTable :: BuildHash
+//
+// Builds a perfect hash over all entries with the hash-and-displace
+// method: The names are spread over buckets of about 4 entries each, and
+// for each bucket, starting with the largest, a seed is searched for
+// that maps all of its names to free slots.
+//
+//==========================================================================
+
+void FStringTable::BuildHash ()
+{
+	unsigned count = Entries.Size();
+	unsigned numbuckets = MAX(1u, count / 4);
+	unsigned numslots = MAX(1u, count + count / 4);
+
+	// Sort the entries by bucket so that each bucket's members are contiguous.
+	TArray<unsigned> bucketstart(numbuckets + 1, true);
+	TArray<int> members(count, true);
+	memset (&bucketstart[0], 0, (numbuckets + 1) * sizeof(unsigned));
+	for (auto &entry : Entries)
+	{
+		bucketstart[unsigned((entry.Hash >> 32) % numbuckets) + 1]++;
+	}
+	for (unsigned i = 0; i < numbuckets; ++i)
+	{
+		bucketstart[i + 1] += bucketstart[i];
+	}
+	{
+		TArray<unsigned> fill(numbuckets, true);
+		memcpy (&fill[0], &bucketstart[0], numbuckets * sizeof(unsigned));
+		for (unsigned i = 0; i < count; ++i)
+		{
+			members[fill[unsigned((Entries[i].Hash >> 32) % numbuckets)]++] = i;
+		}
+	}
+
+	TArray<unsigned> order(numbuckets, true);
+	for (unsigned i = 0; i < numbuckets; ++i)
+	{
+		order[i] = i;
+	}
+	std::sort (&order[0], &order[0] + numbuckets, [&](unsigned a, unsigned b)
+	{
+		return bucketstart[a + 1] - bucketstart[a] > bucketstart[b + 1] - bucketstart[b];
+	});
+
+	for (;;)
+	{
+		Seeds.Resize (numbuckets);
+		Slots.Resize (numslots);
+		memset (&Seeds[0], 0, numbuckets * sizeof(uint32_t));
+		memset (&Slots[0], -1, numslots * sizeof(int));
+
+		bool failed = false;
+		for (unsigned b : order)
+		{
+			const int *bucket = &members[0] + bucketstart[b];
+			unsigned size = bucketstart[b + 1] - bucketstart[b];
+			if (size == 0)
+			{
+				break;
 			}
-			if (cmpval == 0 && entry->PassNum >= passnum)
+			uint32_t seed;
+			for (seed = 0; seed < 1000000; ++seed)
 			{
-				*pentry = entry->Next;
-				M_Free (entry);
-				entry = NULL;
+				unsigned j;
+				for (j = 0; j < size; ++j)
+				{
+					unsigned slot = HashSlot (Entries[bucket[j]].Hash, seed, numslots);
+					if (Slots[slot] >= 0) break;
+					Slots[slot] = bucket[j];
+				}
+				if (j == size)
+				{
+					break;
+				}
+				while (j-- > 0)
+				{
+					Slots[HashSlot (Entries[bucket[j]].Hash, seed, numslots)] = -1;
+				}
 			}
-			if (entry == NULL || cmpval > 0)
+			if (seed == 1000000)
 			{
-				entry = (StringEntry *)M_Malloc (sizeof(*entry) + strText.Len() + strName.Len() + 2);
-				entry->Next = *pentry;
-				*pentry = entry;
-				strcpy (entry->String, strText.GetChars());
-				strcpy (entry->Name = entry->String + strText.Len() + 1, strName.GetChars());
-				entry->PassNum = passnum;
+				failed = true;
+				break;
 			}
+			Seeds[b] = seed;
+		}
+		if (!failed)
+		{
+			break;
+		}
+		// Practically impossible with 64 bit hashes, but give it more room if it happens.
+		numslots *= 2;
+	}
+	HashedCount = count;
+}
+
+//==========================================================================
+//
+// FStringTable :: FindEntry
+//
+//==========================================================================
+
+int FStringTable::FindEntry (const char *name) const
+{
+	uint64_t hash = HashName (name);
+
+	if (HashedCount > 0)
+	{
+		int index = Slots[HashSlot (hash, Seeds[unsigned((hash >> 32) % Seeds.Size())], Slots.Size())];
+		if (index >= 0 && Entries[index].Hash == hash && stricmp (Entries[index].Name, name) == 0)
+		{
+			return index;
 		}
 	}
+	for (unsigned i = HashedCount; i < Entries.Size(); ++i)
+	{
+		if (Entries[i].Hash == hash && stricmp (Entries[i].Name, name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
 }
 
 // Replace \ escape sequences in a string with the escaped characters.
@@ -301,6 +478,8 @@ size_t FStringTable::ProcessEscapes (char *iptr)
 		if (c == '\\')
 		{
 			c = *iptr++;
+			if (c == '\0')
+				break;
 			if (c == 'n')
 				c = '\n';
 			else if (c == 'c')
@@ -325,23 +504,8 @@ const char *FStringTable::operator[] (const char *name) const
 	{
 		return NULL;
 	}
-	uint32_t bucket = MakeKey (name) & (HASH_SIZE - 1);
-	StringEntry *entry = Buckets[bucket];
-
-	while (entry != NULL)
-	{
-		int cmpval = stricmp (entry->Name, name);
-		if (cmpval == 0)
-		{
-			return entry->String;
-		}
-		if (cmpval == 1)
-		{
-			return NULL;
-		}
-		entry = entry->Next;
-	}
-	return NULL;
+	int index = FindEntry (name);
+	return index >= 0 ? Entries[index].String : NULL;
 }
 
 // Finds a string by name and returns its value. If the string does
@@ -352,46 +516,14 @@ const char *FStringTable::operator() (const char *name) const
 	return str ? str : name;
 }
 
-// Find a string by name. pentry1 is a pointer to a pointer to it, and entry1 is a
-// pointer to it. Return NULL for entry1 if it wasn't found.
-void FStringTable::FindString (const char *name, StringEntry **&pentry1, StringEntry *&entry1)
-{
-	uint32_t bucket = MakeKey (name) & (HASH_SIZE - 1);
-	StringEntry **pentry = &Buckets[bucket], *entry = *pentry;
-
-	while (entry != NULL)
-	{
-		int cmpval = stricmp (entry->Name, name);
-		if (cmpval == 0)
-		{
-			pentry1 = pentry;
-			entry1 = entry;
-			return;
-		}
-		if (cmpval == 1)
-		{
-			pentry1 = pentry;
-			entry1 = NULL;
-			return;
-		}
-		pentry = &entry->Next;
-		entry = *pentry;
-	}
-	pentry1 = pentry;
-	entry1 = entry;
-}
-
 // Find a string with the same exact text. Returns its name.
 const char *FStringTable::MatchString (const char *string) const
 {
-	for (int i = 0; i < HASH_SIZE; ++i)
+	for (unsigned i = 0; i < Entries.Size(); ++i)
 	{
-		for (StringEntry *entry = Buckets[i]; entry != NULL; entry = entry->Next)
+		if (strcmp (Entries[i].String, string) == 0)
 		{
-			if (strcmp (entry->String, string) == 0)
-			{
-				return entry->Name;
-			}
+			return Entries[i].Name;
 		}
 	}
 	return NULL;
@@ -399,28 +531,24 @@ const char *FStringTable::MatchString (const char *string) const
 
 void FStringTable::SetString (const char *name, const char *newString)
 {
-	StringEntry **pentry, *oentry;
-	FindString (name, pentry, oentry);
-
+	int index = FindEntry (name);
 	size_t newlen = strlen (newString);
-	size_t namelen = strlen (name);
 
-	// Create a new string entry
-	StringEntry *entry = (StringEntry *)M_Malloc (sizeof(*entry) + newlen + namelen + 2);
-	strcpy (entry->String, newString);
-	strcpy (entry->Name = entry->String + newlen + 1, name);
-	entry->PassNum = 0;
-
-	// If this is a new string, insert it. Otherwise, replace the old one.
-	if (oentry == NULL)
+	if (index < 0)
 	{
-		entry->Next = *pentry;
-		*pentry = entry;
+		AddEntry (name, newString, newlen, 0);
+		if (Entries.Size() - HashedCount > MAX_UNHASHED)
+		{
+			BuildHash ();
+		}
 	}
 	else
 	{
-		*pentry = entry;
-		entry->Next = oentry->Next;
-		M_Free (oentry);
+		// The old text stays in the arena until the next reparse, so that
+		// pointers handed out for it remain valid.
+		StringEntry &entry = Entries[index];
+		entry.String = (char *)Arena.Alloc (newlen + 1);
+		memcpy (entry.String, newString, newlen + 1);
+		entry.PassNum = 0;
 	}
 }
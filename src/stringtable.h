@@ -45,6 +45,7 @@
 
 #include <stdlib.h>
 #include "doomtype.h"
+#include "memarena.h"
 
 class FStringTable
 {
@@ -56,6 +57,11 @@ public:
 
 	void LoadStrings (bool enuOnly);
 
+	// LoadStrings split in two, so that the parsing, which does not touch
+	// the lump directory, can run on a worker thread.
+	void ReadLanguageLumps ();
+	void ParseLanguageLumps (bool enuOnly);
+
 	const char *operator() (const char *name) const;	// Never returns NULL
 	const char *operator[] (const char *name) const;	// Can return NULL
 
@@ -63,15 +69,30 @@ public:
 	void SetString (const char *name, const char *newString);
 
 private:
-	enum { HASH_SIZE = 128 };
+	struct LanguageLump
+	{
+		FString Name;
+		FString Text;
+	};
 
-	StringEntry *Buckets[HASH_SIZE];
+	// All names and texts live in Arena. Lookups go through a perfect
+	// hash (Seeds and Slots) which is rebuilt after each parse.
+	// Entries added by SetString afterwards are searched linearly until
+	// there are enough of them to warrant a rebuild.
+	FMemArena Arena;
+	TArray<StringEntry> Entries;
+	TArray<uint32_t> Seeds;
+	TArray<int> Slots;
+	unsigned HashedCount;
+	TArray<LanguageLump> LanguageLumps;
 
 	void FreeData ();
 	void FreeNonDehackedStrings ();
-	void LoadLanguage (int lumpnum, uint32_t code, bool exactMatch, int passnum);
+	void LoadLanguage (const LanguageLump &lump, TMap<FString, int> &index, uint32_t code, bool exactMatch, int passnum);
 	static size_t ProcessEscapes (char *str);
-	void FindString (const char *stringName, StringEntry **&pentry, StringEntry *&entry);
+	int FindEntry (const char *name) const;
+	void AddEntry (const char *name, const char *string, size_t len, int passnum);
+	void BuildHash ();
 };
 
 #endif //__STRINGTABLE_H__
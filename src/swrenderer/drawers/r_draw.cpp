@@ -268,6 +268,7 @@ namespace swrenderer
 		}
 
 		FString DebugInfo() override { return "DepthColumnCommand"; }
+		bool GetLines(int &first_line, int &count) override { first_line = y; count = this->count; return true; }
 
 		void Execute(DrawerThread *thread) override
 		{
@@ -309,10 +310,11 @@ namespace swrenderer
 		}
 
 		FString DebugInfo() override { return "DepthSpanCommand"; }
+		bool GetLines(int &first_line, int &count) override { first_line = y; count = 1; return true; }
 
 		void Execute(DrawerThread *thread) override
 		{
-			if (thread->skipped_by_thread(y))
+			if (thread->line_skipped_by_thread(y))
 				return;
 
 			auto zbuffer = PolyZBuffer::Instance();
@@ -361,6 +363,12 @@ namespace swrenderer
 		#endif
 	};
 
+	void SWPixelFormatDrawers::DrawWallColumns4(const WallDrawerArgs *args)
+	{
+		for (int i = 0; i < 4; i++)
+			DrawWallColumn(args[i]);
+	}
+
 	void SWPixelFormatDrawers::DrawDepthSkyColumn(const SkyDrawerArgs &args, float idepth)
 	{
 		Queue->Push<DepthColumnCommand>(args, idepth);
@@ -95,6 +95,9 @@ namespace swrenderer
 		virtual void DrawColoredSpan(const SpanDrawerArgs &args) = 0;
 		virtual void DrawFogBoundaryLine(const SpanDrawerArgs &args) = 0;
 
+		// Four adjacent opaque wall columns, from left to right
+		virtual void DrawWallColumns4(const WallDrawerArgs *args);
+
 		void DrawDepthSkyColumn(const SkyDrawerArgs &args, float idepth);
 		void DrawDepthWallColumn(const WallDrawerArgs &args, float idepth);
 		void DrawDepthSpan(const SpanDrawerArgs &args, float idepth1, float idepth2);
@@ -0,0 +1,222 @@
+/*
+**  Helpers shared by the AVX2 truecolor drawers
+**  Copyright (c) 2016 Magnus Norddahl
+**  Copyright (c) 2018 The GZDoom development team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include <immintrin.h>
+#include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/drawers/r_draw32_sse2.h"
+
+namespace swrenderer
+{
+	// The AVX2 drawers work on eight pixels at a time. The pixels are
+	// unpacked to 16 bits per channel the same way the SSE2 drawers do it,
+	// which leaves pixels 0, 1, 4, 5 in the low half and 2, 3, 6, 7 in the
+	// high half. Packing the two halves again restores the original order.
+	namespace DrawAVX2
+	{
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL UnpackLo(__m256i color)
+		{
+			return _mm256_unpacklo_epi8(color, _mm256_setzero_si256());
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL UnpackHi(__m256i color)
+		{
+			return _mm256_unpackhi_epi8(color, _mm256_setzero_si256());
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Pack(__m256i lo, __m256i hi)
+		{
+			return _mm256_or_si256(_mm256_packus_epi16(lo, hi), _mm256_set1_epi32(0xff000000));
+		}
+
+		// Takes a 32 bit value per pixel, saturates it to 16 bits and places it in all four channels.
+		AVX2_TARGET FORCEINLINE void VECTORCALL Splat(__m256i value, __m256i &lo, __m256i &hi)
+		{
+			__m256i value16 = _mm256_packs_epi32(value, value);
+			value16 = _mm256_unpacklo_epi16(value16, value16);
+			lo = _mm256_unpacklo_epi32(value16, value16);
+			hi = _mm256_unpackhi_epi32(value16, value16);
+		}
+
+		// The desaturation intensity of each pixel in the red, green and blue channels.
+		AVX2_TARGET FORCEINLINE void VECTORCALL Intensity(__m256i color, int desaturate, __m256i &lo, __m256i &hi)
+		{
+			__m256i mask = _mm256_set1_epi32(0xff);
+			__m256i red = _mm256_and_si256(_mm256_srli_epi32(color, 16), mask);
+			__m256i green = _mm256_and_si256(_mm256_srli_epi32(color, 8), mask);
+			__m256i blue = _mm256_and_si256(color, mask);
+			__m256i intensity = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(red, _mm256_set1_epi32(77)), _mm256_mullo_epi32(green, _mm256_set1_epi32(143))), _mm256_mullo_epi32(blue, _mm256_set1_epi32(37)));
+			intensity = _mm256_mullo_epi32(_mm256_srli_epi32(intensity, 8), _mm256_set1_epi32(desaturate));
+			intensity = _mm256_and_si256(intensity, _mm256_set1_epi32(0xffff));
+
+			__m256i bluegreen = _mm256_or_si256(intensity, _mm256_slli_epi32(intensity, 16));
+			lo = _mm256_unpacklo_epi32(bluegreen, intensity);
+			hi = _mm256_unpackhi_epi32(bluegreen, intensity);
+		}
+
+		// Source and destination alpha of the AddClamp, SubClamp and RevSubClamp blend modes.
+		AVX2_TARGET FORCEINLINE void VECTORCALL BlendAlpha(__m256i color, uint32_t srcalpha, uint32_t destalpha, __m256i &fgalpha, __m256i &bgalpha)
+		{
+			__m256i alpha = _mm256_srli_epi32(color, 24);
+			alpha = _mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 7)); // 255->256
+			__m256i inv_alpha = _mm256_sub_epi32(_mm256_set1_epi32(256), alpha);
+			__m256i round = _mm256_set1_epi32(128);
+			bgalpha = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(destalpha), alpha), _mm256_slli_epi32(inv_alpha, 8)), round), 8);
+			fgalpha = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(srcalpha), alpha), round), 8);
+		}
+
+		// fgcolor * fgalpha + bgcolor * bgalpha, added or subtracted in 32 bit precision.
+		template<int Op>
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL BlendClamp(__m256i fgcolor, __m256i bgcolor, __m256i fgalpha, __m256i bgalpha)
+		{
+			fgcolor = _mm256_mullo_epi16(fgcolor, fgalpha);
+			bgcolor = _mm256_mullo_epi16(bgcolor, bgalpha);
+
+			__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+			__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+			__m256i out_lo, out_hi;
+			if (Op == 0)
+			{
+				out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+			}
+			else if (Op == 1)
+			{
+				out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+			}
+			else
+			{
+				out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+				out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+			}
+
+			out_lo = _mm256_srai_epi32(out_lo, 8);
+			out_hi = _mm256_srai_epi32(out_hi, 8);
+			return _mm256_packs_epi32(out_lo, out_hi);
+		}
+
+		enum { BlendAdd, BlendSub, BlendRevSub };
+
+		// Picks the background where the foreground is completely black, like the masked SSE2 drawers.
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL BlendMasked(__m256i fgcolor, __m256i bgcolor)
+		{
+			__m256i mask = _mm256_cmpeq_epi32(_mm256_packus_epi16(fgcolor, _mm256_setzero_si256()), _mm256_setzero_si256());
+			mask = _mm256_unpacklo_epi8(mask, _mm256_setzero_si256());
+			return _mm256_or_si256(_mm256_and_si256(mask, bgcolor), _mm256_andnot_si256(mask, fgcolor));
+		}
+
+		// The dynamic light contribution of eight pixels. pos holds the view position
+		// along the axis the drawer steps, which is x for spans and z for walls.
+		// The attenuation is computed with the SSE2 drawer code on each half of
+		// pos so that both drawer sets light the pixels identically.
+		AVX2_TARGET FORCEINLINE void VECTORCALL LightContribution(const DrawerLight *lights, int num_lights, __m256 pos, bool spanlights, __m256i &lit_lo, __m256i &lit_hi)
+		{
+			lit_lo = _mm256_setzero_si256();
+			lit_hi = _mm256_setzero_si256();
+
+			__m128 pos_lo = _mm256_castps256_ps128(pos);
+			__m128 pos_hi = _mm256_extractf128_ps(pos, 1);
+
+			for (int i = 0; i != num_lights; i++)
+			{
+				// Walls store L.x*L.x + L.y*L.y in x and the normal part in y,
+				// spans store L.y*L.y + L.z*L.z in y and the normal part in z.
+				__m128 light_pos = _mm_set1_ps(spanlights ? lights[i].x : lights[i].z);
+				__m128 light_dist2 = _mm_set1_ps(spanlights ? lights[i].y : lights[i].x);
+				__m128 light_normal = _mm_set1_ps(spanlights ? lights[i].z : lights[i].y);
+				__m128 light_radius = _mm_set1_ps(lights[i].radius);
+
+				__m128i attenuation0 = DrawSSE2::LightAttenuation(light_pos, light_dist2, light_normal, light_radius, pos_lo);
+				__m128i attenuation1 = DrawSSE2::LightAttenuation(light_pos, light_dist2, light_normal, light_radius, pos_hi);
+				__m256i attenuation = _mm256_inserti128_si256(_mm256_castsi128_si256(attenuation0), attenuation1, 1);
+				__m256i attenuation_lo, attenuation_hi;
+				Splat(attenuation, attenuation_lo, attenuation_hi);
+
+				__m256i light_color = _mm256_broadcastsi128_si256(_mm_unpacklo_epi8(_mm_set1_epi32(lights[i].color), _mm_setzero_si128()));
+
+				lit_lo = _mm256_add_epi16(lit_lo, _mm256_srli_epi16(_mm256_mullo_epi16(light_color, attenuation_lo), 8));
+				lit_hi = _mm256_add_epi16(lit_hi, _mm256_srli_epi16(_mm256_mullo_epi16(light_color, attenuation_hi), 8));
+			}
+
+			lit_lo = _mm256_min_epi16(lit_lo, _mm256_set1_epi16(256));
+			lit_hi = _mm256_min_epi16(lit_hi, _mm256_set1_epi16(256));
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL AddLights(__m256i material, __m256i fgcolor, __m256i lit)
+		{
+			fgcolor = _mm256_add_epi16(fgcolor, _mm256_srli_epi16(_mm256_mullo_epi16(material, lit), 8));
+			return _mm256_min_epi16(fgcolor, _mm256_set1_epi16(255));
+		}
+
+		// Reads and writes eight pixels of a column.
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL LoadColumn(const uint32_t *dest, __m256i offsets)
+		{
+			return _mm256_i32gather_epi32((const int*)dest, offsets, 4);
+		}
+
+		AVX2_TARGET FORCEINLINE void VECTORCALL StoreColumn(uint32_t *dest, int pitch, __m256i color)
+		{
+			__m128i lo = _mm256_castsi256_si128(color);
+			__m128i hi = _mm256_extracti128_si256(color, 1);
+			dest[0] = _mm_cvtsi128_si32(lo);
+			dest[pitch] = _mm_extract_epi32(lo, 1);
+			dest[pitch * 2] = _mm_extract_epi32(lo, 2);
+			dest[pitch * 3] = _mm_extract_epi32(lo, 3);
+			dest[pitch * 4] = _mm_cvtsi128_si32(hi);
+			dest[pitch * 5] = _mm_extract_epi32(hi, 1);
+			dest[pitch * 6] = _mm_extract_epi32(hi, 2);
+			dest[pitch * 7] = _mm_extract_epi32(hi, 3);
+		}
+
+		// base + i * step for the eight lanes
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Ramp(uint32_t base, uint32_t step)
+		{
+			return _mm256_add_epi32(_mm256_set1_epi32(base), _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step)));
+		}
+
+		// The view positions of the next eight pixels. The SSE2 drawers step two
+		// pixels at a time by adding twice the step, and this repeats those adds
+		// so that the positions round the same way. pair holds the positions of
+		// the next two pixels in lanes 0 and 1 and is advanced by eight pixels.
+		AVX2_TARGET FORCEINLINE __m256 VECTORCALL StepViewPos(__m128 &pair, __m128 step2)
+		{
+			__m128 p0 = pair;
+			__m128 p1 = _mm_add_ps(p0, step2);
+			__m128 p2 = _mm_add_ps(p1, step2);
+			__m128 p3 = _mm_add_ps(p2, step2);
+			pair = _mm_add_ps(p3, step2);
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_movelh_ps(p0, p1)), _mm_movelh_ps(p2, p3), 1);
+		}
+
+		// Broadcasts the 16 bit per channel constants of the SSE2 drawers.
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Broadcast(__m128i value)
+		{
+			return _mm256_broadcastsi128_si256(value);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/*
+**  Helpers shared by the SSE2 truecolor drawers
+**  Copyright (c) 2016 Magnus Norddahl
+**  Copyright (c) 2018 The GZDoom development team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_rgba.h"
+
+namespace swrenderer
+{
+	namespace DrawSSE2
+	{
+		// Distance and diffuse attenuation of the lights in each lane, in the 0-256 range.
+		FORCEINLINE __m128i VECTORCALL LightAttenuation(__m128 light_pos, __m128 light_dist2, __m128 light_normal, __m128 light_radius, __m128 pos)
+		{
+			__m128 m256 = _mm_set1_ps(256.0f);
+
+			// L = light-pos
+			// dist = sqrt(dot(L, L))
+			// distance_attenuation = 1 - MIN(dist * (1/radius), 1)
+			__m128 L = _mm_sub_ps(light_pos, pos);
+			__m128 dist2 = _mm_add_ps(light_dist2, _mm_mul_ps(L, L));
+			__m128 rcp_dist = _mm_rsqrt_ps(dist2);
+			__m128 dist = _mm_mul_ps(dist2, rcp_dist);
+			__m128 distance_attenuation = _mm_sub_ps(m256, _mm_min_ps(_mm_mul_ps(dist, light_radius), m256));
+
+			// The simple light type
+			__m128 simple_attenuation = distance_attenuation;
+
+			// The point light type
+			// diffuse = dot(N,L) * attenuation
+			__m128 point_attenuation = _mm_mul_ps(_mm_mul_ps(light_normal, rcp_dist), distance_attenuation);
+
+			__m128 is_attenuated = _mm_cmpeq_ps(light_normal, _mm_setzero_ps());
+			return _mm_cvtps_epi32(_mm_or_ps(_mm_and_ps(is_attenuated, simple_attenuation), _mm_andnot_ps(is_attenuated, point_attenuation)));
+		}
+
+		// Light color scaled by the attenuation of two pixels, 16 bits per channel.
+		FORCEINLINE __m128i VECTORCALL LightColor(uint32_t color, __m128i attenuation0, __m128i attenuation1)
+		{
+			__m128i attenuation = _mm_packs_epi32(attenuation0, attenuation1);
+
+			__m128i light_color = _mm_cvtsi32_si128(color);
+			light_color = _mm_unpacklo_epi8(light_color, _mm_setzero_si128());
+			light_color = _mm_shuffle_epi32(light_color, _MM_SHUFFLE(1, 0, 1, 0));
+
+			return _mm_srli_epi16(_mm_mullo_epi16(light_color, attenuation), 8);
+		}
+
+		// Sums the dynamic lights for the two pixels at pos (lanes 0 and 1).
+		// Walls store L.x*L.x + L.y*L.y in x and the normal part in y,
+		// spans store L.y*L.y + L.z*L.z in y and the normal part in z.
+		//
+		// Two pixels only fill half of a register, so the lights are processed in
+		// pairs with the first light in lanes 0-1 and the second one in lanes 2-3.
+		FORCEINLINE __m128i VECTORCALL LightContribution(const DrawerLight *lights, int num_lights, __m128 pos, bool spanlights)
+		{
+			__m128i lit = _mm_setzero_si128();
+			pos = _mm_movelh_ps(pos, pos);
+
+			int i = 0;
+			for (; i + 1 < num_lights; i += 2)
+			{
+				const DrawerLight &light0 = lights[i];
+				const DrawerLight &light1 = lights[i + 1];
+
+				__m128 light_pos = spanlights ? _mm_setr_ps(light0.x, light0.x, light1.x, light1.x) : _mm_setr_ps(light0.z, light0.z, light1.z, light1.z);
+				__m128 light_dist2 = spanlights ? _mm_setr_ps(light0.y, light0.y, light1.y, light1.y) : _mm_setr_ps(light0.x, light0.x, light1.x, light1.x);
+				__m128 light_normal = spanlights ? _mm_setr_ps(light0.z, light0.z, light1.z, light1.z) : _mm_setr_ps(light0.y, light0.y, light1.y, light1.y);
+				__m128 light_radius = _mm_setr_ps(light0.radius, light0.radius, light1.radius, light1.radius);
+
+				__m128i attenuation = LightAttenuation(light_pos, light_dist2, light_normal, light_radius, pos);
+				lit = _mm_add_epi16(lit, LightColor(light0.color, _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(1, 1, 1, 1))));
+				lit = _mm_add_epi16(lit, LightColor(light1.color, _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(3, 3, 3, 3))));
+			}
+
+			if (i < num_lights)
+			{
+				const DrawerLight &light = lights[i];
+				__m128 light_pos = _mm_set1_ps(spanlights ? light.x : light.z);
+				__m128 light_dist2 = _mm_set1_ps(spanlights ? light.y : light.x);
+				__m128 light_normal = _mm_set1_ps(spanlights ? light.z : light.y);
+				__m128 light_radius = _mm_set1_ps(light.radius);
+
+				__m128i attenuation = LightAttenuation(light_pos, light_dist2, light_normal, light_radius, pos);
+				lit = _mm_add_epi16(lit, LightColor(light.color, _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(1, 1, 1, 1))));
+			}
+
+			return _mm_min_epi16(lit, _mm_set1_epi16(256));
+		}
+	}
+}
@@ -34,7 +34,7 @@
 */
 
 #ifndef NO_SSE
-#include <xmmintrin.h>
+#include <immintrin.h>
 #endif
 #include "templates.h"
 #include "doomtype.h"
@@ -43,6 +43,7 @@
 #include "r_draw.h"
 #include "v_video.h"
 #include "r_draw_pal.h"
+#include "x86.h"
 #include "swrenderer/viewport/r_viewport.h"
 #include "swrenderer/scene/r_light.h"
 
@@ -201,6 +202,115 @@ namespace swrenderer
 		}
 	}
 
+	DrawWall4PalCommand::DrawWall4PalCommand(const WallDrawerArgs *args)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			columns[i].dest = args[i].Dest();
+			columns[i].y = args[i].DestY();
+			columns[i].count = args[i].Count();
+			columns[i].frac = args[i].TextureVPos();
+			columns[i].fracstep = args[i].TextureVStep();
+			columns[i].source = args[i].TexturePixels();
+			columns[i].colormap = args[i].Colormap(args[i].Viewport());
+		}
+		bits = args[0].TextureFracBits();
+		pitch = args[0].Viewport()->RenderTarget->GetPitch();
+	}
+
+	bool DrawWall4PalCommand::GetLines(int &first_line, int &count)
+	{
+		int y1 = columns[0].y, y2 = columns[0].y + columns[0].count;
+		for (int i = 1; i < 4; i++)
+		{
+			y1 = MIN(y1, columns[i].y);
+			y2 = MAX(y2, columns[i].y + columns[i].count);
+		}
+		first_line = y1;
+		count = y2 - y1;
+		return true;
+	}
+
+	void DrawWall4PalCommand::Execute(DrawerThread *thread)
+	{
+		// Rows drawn by all four columns
+		int y1 = columns[0].y, y2 = columns[0].y + columns[0].count;
+		for (int i = 1; i < 4; i++)
+		{
+			y1 = MAX(y1, columns[i].y);
+			y2 = MIN(y2, columns[i].y + columns[i].count);
+		}
+
+		if (y2 <= y1)
+		{
+			for (int i = 0; i < 4; i++)
+				DrawRows(thread, columns[i], columns[i].y, columns[i].y + columns[i].count);
+			return;
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			DrawRows(thread, columns[i], columns[i].y, y1);
+			DrawRows(thread, columns[i], y2, columns[i].y + columns[i].count);
+		}
+
+		int count = thread->count_for_thread(y1, y2 - y1);
+		if (count <= 0)
+			return;
+
+		int skipped = thread->skipped_by_thread(y1);
+		uint8_t *dest = columns[0].dest + (y1 - columns[0].y + skipped) * pitch;
+		int destpitch = pitch * thread->num_cores;
+
+		uint32_t frac0 = columns[0].frac + columns[0].fracstep * (y1 - columns[0].y + skipped);
+		uint32_t frac1 = columns[1].frac + columns[1].fracstep * (y1 - columns[1].y + skipped);
+		uint32_t frac2 = columns[2].frac + columns[2].fracstep * (y1 - columns[2].y + skipped);
+		uint32_t frac3 = columns[3].frac + columns[3].fracstep * (y1 - columns[3].y + skipped);
+		uint32_t fracstep0 = columns[0].fracstep * thread->num_cores;
+		uint32_t fracstep1 = columns[1].fracstep * thread->num_cores;
+		uint32_t fracstep2 = columns[2].fracstep * thread->num_cores;
+		uint32_t fracstep3 = columns[3].fracstep * thread->num_cores;
+		const uint8_t *source0 = columns[0].source, *source1 = columns[1].source, *source2 = columns[2].source, *source3 = columns[3].source;
+		const uint8_t *colormap0 = columns[0].colormap, *colormap1 = columns[1].colormap, *colormap2 = columns[2].colormap, *colormap3 = columns[3].colormap;
+		int bits = this->bits;
+
+		do
+		{
+			dest[0] = colormap0[source0[frac0 >> bits]];
+			dest[1] = colormap1[source1[frac1 >> bits]];
+			dest[2] = colormap2[source2[frac2 >> bits]];
+			dest[3] = colormap3[source3[frac3 >> bits]];
+			frac0 += fracstep0;
+			frac1 += fracstep1;
+			frac2 += fracstep2;
+			frac3 += fracstep3;
+			dest += destpitch;
+		} while (--count);
+	}
+
+	// Draws the rows y1 to y2 of a single column
+	void DrawWall4PalCommand::DrawRows(DrawerThread *thread, const Column &column, int y1, int y2)
+	{
+		int count = thread->count_for_thread(y1, y2 - y1);
+		if (count <= 0)
+			return;
+
+		int skipped = thread->skipped_by_thread(y1);
+		uint8_t *dest = column.dest + (y1 - column.y + skipped) * pitch;
+		uint32_t frac = column.frac + column.fracstep * (y1 - column.y + skipped);
+		uint32_t fracstep = column.fracstep * thread->num_cores;
+		int destpitch = pitch * thread->num_cores;
+		const uint8_t *source = column.source;
+		const uint8_t *colormap = column.colormap;
+
+		do
+		{
+			*dest = colormap[source[frac >> bits]];
+			frac += fracstep;
+			dest += destpitch;
+		} while (--count);
+	}
+
 	void DrawWallMasked1PalCommand::Execute(DrawerThread *thread)
 	{
 		uint32_t fracstep = args.TextureVStep();
@@ -566,6 +676,9 @@ namespace swrenderer
 		int end_fadetop_y = (fade_length - frac) / fracstep;
 		int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
 		int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+
+		// The fades below stop at the end of the band rendered by this thread
+		count = MIN(count, thread->band_end - args.DestY());
 		start_fadetop_y = clamp(start_fadetop_y, 0, count);
 		end_fadetop_y = clamp(end_fadetop_y, 0, count);
 		start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
@@ -702,6 +815,9 @@ namespace swrenderer
 		int end_fadetop_y = (fade_length - frac) / fracstep;
 		int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
 		int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+
+		// The fades below stop at the end of the band rendered by this thread
+		count = MIN(count, thread->band_end - args.DestY());
 		start_fadetop_y = clamp(start_fadetop_y, 0, count);
 		end_fadetop_y = clamp(end_fadetop_y, 0, count);
 		start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
@@ -1451,6 +1567,39 @@ namespace swrenderer
 		} while (--count);
 	}
 
+#ifndef NO_SSE
+	// Draws count & ~3 pixels of an add-clamp column four at a time with SSE2 and advances
+	// the column state past them. Only the blend math is vectorized, the table lookups stay
+	// scalar. The AVX2 gathers were slower than the scalar lookups for these byte tables.
+	static void DrawColumnAddClamp_SSE2(uint8_t *&dest, int &count, fixed_t &frac, fixed_t fracstep, int pitch, const uint8_t *source, const uint8_t *colormap, const uint32_t *fg2rgb, const uint32_t *bg2rgb)
+	{
+		for (; count >= 4; count -= 4)
+		{
+			fixed_t frac1 = frac + fracstep;
+			fixed_t frac2 = frac1 + fracstep;
+			fixed_t frac3 = frac2 + fracstep;
+			__m128i fg = _mm_setr_epi32(fg2rgb[colormap[source[frac >> FRACBITS]]], fg2rgb[colormap[source[frac1 >> FRACBITS]]], fg2rgb[colormap[source[frac2 >> FRACBITS]]], fg2rgb[colormap[source[frac3 >> FRACBITS]]]);
+			__m128i bg = _mm_setr_epi32(bg2rgb[dest[0]], bg2rgb[dest[pitch]], bg2rgb[dest[pitch * 2]], bg2rgb[dest[pitch * 3]]);
+
+			__m128i a = _mm_add_epi32(fg, bg);
+			__m128i b = _mm_and_si128(a, _mm_set1_epi32(0x40100400));
+			a = _mm_and_si128(_mm_or_si128(a, _mm_set1_epi32(0x01f07c1f)), _mm_set1_epi32(0x3fffffff));
+			b = _mm_sub_epi32(b, _mm_srli_epi32(b, 5));
+			a = _mm_or_si128(a, b);
+
+			alignas(16) int32_t index[4];
+			_mm_store_si128((__m128i*)index, _mm_and_si128(a, _mm_srli_epi32(a, 15)));
+			dest[0] = RGB32k.All[index[0]];
+			dest[pitch] = RGB32k.All[index[1]];
+			dest[pitch * 2] = RGB32k.All[index[2]];
+			dest[pitch * 3] = RGB32k.All[index[3]];
+
+			dest += pitch * 4;
+			frac = frac3 + fracstep;
+		}
+	}
+#endif
+
 	void DrawColumnAddClampPalCommand::Execute(DrawerThread *thread)
 	{
 		int count;
@@ -1482,7 +1631,12 @@ namespace swrenderer
 
 		if (!r_blendmethod)
 		{
-			do
+#ifndef NO_SSE
+			if (CPU.bSSE2)
+				DrawColumnAddClamp_SSE2(dest, count, frac, fracstep, pitch, source, colormap, fg2rgb, bg2rgb);
+#endif
+
+			for (; count > 0; count--)
 			{
 				uint32_t a = fg2rgb[colormap[source[frac >> FRACBITS]]] + bg2rgb[*dest];
 				uint32_t b = a;
@@ -1495,7 +1649,7 @@ namespace swrenderer
 				*dest = RGB32k.All[a & (a >> 15)];
 				dest += pitch;
 				frac += fracstep;
-			} while (--count);
+			}
 		}
 		else
 		{
@@ -2084,6 +2238,104 @@ namespace swrenderer
 		return RGB256k.All[((lit_r >> 2) << 12) | ((lit_g >> 2) << 6) | (lit_b >> 2)];
 	}
 
+#ifndef NO_SSE
+	// The 64x64 span loops below step four pixels at a time with SSE2. Only
+	// the texel addressing and the blend math are vectorized, as there is no
+	// gather for the table lookups. Each function draws count & ~3 pixels and
+	// advances the span state past them; the scalar loops finish the rest.
+	class FSpanSpots64SSE2
+	{
+	public:
+		FSpanSpots64SSE2(uint32_t xfrac, uint32_t yfrac, uint32_t xstep, uint32_t ystep)
+		{
+			xf = _mm_setr_epi32(xfrac, xfrac + xstep, xfrac + xstep * 2, xfrac + xstep * 3);
+			yf = _mm_setr_epi32(yfrac, yfrac + ystep, yfrac + ystep * 2, yfrac + ystep * 3);
+			xstep4 = _mm_set1_epi32(xstep * 4);
+			ystep4 = _mm_set1_epi32(ystep * 4);
+		}
+
+		// spot = ((xfrac >> (32 - 6 - 6))&(63 * 64)) + (yfrac >> (32 - 6))
+		void Next(int32_t *spots)
+		{
+			__m128i spot = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(xf, 32 - 6 - 6), _mm_set1_epi32(63 * 64)), _mm_srli_epi32(yf, 32 - 6));
+			_mm_store_si128((__m128i*)spots, spot);
+			xf = _mm_add_epi32(xf, xstep4);
+			yf = _mm_add_epi32(yf, ystep4);
+		}
+
+		uint32_t XFrac() const { return _mm_cvtsi128_si32(xf); }
+		uint32_t YFrac() const { return _mm_cvtsi128_si32(yf); }
+
+	private:
+		__m128i xf, yf, xstep4, ystep4;
+	};
+
+	static void DrawSpan64_SSE2(uint8_t *&dest, int &count, uint32_t &xfrac, uint32_t &yfrac, uint32_t xstep, uint32_t ystep, const uint8_t *source, const uint8_t *colormap)
+	{
+		FSpanSpots64SSE2 spots(xfrac, yfrac, xstep, ystep);
+		alignas(16) int32_t spot[4];
+		for (; count >= 4; count -= 4, dest += 4)
+		{
+			spots.Next(spot);
+			dest[0] = colormap[source[spot[0]]];
+			dest[1] = colormap[source[spot[1]]];
+			dest[2] = colormap[source[spot[2]]];
+			dest[3] = colormap[source[spot[3]]];
+		}
+		xfrac = spots.XFrac();
+		yfrac = spots.YFrac();
+	}
+
+	// Returns fg2rgb[fg] + bg2rgb[bg] for the next four pixels.
+	static inline __m128i SpanBlendSum_SSE2(FSpanSpots64SSE2 &spots, const uint8_t *dest, const uint8_t *source, const uint8_t *colormap, const uint32_t *fg2rgb, const uint32_t *bg2rgb)
+	{
+		alignas(16) int32_t spot[4];
+		spots.Next(spot);
+		__m128i fg = _mm_setr_epi32(fg2rgb[colormap[source[spot[0]]]], fg2rgb[colormap[source[spot[1]]]], fg2rgb[colormap[source[spot[2]]]], fg2rgb[colormap[source[spot[3]]]]);
+		__m128i bg = _mm_setr_epi32(bg2rgb[dest[0]], bg2rgb[dest[1]], bg2rgb[dest[2]], bg2rgb[dest[3]]);
+		return _mm_add_epi32(fg, bg);
+	}
+
+	// Writes RGB32k.All[a & (a >> 15)] for the four lanes of a.
+	static inline void SpanStoreRGB32k_SSE2(uint8_t *dest, __m128i a)
+	{
+		alignas(16) int32_t index[4];
+		_mm_store_si128((__m128i*)index, _mm_and_si128(a, _mm_srli_epi32(a, 15)));
+		dest[0] = RGB32k.All[index[0]];
+		dest[1] = RGB32k.All[index[1]];
+		dest[2] = RGB32k.All[index[2]];
+		dest[3] = RGB32k.All[index[3]];
+	}
+
+	static void DrawSpanTranslucent64_SSE2(uint8_t *&dest, int &count, uint32_t &xfrac, uint32_t &yfrac, uint32_t xstep, uint32_t ystep, const uint8_t *source, const uint8_t *colormap, const uint32_t *fg2rgb, const uint32_t *bg2rgb)
+	{
+		FSpanSpots64SSE2 spots(xfrac, yfrac, xstep, ystep);
+		for (; count >= 4; count -= 4, dest += 4)
+		{
+			__m128i fg = SpanBlendSum_SSE2(spots, dest, source, colormap, fg2rgb, bg2rgb);
+			fg = _mm_or_si128(fg, _mm_set1_epi32(0x1f07c1f));
+			SpanStoreRGB32k_SSE2(dest, fg);
+		}
+		xfrac = spots.XFrac();
+		yfrac = spots.YFrac();
+	}
+
+	static void DrawSpanAddClamp64_SSE2(uint8_t *&dest, int &count, uint32_t &xfrac, uint32_t &yfrac, uint32_t xstep, uint32_t ystep, const uint8_t *source, const uint8_t *colormap, const uint32_t *fg2rgb, const uint32_t *bg2rgb)
+	{
+		FSpanSpots64SSE2 spots(xfrac, yfrac, xstep, ystep);
+		for (; count >= 4; count -= 4, dest += 4)
+		{
+			__m128i a = SpanBlendSum_SSE2(spots, dest, source, colormap, fg2rgb, bg2rgb);
+			__m128i b = _mm_and_si128(a, _mm_set1_epi32(0x40100400));
+			a = _mm_and_si128(_mm_or_si128(a, _mm_set1_epi32(0x01f07c1f)), _mm_set1_epi32(0x3fffffff));
+			b = _mm_sub_epi32(b, _mm_srli_epi32(b, 5));
+			SpanStoreRGB32k_SSE2(dest, _mm_or_si128(a, b));
+		}
+		xfrac = spots.XFrac();
+		yfrac = spots.YFrac();
+	}
+#endif
+
 	void DrawSpanPalCommand::Execute(DrawerThread *thread)
 	{
 		if (thread->line_skipped_by_thread(_y))
@@ -2116,8 +2368,13 @@ namespace swrenderer
 
 		if (_srcwidth == 64 && _srcheight == 64 && num_dynlights == 0)
 		{
+#ifndef NO_SSE
+			if (CPU.bSSE2)
+				DrawSpan64_SSE2(dest, count, xfrac, yfrac, xstep, ystep, source, colormap);
+#endif
+
 			// 64x64 is the most common case by far, so special case it.
-			do
+			for (; count > 0; count--)
 			{
 				// Current texture index in u,v.
 				spot = ((xfrac >> (32 - 6 - 6))&(63 * 64)) + (yfrac >> (32 - 6));
@@ -2129,7 +2386,7 @@ namespace swrenderer
 				// Next step in u,v.
 				xfrac += xstep;
 				yfrac += ystep;
-			} while (--count);
+			}
 		}
 		else if (_srcwidth == 64 && _srcheight == 64)
 		{
@@ -2281,8 +2538,13 @@ namespace swrenderer
 		{
 			if (_srcwidth == 64 && _srcheight == 64)
 			{
+#ifndef NO_SSE
+				if (CPU.bSSE2 && num_dynlights == 0)
+					DrawSpanTranslucent64_SSE2(dest, count, xfrac, yfrac, xstep, ystep, source, colormap, fg2rgb, bg2rgb);
+#endif
+
 				// 64x64 is the most common case by far, so special case it.
-				do
+				for (; count > 0; count--)
 				{
 					spot = ((xfrac >> (32 - 6 - 6))&(63 * 64)) + (yfrac >> (32 - 6));
 					uint32_t fg = num_dynlights != 0 ? AddLights(dynlights, num_dynlights, viewpos_x, colormap[source[spot]], source[spot]) : colormap[source[spot]];
@@ -2294,7 +2556,7 @@ namespace swrenderer
 					xfrac += xstep;
 					yfrac += ystep;
 					viewpos_x += step_viewpos_x;
-				} while (--count);
+				}
 			}
 			else
 			{
@@ -2538,8 +2800,13 @@ namespace swrenderer
 		{
 			if (_srcwidth == 64 && _srcheight == 64)
 			{
+#ifndef NO_SSE
+				if (CPU.bSSE2 && num_dynlights == 0)
+					DrawSpanAddClamp64_SSE2(dest, count, xfrac, yfrac, xstep, ystep, source, colormap, fg2rgb, bg2rgb);
+#endif
+
 				// 64x64 is the most common case by far, so special case it.
-				do
+				for (; count > 0; count--)
 				{
 					spot = ((xfrac >> (32 - 6 - 6))&(63 * 64)) + (yfrac >> (32 - 6));
 					uint32_t fg = num_dynlights != 0 ? AddLights(dynlights, num_dynlights, viewpos_x, colormap[source[spot]], source[spot]) : colormap[source[spot]];
@@ -2555,7 +2822,7 @@ namespace swrenderer
 					xfrac += xstep;
 					yfrac += ystep;
 					viewpos_x += step_viewpos_x;
-				} while (--count);
+				}
 			}
 			else
 			{
@@ -3163,8 +3430,92 @@ namespace swrenderer
 		}
 	}
 
+	bool DrawVoxelBlocksPalCommand::GetLines(int &first_line, int &count)
+	{
+		int y1 = 0x7fffffff, y2 = 0;
+		for (int i = 0; i < blockcount; i++)
+		{
+			y1 = MIN(y1, blocks[i].y);
+			y2 = MAX(y2, blocks[i].y + blocks[i].height);
+		}
+		first_line = y1;
+		count = y2 - y1;
+		return blockcount > 0;
+	}
+
 	FString DrawVoxelBlocksPalCommand::DebugInfo()
 	{
 		return "DrawVoxelBlocks";
 	}
+
+	/////////////////////////////////////////////////////////////////////////////
+
+	ExpandPaletteCommand::ExpandPaletteCommand(const uint8_t *src, int srcpitch, uint32_t *dest, int destpitch, int width, int height, const uint32_t *palette)
+		: _src(src), _srcpitch(srcpitch), _dest(dest), _destpitch(destpitch), _width(width), _height(height), _palette(palette)
+	{
+	}
+
+#if !defined(NO_SSE) && defined(AVX2_TARGET)
+	// Expands width & ~7 pixels of a row, eight at a time with the AVX2 gather, and returns
+	// how many it did. Only call this when CPU.bAVX2 is set.
+	AVX2_TARGET static int ExpandPaletteRow_AVX2(const uint8_t *src, uint32_t *dest, int width, const uint32_t *palette)
+	{
+		int avx_end = width & ~7;
+		for (int x = 0; x < avx_end; x += 8)
+		{
+			__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x)));
+			_mm256_storeu_si256((__m256i*)(dest + x), _mm256_i32gather_epi32((const int*)palette, index, 4));
+		}
+		return avx_end;
+	}
+#endif
+
+	void ExpandPaletteCommand::Execute(DrawerThread *thread)
+	{
+		int count = thread->count_for_thread(0, _height);
+		if (count <= 0)
+			return;
+
+		const uint8_t *src = thread->dest_for_thread(0, _srcpitch, _src);
+		uint32_t *dest = thread->dest_for_thread(0, _destpitch, _dest);
+		int srcpitch = _srcpitch * thread->num_cores;
+		int destpitch = _destpitch * thread->num_cores;
+		int width = _width;
+		const uint32_t *palette = _palette;
+
+#if !defined(NO_SSE) && defined(AVX2_TARGET)
+		bool avx2 = CPU.bAVX2;
+#endif
+
+		while (count > 0)
+		{
+			int x = 0;
+#if !defined(NO_SSE) && defined(AVX2_TARGET)
+			if (avx2)
+				x = ExpandPaletteRow_AVX2(src, dest, width, palette);
+#endif
+#ifndef NO_SSE
+			// There is no byte lookup in SSE2. Gather four pixels at a time and write them with a single store.
+			int sse_end = width & ~3;
+			for (; x < sse_end; x += 4)
+			{
+				__m128i p = _mm_setr_epi32(palette[src[x]], palette[src[x + 1]], palette[src[x + 2]], palette[src[x + 3]]);
+				_mm_storeu_si128((__m128i*)(dest + x), p);
+			}
+#endif
+			for (; x < width; x++)
+			{
+				dest[x] = palette[src[x]];
+			}
+
+			src += srcpitch;
+			dest += destpitch;
+			count--;
+		}
+	}
+
+	FString ExpandPaletteCommand::DebugInfo()
+	{
+		return "ExpandPalette";
+	}
 }
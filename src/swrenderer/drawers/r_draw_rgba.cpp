@@ -78,6 +78,9 @@ CVAR(Bool, r_mipmap, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 // Level of detail texture bias
 CVAR(Float, r_lod_bias, -1.5, 0); // To do: add CVAR_ARCHIVE | CVAR_GLOBALCONFIG when a good default has been decided
 
+// Use the AVX2 drawers if the CPU supports them
+CVAR(Bool, r_drawers_avx2, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+
 namespace swrenderer
 {
 	void SWTruecolorDrawers::DrawWallColumn(const WallDrawerArgs &args)
@@ -967,6 +970,19 @@ namespace swrenderer
 		}
 	}
 
+	bool DrawVoxelBlocksRGBACommand::GetLines(int &first_line, int &count)
+	{
+		int y1 = 0x7fffffff, y2 = 0;
+		for (int i = 0; i < blockcount; i++)
+		{
+			y1 = MIN(y1, blocks[i].y);
+			y2 = MAX(y2, blocks[i].y + blocks[i].height);
+		}
+		first_line = y1;
+		count = y2 - y1;
+		return blockcount > 0;
+	}
+
 	FString DrawVoxelBlocksRGBACommand::DebugInfo()
 	{
 		return "DrawVoxelBlocks";
@@ -38,6 +38,7 @@ struct FSpecialColormap;
 
 EXTERN_CVAR(Bool, r_mipmap)
 EXTERN_CVAR(Float, r_lod_bias)
+EXTERN_CVAR(Bool, r_drawers_avx2)
 
 namespace swrenderer
 {
@@ -84,6 +85,7 @@ namespace swrenderer
 		DrawFuzzColumnRGBACommand(const SpriteDrawerArgs &drawerargs);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = MAX(_yl, 1); count = MIN(_yh, _fuzzviewheight) - first_line + 1; return true; }
 	};
 
 	class DrawScaledFuzzColumnRGBACommand : public DrawerCommand
@@ -100,6 +102,7 @@ namespace swrenderer
 		DrawScaledFuzzColumnRGBACommand(const SpriteDrawerArgs &drawerargs);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = MAX(_yl, 1); count = MIN(_yh, _fuzzviewheight) - first_line + 1; return true; }
 	};
 
 	class FillSpanRGBACommand : public DrawerCommand
@@ -115,6 +118,7 @@ namespace swrenderer
 		FillSpanRGBACommand(const SpanDrawerArgs &drawerargs);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = _y; count = 1; return true; }
 	};
 
 	class DrawFogBoundaryLineRGBACommand : public DrawerCommand
@@ -130,6 +134,7 @@ namespace swrenderer
 		DrawFogBoundaryLineRGBACommand(const SpanDrawerArgs &drawerargs);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = _y; count = 1; return true; }
 	};
 
 	class DrawTiltedSpanRGBACommand : public DrawerCommand
@@ -157,6 +162,7 @@ namespace swrenderer
 		DrawTiltedSpanRGBACommand(const SpanDrawerArgs &drawerargs, const FVector3 &plane_sz, const FVector3 &plane_su, const FVector3 &plane_sv, bool plane_shade, int planeshade, float planelightfloat, fixed_t pviewx, fixed_t pviewy);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = _y; count = 1; return true; }
 	};
 
 	class DrawColoredSpanRGBACommand : public DrawerCommand
@@ -173,6 +179,7 @@ namespace swrenderer
 
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = _y; count = 1; return true; }
 	};
 
 #if 0
@@ -220,6 +227,7 @@ namespace swrenderer
 		DrawParticleColumnRGBACommand(uint32_t *dest, int dest_y, int pitch, int count, uint32_t fg, uint32_t alpha, uint32_t fracposx);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override { first_line = _dest_y; count = _count; return true; }
 
 	private:
 		uint32_t *_dest;
@@ -239,6 +247,7 @@ namespace swrenderer
 		DrawVoxelBlocksRGBACommand(const SpriteDrawerArgs &args, const VoxelBlock *blocks, int blockcount);
 		void Execute(DrawerThread *thread) override;
 		FString DebugInfo() override;
+		bool GetLines(int &first_line, int &count) override;
 
 	private:
 		SpriteDrawerArgs args;
@@ -297,6 +306,10 @@ namespace swrenderer
 		void DrawFogBoundaryLine(const SpanDrawerArgs &args) override { Queue->Push<DrawFogBoundaryLineRGBACommand>(args); }
 	};
 
+	// Returns the AVX2 versions of the drawers, or null if the compiler could not build them.
+	// Must only be used if the CPU supports AVX2.
+	SWTruecolorDrawers *CreateAVX2TruecolorDrawers(DrawerCommandQueuePtr queue);
+
 	/////////////////////////////////////////////////////////////////////////////
 	// Pixel shading inline functions:
 
@@ -0,0 +1,113 @@
+/*
+** r_draw_rgba_avx2.cpp
+** AVX2 versions of the true color wall, span, sprite and sky drawers
+**
+**---------------------------------------------------------------------------
+** Copyright 2018 The GZDoom development team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The file is compiled without AVX2 so that the inline code it shares with
+** the other drawers stays usable on any CPU. Only the command Execute
+** functions and their helpers are marked with AVX2_TARGET, and the drawers
+** only get used after CheckCPUID has confirmed that both CPU and OS support it.
+**
+** The output is identical to the SSE2 drawers, including the dynamic lights.
+**
+*/
+
+#include "templates.h"
+#include "doomtype.h"
+#include "swrenderer/drawers/r_draw_rgba.h"
+
+#if !defined(NO_SSE) && defined(AVX2_TARGET)
+
+#include "swrenderer/drawers/r_draw_wall32_avx2.h"
+#include "swrenderer/drawers/r_draw_sprite32_avx2.h"
+#include "swrenderer/drawers/r_draw_span32_avx2.h"
+#include "swrenderer/drawers/r_draw_sky32_avx2.h"
+
+namespace swrenderer
+{
+	// The fuzz, voxel and the remaining span drawers have no AVX2 version
+	// and are inherited from SWTruecolorDrawers. The span blend modes are
+	// mapped the same way SWTruecolorDrawers maps them.
+	class SWTruecolorDrawersAVX2 : public SWTruecolorDrawers
+	{
+	public:
+		using SWTruecolorDrawers::SWTruecolorDrawers;
+
+		void DrawWallColumn(const WallDrawerArgs &args) override { Queue->Push<DrawWall32AVX2Command>(args); }
+		void DrawWallMaskedColumn(const WallDrawerArgs &args) override { Queue->Push<DrawWallMasked32AVX2Command>(args); }
+		void DrawWallAddColumn(const WallDrawerArgs &args) override { Queue->Push<DrawWallAddClamp32AVX2Command>(args); }
+		void DrawWallAddClampColumn(const WallDrawerArgs &args) override { Queue->Push<DrawWallAddClamp32AVX2Command>(args); }
+		void DrawWallSubClampColumn(const WallDrawerArgs &args) override { Queue->Push<DrawWallSubClamp32AVX2Command>(args); }
+		void DrawWallRevSubClampColumn(const WallDrawerArgs &args) override { Queue->Push<DrawWallRevSubClamp32AVX2Command>(args); }
+		void DrawSingleSkyColumn(const SkyDrawerArgs &args) override { Queue->Push<DrawSkySingle32AVX2Command>(args); }
+		void DrawDoubleSkyColumn(const SkyDrawerArgs &args) override { Queue->Push<DrawSkyDouble32AVX2Command>(args); }
+		void DrawColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSprite32AVX2Command>(args); }
+		void FillColumn(const SpriteDrawerArgs &args) override { Queue->Push<FillSprite32AVX2Command>(args); }
+		void FillAddColumn(const SpriteDrawerArgs &args) override { Queue->Push<FillSpriteAddClamp32AVX2Command>(args); }
+		void FillAddClampColumn(const SpriteDrawerArgs &args) override { Queue->Push<FillSpriteAddClamp32AVX2Command>(args); }
+		void FillSubClampColumn(const SpriteDrawerArgs &args) override { Queue->Push<FillSpriteSubClamp32AVX2Command>(args); }
+		void FillRevSubClampColumn(const SpriteDrawerArgs &args) override { Queue->Push<FillSpriteRevSubClamp32AVX2Command>(args); }
+		void DrawAddColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteAddClamp32AVX2Command>(args); }
+		void DrawTranslatedColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteTranslated32AVX2Command>(args); }
+		void DrawTranslatedAddColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteTranslatedAddClamp32AVX2Command>(args); }
+		void DrawShadedColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteShaded32AVX2Command>(args); }
+		void DrawAddClampShadedColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteAddClampShaded32AVX2Command>(args); }
+		void DrawAddClampColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteAddClamp32AVX2Command>(args); }
+		void DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteTranslatedAddClamp32AVX2Command>(args); }
+		void DrawSubClampColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteSubClamp32AVX2Command>(args); }
+		void DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteTranslatedSubClamp32AVX2Command>(args); }
+		void DrawRevSubClampColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteRevSubClamp32AVX2Command>(args); }
+		void DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args) override { Queue->Push<DrawSpriteTranslatedRevSubClamp32AVX2Command>(args); }
+		void DrawSpan(const SpanDrawerArgs &args) override { Queue->Push<DrawSpan32AVX2Command>(args); }
+		void DrawSpanMasked(const SpanDrawerArgs &args) override { Queue->Push<DrawSpanMasked32AVX2Command>(args); }
+		void DrawSpanTranslucent(const SpanDrawerArgs &args) override { Queue->Push<DrawSpanTranslucent32AVX2Command>(args); }
+		void DrawSpanMaskedTranslucent(const SpanDrawerArgs &args) override { Queue->Push<DrawSpanAddClamp32AVX2Command>(args); }
+		void DrawSpanAddClamp(const SpanDrawerArgs &args) override { Queue->Push<DrawSpanTranslucent32AVX2Command>(args); }
+		void DrawSpanMaskedAddClamp(const SpanDrawerArgs &args) override { Queue->Push<DrawSpanAddClamp32AVX2Command>(args); }
+	};
+
+	SWTruecolorDrawers *CreateAVX2TruecolorDrawers(DrawerCommandQueuePtr queue)
+	{
+		return new SWTruecolorDrawersAVX2(queue);
+	}
+}
+
+#else
+
+namespace swrenderer
+{
+	// The compiler cannot generate AVX2 code for this file.
+	SWTruecolorDrawers *CreateAVX2TruecolorDrawers(DrawerCommandQueuePtr queue)
+	{
+		return nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*
+**  AVX2 drawer commands for the sky
+**  Copyright (c) 2016 Magnus Norddahl
+**  Copyright (c) 2018 The GZDoom development team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw32_avx2.h"
+#include "swrenderer/viewport/r_skydrawer.h"
+
+namespace swrenderer
+{
+	// Only the textured part of a sky column is drawn eight pixels at a
+	// time. The fades are a few pixels at most and stay scalar.
+	template<bool DoubleSky>
+	class DrawSky32AVX2T : public DrawerCommand
+	{
+	protected:
+		SkyDrawerArgs args;
+
+	public:
+		DrawSky32AVX2T(const SkyDrawerArgs &args) : args(args) { }
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			uint32_t *dest = (uint32_t *)args.Dest();
+			int count = args.Count();
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			const uint32_t *source0 = (const uint32_t *)args.FrontTexturePixels();
+			const uint32_t *source1 = DoubleSky ? (const uint32_t *)args.BackTexturePixels() : nullptr;
+			int textureheight0 = args.FrontTextureHeight();
+			uint32_t maxtextureheight1 = DoubleSky ? args.BackTextureHeight() - 1 : 0;
+
+			int32_t frac = args.TextureVPos();
+			int32_t fracstep = args.TextureVStep();
+
+			uint32_t solid_top = args.SolidTopColor();
+			uint32_t solid_bottom = args.SolidBottomColor();
+			bool fadeSky = args.FadeSky();
+
+			// Find bands for top solid color, top fade, center textured, bottom fade, bottom solid color:
+			int start_fade = 2; // How fast it should fade out
+			int fade_length = (1 << (24 - start_fade));
+			int start_fadetop_y = (-frac) / fracstep;
+			int end_fadetop_y = (fade_length - frac) / fracstep;
+			int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
+			int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+
+			// The fades below stop at the end of the band rendered by this thread
+			count = MIN(count, thread->band_end - args.DestY());
+			start_fadetop_y = clamp(start_fadetop_y, 0, count);
+			end_fadetop_y = clamp(end_fadetop_y, 0, count);
+			start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
+			end_fadebottom_y = clamp(end_fadebottom_y, 0, count);
+
+			int num_cores = thread->num_cores;
+			int skipped = thread->skipped_by_thread(args.DestY());
+			dest = thread->dest_for_thread(args.DestY(), pitch, dest);
+			frac += fracstep * skipped;
+			fracstep *= num_cores;
+			pitch *= num_cores;
+
+			if (!fadeSky)
+			{
+				count = thread->count_for_thread(args.DestY(), count);
+				int index = DrawTextured(dest, pitch, frac, fracstep, count, source0, source1, textureheight0, maxtextureheight1);
+				dest += index * pitch;
+				frac += index * fracstep;
+				for (; index < count; index++)
+				{
+					*dest = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+					dest += pitch;
+					frac += fracstep;
+				}
+				return;
+			}
+
+			__m128i solid_top_fill = _mm_unpacklo_epi8(_mm_cvtsi32_si128(solid_top), _mm_setzero_si128());
+
+			int index = skipped;
+
+			// Top solid color:
+			while (index < start_fadetop_y)
+			{
+				*dest = solid_top;
+				dest += pitch;
+				frac += fracstep;
+				index += num_cores;
+			}
+
+			// Top fade:
+			while (index < end_fadetop_y)
+			{
+				uint32_t fg = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+
+				__m128i alpha = _mm_set1_epi16(MAX(MIN(frac >> (16 - start_fade), 256), 0));
+				__m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(256), alpha);
+
+				__m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(fg), _mm_setzero_si128());
+				c = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, alpha), _mm_mullo_epi16(solid_top_fill, inv_alpha)), 8);
+				*dest = _mm_cvtsi128_si32(_mm_packus_epi16(c, _mm_setzero_si128()));
+
+				frac += fracstep;
+				dest += pitch;
+				index += num_cores;
+			}
+
+			// Textured center:
+			if (index < start_fadebottom_y)
+			{
+				int centercount = (start_fadebottom_y - index + num_cores - 1) / num_cores;
+				int drawn = DrawTextured(dest, pitch, frac, fracstep, centercount, source0, source1, textureheight0, maxtextureheight1);
+				dest += drawn * pitch;
+				frac += drawn * fracstep;
+				index += drawn * num_cores;
+			}
+			while (index < start_fadebottom_y)
+			{
+				*dest = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+
+				frac += fracstep;
+				dest += pitch;
+				index += num_cores;
+			}
+
+			// Fade bottom:
+			while (index < end_fadebottom_y)
+			{
+				uint32_t fg = Sample(frac, source0, source1, textureheight0, maxtextureheight1);
+
+				__m128i alpha = _mm_set1_epi16(MAX(MIN(((2 << 24) - frac) >> (16 - start_fade), 256), 0));
+				__m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(256), alpha);
+
+				__m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(fg), _mm_setzero_si128());
+				c = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, alpha), _mm_mullo_epi16(solid_top_fill, inv_alpha)), 8);
+				*dest = _mm_cvtsi128_si32(_mm_packus_epi16(c, _mm_setzero_si128()));
+
+				frac += fracstep;
+				dest += pitch;
+				index += num_cores;
+			}
+
+			// Bottom solid color:
+			while (index < count)
+			{
+				*dest = solid_bottom;
+				dest += pitch;
+				index += num_cores;
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE uint32_t Sample(int32_t frac, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			uint32_t sample_index = (((((uint32_t)frac) << 8) >> FRACBITS) * textureheight0) >> FRACBITS;
+			uint32_t fg = source0[sample_index];
+			if (DoubleSky && fg == 0)
+			{
+				uint32_t sample_index2 = MIN(sample_index, maxtextureheight1);
+				fg = source1[sample_index2];
+			}
+			return fg;
+		}
+
+		// Draws count & ~7 pixels of the column and returns how many were drawn.
+		AVX2_TARGET FORCEINLINE int DrawTextured(uint32_t *dest, int pitch, int32_t frac, int32_t fracstep, int count, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			__m256i fracs = DrawAVX2::Ramp((uint32_t)frac, (uint32_t)fracstep);
+			__m256i fracstep8 = _mm256_set1_epi32(fracstep * 8);
+			__m256i height0 = _mm256_set1_epi32(textureheight0);
+			__m256i maxheight1 = _mm256_set1_epi32(maxtextureheight1);
+
+			int avxcount = count / 8;
+			for (int index = 0; index < avxcount; index++)
+			{
+				__m256i sample_index = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(_mm256_slli_epi32(fracs, 8), FRACBITS), height0), FRACBITS);
+				__m256i fg = _mm256_i32gather_epi32((const int*)source0, sample_index, 4);
+				if (DoubleSky)
+				{
+					__m256i transparent = _mm256_cmpeq_epi32(fg, _mm256_setzero_si256());
+					fg = _mm256_mask_i32gather_epi32(fg, (const int*)source1, _mm256_min_epu32(sample_index, maxheight1), transparent, 4);
+				}
+				DrawAVX2::StoreColumn(dest + index * pitch * 8, pitch, fg);
+				fracs = _mm256_add_epi32(fracs, fracstep8);
+			}
+			return avxcount * 8;
+		}
+
+		FString DebugInfo() override { return DoubleSky ? "DrawSkyDouble32AVX2Command" : "DrawSkySingle32AVX2Command"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
+	};
+
+	typedef DrawSky32AVX2T<false> DrawSkySingle32AVX2Command;
+	typedef DrawSky32AVX2T<true> DrawSkyDouble32AVX2Command;
+}
@@ -57,6 +57,9 @@ namespace swrenderer
 			int end_fadetop_y = (fade_length - frac) / fracstep;
 			int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
 			int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+
+			// The fades below stop at the end of the band rendered by this thread
+			count = MIN(count, thread->band_end - args.DestY());
 			start_fadetop_y = clamp(start_fadetop_y, 0, count);
 			end_fadetop_y = clamp(end_fadetop_y, 0, count);
 			start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
@@ -155,6 +158,7 @@ namespace swrenderer
 		}
 		
 		FString DebugInfo() override { return "DrawSkySingle32Command"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
 	};
 	
 	class DrawSkyDouble32Command : public DrawerCommand
@@ -189,6 +193,9 @@ namespace swrenderer
 			int end_fadetop_y = (fade_length - frac) / fracstep;
 			int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
 			int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+
+			// The fades below stop at the end of the band rendered by this thread
+			count = MIN(count, thread->band_end - args.DestY());
 			start_fadetop_y = clamp(start_fadetop_y, 0, count);
 			end_fadetop_y = clamp(end_fadetop_y, 0, count);
 			start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
@@ -310,5 +317,6 @@ namespace swrenderer
 		}
 		
 		FString DebugInfo() override { return "DrawSkyDouble32Command"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
 	};
 }
@@ -434,6 +434,7 @@ namespace swrenderer
 		}
 
 		FString DebugInfo() override { return "DrawSpan32T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = 1; return true; }
 	};
 
 	typedef DrawSpan32T<DrawSpan32TModes::OpaqueSpan> DrawSpan32Command;
@@ -0,0 +1,399 @@
+/*
+**  AVX2 drawer commands for spans
+**  Copyright (c) 2016 Magnus Norddahl
+**  Copyright (c) 2018 The GZDoom development team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw32_avx2.h"
+#include "swrenderer/drawers/r_draw_span32_sse2.h"
+
+namespace swrenderer
+{
+	template<typename BlendT>
+	class DrawSpan32AVX2T : public DrawerCommand
+	{
+	protected:
+		SpanDrawerArgs args;
+
+	public:
+		DrawSpan32AVX2T(const SpanDrawerArgs &drawerargs) : args(drawerargs) { }
+
+		struct TextureData
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t xone;
+			uint32_t yone;
+			uint32_t xstep;
+			uint32_t ystep;
+			uint32_t xfrac;
+			uint32_t yfrac;
+			const uint32_t *source;
+		};
+
+		struct ShadeData
+		{
+			__m256i mlight, inv_desaturate, shade_fade, shade_light;
+			int desaturate;
+			uint32_t srcalpha, destalpha;
+			const DrawerLight *lights;
+			int num_lights;
+		};
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			using namespace DrawSpan32TModes;
+
+			if (thread->line_skipped_by_thread(args.DestY())) return;
+
+			TextureData texdata;
+			texdata.width = args.TextureWidth();
+			texdata.height = args.TextureHeight();
+			texdata.xstep = args.TextureUStep();
+			texdata.ystep = args.TextureVStep();
+			texdata.xfrac = args.TextureUPos();
+			texdata.yfrac = args.TextureVPos();
+
+			texdata.source = (const uint32_t*)args.TexturePixels();
+
+			double lod = args.TextureLOD();
+			bool mipmapped = args.MipmappedTexture();
+
+			bool magnifying = lod < 0.0;
+			if (r_mipmap && mipmapped)
+			{
+				int level = (int)lod;
+				while (level > 0)
+				{
+					if (texdata.width <= 2 || texdata.height <= 2)
+						break;
+
+					texdata.source += texdata.width * texdata.height;
+					texdata.width = MAX<uint32_t>(texdata.width / 2, 1);
+					texdata.height = MAX<uint32_t>(texdata.height / 2, 1);
+					level--;
+				}
+			}
+
+			texdata.xone = (0x80000000u / texdata.width) << 1;
+			texdata.yone = (0x80000000u / texdata.height) << 1;
+
+			bool is_nearest_filter = (magnifying && !r_magfilter) || (!magnifying && !r_minfilter);
+			bool is_64x64 = texdata.width == 64 && texdata.height == 64;
+
+			auto shade_constants = args.ColormapConstants();
+			if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<SimpleShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<SimpleShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<SimpleShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+			}
+			else
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT, typename TextureSizeT>
+		AVX2_TARGET FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, TextureData texdata, ShadeConstants shade_constants)
+		{
+			using namespace DrawSpan32TModes;
+
+			// Shade constants
+			ShadeData shade;
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			shade.mlight = DrawAVX2::Broadcast(_mm_set_epi16(256, light, light, light, 256, light, light, light));
+			__m128i inv_light = _mm_set_epi16(0, 256 - light, 256 - light, 256 - light, 0, 256 - light, 256 - light, 256 - light);
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				shade.inv_desaturate = DrawAVX2::Broadcast(_mm_setr_epi16(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate));
+				__m128i shade_fade = _mm_set_epi16(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue, shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade.shade_fade = DrawAVX2::Broadcast(_mm_mullo_epi16(shade_fade, inv_light));
+				shade.shade_light = DrawAVX2::Broadcast(_mm_set_epi16(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue, shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue));
+				shade.desaturate = shade_constants.desaturate;
+			}
+			else
+			{
+				shade.inv_desaturate = _mm256_setzero_si256();
+				shade.shade_fade = _mm256_setzero_si256();
+				shade.shade_light = _mm256_setzero_si256();
+				shade.desaturate = 0;
+			}
+
+			shade.lights = args.dc_lights;
+			shade.num_lights = args.dc_num_lights;
+			float vpx = args.dc_viewpos.X;
+			float stepvpx = args.dc_viewpos_step.X;
+			__m128 viewpos_x = _mm_setr_ps(vpx, vpx + stepvpx, 0.0f, 0.0f);
+			__m128 step_viewpos_x = _mm_set1_ps(stepvpx * 2.0f);
+
+			int count = args.DestX2() - args.DestX1() + 1;
+			uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				texdata.xfrac -= texdata.xone / 2;
+				texdata.yfrac -= texdata.yone / 2;
+			}
+
+			shade.srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			shade.destalpha = args.DestAlpha() >> (FRACBITS - 8);
+
+			int avxcount = count / 8;
+			for (int index = 0; index < avxcount; index++)
+			{
+				int offset = index * 8;
+
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)SpanBlendModes::Opaque)
+					bgcolor = _mm256_loadu_si256((const __m256i*)(dest + offset));
+				else
+					bgcolor = _mm256_setzero_si256();
+
+				__m256i fgcolor;
+				if (FilterModeT::Mode == (int)FilterModes::Nearest)
+				{
+					__m256i xfrac = DrawAVX2::Ramp(texdata.xfrac, texdata.xstep);
+					__m256i yfrac = DrawAVX2::Ramp(texdata.yfrac, texdata.ystep);
+					__m256i sample_index;
+					if (TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+					{
+						sample_index = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(xfrac, 32 - 6 - 6), _mm256_set1_epi32(63 * 64)), _mm256_srli_epi32(yfrac, 32 - 6));
+					}
+					else
+					{
+						__m256i width = _mm256_set1_epi32(texdata.width);
+						__m256i height = _mm256_set1_epi32(texdata.height);
+						__m256i x = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(xfrac, 16), width), 16);
+						__m256i y = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(yfrac, 16), height), 16);
+						sample_index = _mm256_add_epi32(_mm256_mullo_epi32(x, height), y);
+					}
+					fgcolor = _mm256_i32gather_epi32((const int*)texdata.source, sample_index, 4);
+					texdata.xfrac += texdata.xstep * 8;
+					texdata.yfrac += texdata.ystep * 8;
+				}
+				else
+				{
+					alignas(32) uint32_t ifgcolor[8];
+					for (int i = 0; i < 8; i++)
+					{
+						ifgcolor[i] = Sample<FilterModeT, TextureSizeT>(texdata.width, texdata.height, texdata.xone, texdata.yone, texdata.xfrac, texdata.yfrac, texdata.source);
+						texdata.xfrac += texdata.xstep;
+						texdata.yfrac += texdata.ystep;
+					}
+					fgcolor = _mm256_load_si256((const __m256i*)ifgcolor);
+				}
+
+				_mm256_storeu_si256((__m256i*)(dest + offset), Shade<ShadeModeT>(fgcolor, bgcolor, shade, DrawAVX2::StepViewPos(viewpos_x, step_viewpos_x)));
+			}
+
+			int rest = count - avxcount * 8;
+			if (rest > 0)
+			{
+				uint32_t *d = dest + avxcount * 8;
+
+				alignas(32) uint32_t ifgcolor[8] = { 0 };
+				alignas(32) uint32_t ibgcolor[8] = { 0 };
+				for (int i = 0; i < rest; i++)
+				{
+					ifgcolor[i] = Sample<FilterModeT, TextureSizeT>(texdata.width, texdata.height, texdata.xone, texdata.yone, texdata.xfrac, texdata.yfrac, texdata.source);
+					texdata.xfrac += texdata.xstep;
+					texdata.yfrac += texdata.ystep;
+
+					if (BlendT::Mode != (int)SpanBlendModes::Opaque)
+						ibgcolor[i] = d[i];
+				}
+
+				alignas(32) uint32_t outcolor[8];
+				_mm256_store_si256((__m256i*)outcolor, Shade<ShadeModeT>(_mm256_load_si256((const __m256i*)ifgcolor), _mm256_load_si256((const __m256i*)ibgcolor), shade, DrawAVX2::StepViewPos(viewpos_x, step_viewpos_x)));
+				for (int i = 0; i < rest; i++)
+					d[i] = outcolor[i];
+			}
+		}
+
+		template<typename FilterModeT, typename TextureSizeT>
+		AVX2_TARGET FORCEINLINE unsigned int VECTORCALL Sample(uint32_t width, uint32_t height, uint32_t xone, uint32_t yone, uint32_t xfrac, uint32_t yfrac, const uint32_t *source)
+		{
+			using namespace DrawSpan32TModes;
+
+			if (FilterModeT::Mode == (int)FilterModes::Nearest && TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+			{
+				int sample_index = ((xfrac >> (32 - 6 - 6)) & (63 * 64)) + (yfrac >> (32 - 6));
+				return source[sample_index];
+			}
+			else if (FilterModeT::Mode == (int)FilterModes::Nearest)
+			{
+				uint32_t x = ((xfrac >> 16) * width) >> 16;
+				uint32_t y = ((yfrac >> 16) * height) >> 16;
+				int sample_index = x * height + y;
+				return source[sample_index];
+			}
+			else
+			{
+				uint32_t p00, p01, p10, p11;
+				uint32_t frac_x, frac_y;
+				if (TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+				{
+					frac_x = xfrac >> 16 << 6;
+					frac_y = yfrac >> 16 << 6;
+					uint32_t x0 = frac_x >> 16;
+					uint32_t y0 = frac_y >> 16;
+					uint32_t x1 = (x0 + 1) & 0x3f;
+					uint32_t y1 = (y0 + 1) & 0x3f;
+					p00 = source[(y0 + (x0 << 6))];
+					p01 = source[(y1 + (x0 << 6))];
+					p10 = source[(y0 + (x1 << 6))];
+					p11 = source[(y1 + (x1 << 6))];
+				}
+				else
+				{
+					frac_x = (xfrac >> 16) * width;
+					frac_y = (yfrac >> 16) * height;
+					uint32_t x0 = frac_x >> 16;
+					uint32_t y0 = frac_y >> 16;
+					uint32_t x1 = (((xfrac + xone) >> 16) * width) >> 16;
+					uint32_t y1 = (((yfrac + yone) >> 16) * height) >> 16;
+					p00 = source[y0 + x0 * height];
+					p01 = source[y1 + x0 * height];
+					p10 = source[y0 + x1 * height];
+					p11 = source[y1 + x1 * height];
+				}
+
+				uint32_t inv_b = (frac_x >> 12) & 15;
+				uint32_t inv_a = (frac_y >> 12) & 15;
+				uint32_t a = 16 - inv_a;
+				uint32_t b = 16 - inv_b;
+
+				uint32_t sred = (RPART(p00) * (a * b) + RPART(p01) * (inv_a * b) + RPART(p10) * (a * inv_b) + RPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				uint32_t sgreen = (GPART(p00) * (a * b) + GPART(p01) * (inv_a * b) + GPART(p10) * (a * inv_b) + GPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				uint32_t sblue = (BPART(p00) * (a * b) + BPART(p01) * (inv_a * b) + BPART(p10) * (a * inv_b) + BPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				uint32_t salpha = (APART(p00) * (a * b) + APART(p01) * (inv_a * b) + APART(p10) * (a * inv_b) + APART(p11) * (inv_a * inv_b) + 127) >> 8;
+
+				return (salpha << 24) | (sred << 16) | (sgreen << 8) | sblue;
+			}
+		}
+
+		// Shades and blends eight pixels
+		template<typename ShadeModeT>
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Shade(__m256i fgcolor, __m256i bgcolor, const ShadeData &shade, __m256 viewpos_x)
+		{
+			using namespace DrawSpan32TModes;
+
+			__m256i fg_lo = DrawAVX2::UnpackLo(fgcolor);
+			__m256i fg_hi = DrawAVX2::UnpackHi(fgcolor);
+			__m256i material_lo = fg_lo;
+			__m256i material_hi = fg_hi;
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fg_lo = _mm256_srli_epi16(_mm256_mullo_epi16(fg_lo, shade.mlight), 8);
+				fg_hi = _mm256_srli_epi16(_mm256_mullo_epi16(fg_hi, shade.mlight), 8);
+			}
+			else
+			{
+				__m256i intensity_lo, intensity_hi;
+				DrawAVX2::Intensity(fgcolor, shade.desaturate, intensity_lo, intensity_hi);
+				fg_lo = ShadeAdvanced(fg_lo, intensity_lo, shade);
+				fg_hi = ShadeAdvanced(fg_hi, intensity_hi, shade);
+			}
+
+			__m256i lit_lo, lit_hi;
+			DrawAVX2::LightContribution(shade.lights, shade.num_lights, viewpos_x, true, lit_lo, lit_hi);
+			fg_lo = DrawAVX2::AddLights(material_lo, fg_lo, lit_lo);
+			fg_hi = DrawAVX2::AddLights(material_hi, fg_hi, lit_hi);
+
+			if (BlendT::Mode == (int)SpanBlendModes::Opaque)
+			{
+				return DrawAVX2::Pack(fg_lo, fg_hi);
+			}
+
+			__m256i bg_lo = DrawAVX2::UnpackLo(bgcolor);
+			__m256i bg_hi = DrawAVX2::UnpackHi(bgcolor);
+
+			if (BlendT::Mode == (int)SpanBlendModes::Masked)
+			{
+				return DrawAVX2::Pack(DrawAVX2::BlendMasked(fg_lo, bg_lo), DrawAVX2::BlendMasked(fg_hi, bg_hi));
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::Translucent)
+			{
+				__m256i fgalpha = _mm256_set1_epi16(shade.srcalpha);
+				__m256i bgalpha = _mm256_set1_epi16(shade.destalpha);
+				return DrawAVX2::Pack(DrawAVX2::BlendClamp<DrawAVX2::BlendAdd>(fg_lo, bg_lo, fgalpha, bgalpha), DrawAVX2::BlendClamp<DrawAVX2::BlendAdd>(fg_hi, bg_hi, fgalpha, bgalpha));
+			}
+			else
+			{
+				__m256i fgalpha, bgalpha, fgalpha_lo, fgalpha_hi, bgalpha_lo, bgalpha_hi;
+				DrawAVX2::BlendAlpha(fgcolor, shade.srcalpha, shade.destalpha, fgalpha, bgalpha);
+				DrawAVX2::Splat(fgalpha, fgalpha_lo, fgalpha_hi);
+				DrawAVX2::Splat(bgalpha, bgalpha_lo, bgalpha_hi);
+
+				const int op =
+					BlendT::Mode == (int)SpanBlendModes::AddClamp ? DrawAVX2::BlendAdd :
+					BlendT::Mode == (int)SpanBlendModes::SubClamp ? DrawAVX2::BlendSub : DrawAVX2::BlendRevSub;
+				return DrawAVX2::Pack(DrawAVX2::BlendClamp<op>(fg_lo, bg_lo, fgalpha_lo, bgalpha_lo), DrawAVX2::BlendClamp<op>(fg_hi, bg_hi, fgalpha_hi, bgalpha_hi));
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL ShadeAdvanced(__m256i fgcolor, __m256i intensity, const ShadeData &shade)
+		{
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, shade.inv_desaturate), intensity), 8);
+			fgcolor = _mm256_mullo_epi16(fgcolor, shade.mlight);
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade.shade_fade, fgcolor), 8);
+			return _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade.shade_light), 8);
+		}
+
+		FString DebugInfo() override { return "DrawSpan32AVX2T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = 1; return true; }
+	};
+
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::OpaqueSpan> DrawSpan32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::MaskedSpan> DrawSpanMasked32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::TranslucentSpan> DrawSpanTranslucent32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::AddClampSpan> DrawSpanAddClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::SubClampSpan> DrawSpanSubClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::RevSubClampSpan> DrawSpanRevSubClamp32AVX2Command;
+}
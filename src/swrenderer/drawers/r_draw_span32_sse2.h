@@ -23,6 +23,7 @@
 #pragma once
 
 #include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/drawers/r_draw32_sse2.h"
 #include "swrenderer/viewport/r_spandrawer.h"
 
 namespace swrenderer
@@ -359,47 +360,7 @@ namespace swrenderer
 
 		FORCEINLINE __m128i VECTORCALL AddLights(__m128i material, __m128i fgcolor, const DrawerLight *lights, int num_lights, __m128 viewpos_x)
 		{
-			using namespace DrawSpan32TModes;
-
-			__m128i lit = _mm_setzero_si128();
-
-			for (int i = 0; i != num_lights; i++)
-			{
-				__m128 light_x = _mm_set1_ps(lights[i].x);
-				__m128 light_y = _mm_set1_ps(lights[i].y);
-				__m128 light_z = _mm_set1_ps(lights[i].z);
-				__m128 light_radius = _mm_set1_ps(lights[i].radius);
-				__m128 m256 = _mm_set1_ps(256.0f);
-
-				// L = light-pos
-				// dist = sqrt(dot(L, L))
-				// distance_attenuation = 1 - MIN(dist * (1/radius), 1)
-				__m128 Lyz2 = light_y; // L.y*L.y + L.z*L.z
-				__m128 Lx = _mm_sub_ps(light_x, viewpos_x);
-				__m128 dist2 = _mm_add_ps(Lyz2, _mm_mul_ps(Lx, Lx));
-				__m128 rcp_dist = _mm_rsqrt_ps(dist2);
-				__m128 dist = _mm_mul_ps(dist2, rcp_dist);
-				__m128 distance_attenuation = _mm_sub_ps(m256, _mm_min_ps(_mm_mul_ps(dist, light_radius), m256));
-
-				// The simple light type
-				__m128 simple_attenuation = distance_attenuation;
-
-				// The point light type
-				// diffuse = dot(N,L) * attenuation
-				__m128 point_attenuation = _mm_mul_ps(_mm_mul_ps(light_z, rcp_dist), distance_attenuation);
-
-				__m128 is_attenuated = _mm_cmpeq_ps(light_z, _mm_setzero_ps());
-				__m128i attenuation = _mm_cvtps_epi32(_mm_or_ps(_mm_and_ps(is_attenuated, simple_attenuation), _mm_andnot_ps(is_attenuated, point_attenuation)));
-				attenuation = _mm_packs_epi32(_mm_shuffle_epi32(attenuation, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_epi32(attenuation, _MM_SHUFFLE(1, 1, 1, 1)));
-
-				__m128i light_color = _mm_cvtsi32_si128(lights[i].color);
-				light_color = _mm_unpacklo_epi8(light_color, _mm_setzero_si128());
-				light_color = _mm_shuffle_epi32(light_color, _MM_SHUFFLE(1, 0, 1, 0));
-
-				lit = _mm_add_epi16(lit, _mm_srli_epi16(_mm_mullo_epi16(light_color, attenuation), 8));
-			}
-
-			lit = _mm_min_epi16(lit, _mm_set1_epi16(256));
+			__m128i lit = DrawSSE2::LightContribution(lights, num_lights, viewpos_x, true);
 
 			fgcolor = _mm_add_epi16(fgcolor, _mm_srli_epi16(_mm_mullo_epi16(material, lit), 8));
 			fgcolor = _mm_min_epi16(fgcolor, _mm_set1_epi16(255));
@@ -515,6 +476,7 @@ namespace swrenderer
 		}
 
 		FString DebugInfo() override { return "DrawSpan32T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = 1; return true; }
 	};
 
 	typedef DrawSpan32T<DrawSpan32TModes::OpaqueSpan> DrawSpan32Command;
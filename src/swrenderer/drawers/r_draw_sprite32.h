@@ -388,6 +388,7 @@ namespace swrenderer
 		}
 
 		FString DebugInfo() override { return "DrawSprite32T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
 	};
 
 	typedef DrawSprite32T<DrawSprite32TModes::CopySprite, DrawSprite32TModes::TextureSampler> DrawSpriteCopy32Command;
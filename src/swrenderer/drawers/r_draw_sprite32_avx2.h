@@ -0,0 +1,406 @@
+/*
+**  AVX2 drawer commands for sprites
+**  Copyright (c) 2016 Magnus Norddahl
+**  Copyright (c) 2018 The GZDoom development team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw32_avx2.h"
+#include "swrenderer/drawers/r_draw_sprite32_sse2.h"
+
+namespace swrenderer
+{
+	template<typename BlendT, typename SamplerT>
+	class DrawSprite32AVX2T : public DrawerCommand
+	{
+	public:
+		SpriteDrawerArgs args;
+
+		DrawSprite32AVX2T(const SpriteDrawerArgs &drawerargs) : args(drawerargs) { }
+
+		struct ShadeData
+		{
+			__m256i mlight, inv_desaturate, shade_fade, shade_light, lightcontrib;
+			int desaturate;
+			uint32_t srcalpha, destalpha;
+		};
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			using namespace DrawSprite32TModes;
+
+			auto shade_constants = args.ColormapConstants();
+			if (SamplerT::Mode == (int)SpriteSamplers::Texture)
+			{
+				const uint32_t *source2 = (const uint32_t*)args.TexturePixels2();
+				bool is_nearest_filter = (source2 == nullptr);
+
+				if (shade_constants.simple_shade)
+				{
+					if (is_nearest_filter)
+						Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter>(thread, shade_constants);
+				}
+				else
+				{
+					if (is_nearest_filter)
+						Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter>(thread, shade_constants);
+				}
+			}
+			else // no linear filtering for translated, shaded or fill
+			{
+				if (shade_constants.simple_shade)
+				{
+					Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+				}
+				else
+				{
+					Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT>
+		AVX2_TARGET FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, ShadeConstants shade_constants)
+		{
+			using namespace DrawSprite32TModes;
+
+			const uint32_t *source;
+			const uint32_t *source2;
+			const uint8_t *colormap;
+			const uint32_t *translation;
+
+			if (SamplerT::Mode == (int)SpriteSamplers::Shaded || SamplerT::Mode == (int)SpriteSamplers::Translated)
+			{
+				source = (const uint32_t*)args.TexturePixels();
+				source2 = nullptr;
+				colormap = args.Colormap(args.Viewport());
+				translation = (const uint32_t*)args.TranslationMap();
+			}
+			else
+			{
+				source = (const uint32_t*)args.TexturePixels();
+				source2 = (const uint32_t*)args.TexturePixels2();
+				colormap = nullptr;
+				translation = nullptr;
+			}
+
+			int textureheight = args.TextureHeight();
+			uint32_t one = ((0x20000000 + textureheight - 1) / textureheight) * 2 + 1;
+
+			// Shade constants
+			ShadeData shade;
+			__m128i dynlight = _mm_cvtsi32_si128(args.DynamicLight());
+			dynlight = _mm_unpacklo_epi8(dynlight, _mm_setzero_si128());
+			dynlight = _mm_shuffle_epi32(dynlight, _MM_SHUFFLE(1, 0, 1, 0));
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			__m128i mlight = _mm_set_epi16(256, light, light, light, 256, light, light, light);
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				__m128i inv_light = _mm_set_epi16(0, 256 - light, 256 - light, 256 - light, 0, 256 - light, 256 - light, 256 - light);
+				shade.inv_desaturate = DrawAVX2::Broadcast(_mm_setr_epi16(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate));
+				__m128i shade_fade = _mm_set_epi16(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue, shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade.shade_fade = DrawAVX2::Broadcast(_mm_mullo_epi16(shade_fade, inv_light));
+				shade.shade_light = DrawAVX2::Broadcast(_mm_set_epi16(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue, shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue));
+				shade.desaturate = shade_constants.desaturate;
+
+				__m128i lightcontrib = _mm_min_epi16(_mm_add_epi16(mlight, dynlight), _mm_set1_epi16(256));
+				shade.lightcontrib = DrawAVX2::Broadcast(_mm_sub_epi16(lightcontrib, mlight));
+			}
+			else
+			{
+				shade.inv_desaturate = _mm256_setzero_si256();
+				shade.shade_fade = _mm256_setzero_si256();
+				shade.shade_light = _mm256_setzero_si256();
+				shade.desaturate = 0;
+				shade.lightcontrib = _mm256_setzero_si256();
+
+				mlight = _mm_min_epi16(_mm_add_epi16(mlight, dynlight), _mm_set1_epi16(256));
+			}
+			shade.mlight = DrawAVX2::Broadcast(mlight);
+
+			int count = args.Count();
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			uint32_t fracstep = args.TextureVStep();
+			uint32_t frac = args.TextureVPos();
+			uint32_t texturefracx = args.TextureUPos();
+			uint32_t *dest = (uint32_t*)args.Dest();
+			int dest_y = args.DestY();
+
+			count = thread->count_for_thread(dest_y, count);
+			if (count <= 0) return;
+			frac += thread->skipped_by_thread(dest_y) * fracstep;
+			dest = thread->dest_for_thread(dest_y, pitch, dest);
+			fracstep *= thread->num_cores;
+			pitch *= thread->num_cores;
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				frac -= one / 2;
+			}
+
+			shade.srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			shade.destalpha = args.DestAlpha() >> (FRACBITS - 8);
+			uint32_t srccolor = args.SrcColorBgra();
+			uint32_t color = LightBgra::shade_bgra_simple(args.SolidColorBgra(),
+				LightBgra::calc_light_multiplier(light));
+
+			const bool readsdest = BlendT::Mode != (int)SpriteBlendModes::Opaque && BlendT::Mode != (int)SpriteBlendModes::Copy;
+			__m256i offsets = DrawAVX2::Ramp(0u, (uint32_t)pitch);
+
+			int avxcount = count / 8;
+			for (int index = 0; index < avxcount; index++)
+			{
+				uint32_t *d = dest + index * pitch * 8;
+
+				__m256i bgcolor;
+				if (readsdest)
+					bgcolor = DrawAVX2::LoadColumn(d, offsets);
+				else
+					bgcolor = _mm256_setzero_si256();
+
+				__m256i fgcolor, fgshade;
+				if (SamplerT::Mode == (int)SpriteSamplers::Texture && FilterModeT::Mode == (int)FilterModes::Nearest)
+				{
+					__m256i fracs = DrawAVX2::Ramp(frac, fracstep);
+					__m256i sample_index = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(_mm256_slli_epi32(fracs, 2), FRACBITS), _mm256_set1_epi32(textureheight)), FRACBITS);
+					fgcolor = _mm256_i32gather_epi32((const int*)source, sample_index, 4);
+					fgshade = _mm256_setzero_si256();
+					frac += fracstep * 8;
+				}
+				else
+				{
+					alignas(32) uint32_t ifgcolor[8], ifgshade[8];
+					for (int i = 0; i < 8; i++)
+					{
+						ifgcolor[i] = Sample<FilterModeT>(frac, source, source2, translation, textureheight, one, texturefracx, color, srccolor);
+						ifgshade[i] = SampleShade(frac, source, colormap);
+						frac += fracstep;
+					}
+					fgcolor = _mm256_load_si256((const __m256i*)ifgcolor);
+					fgshade = _mm256_load_si256((const __m256i*)ifgshade);
+				}
+
+				DrawAVX2::StoreColumn(d, pitch, Shade<ShadeModeT>(fgcolor, bgcolor, fgshade, shade));
+			}
+
+			int rest = count - avxcount * 8;
+			if (rest > 0)
+			{
+				uint32_t *d = dest + avxcount * pitch * 8;
+
+				alignas(32) uint32_t ifgcolor[8] = { 0 };
+				alignas(32) uint32_t ifgshade[8] = { 0 };
+				alignas(32) uint32_t ibgcolor[8] = { 0 };
+				for (int i = 0; i < rest; i++)
+				{
+					ifgcolor[i] = Sample<FilterModeT>(frac, source, source2, translation, textureheight, one, texturefracx, color, srccolor);
+					ifgshade[i] = SampleShade(frac, source, colormap);
+					frac += fracstep;
+
+					if (readsdest)
+						ibgcolor[i] = d[i * pitch];
+				}
+
+				alignas(32) uint32_t outcolor[8];
+				__m256i fgcolor = _mm256_load_si256((const __m256i*)ifgcolor);
+				__m256i fgshade = _mm256_load_si256((const __m256i*)ifgshade);
+				__m256i bgcolor = _mm256_load_si256((const __m256i*)ibgcolor);
+				_mm256_store_si256((__m256i*)outcolor, Shade<ShadeModeT>(fgcolor, bgcolor, fgshade, shade));
+				for (int i = 0; i < rest; i++)
+					d[i * pitch] = outcolor[i];
+			}
+		}
+
+		template<typename FilterModeT>
+		AVX2_TARGET FORCEINLINE unsigned int VECTORCALL Sample(uint32_t frac, const uint32_t *source, const uint32_t *source2, const uint32_t *translation, int textureheight, uint32_t one, uint32_t texturefracx, uint32_t color, uint32_t srccolor)
+		{
+			using namespace DrawSprite32TModes;
+
+			if (SamplerT::Mode == (int)SpriteSamplers::Shaded)
+			{
+				return color;
+			}
+			else if (SamplerT::Mode == (int)SpriteSamplers::Translated)
+			{
+				const uint8_t *sourcepal = (const uint8_t *)source;
+				return translation[sourcepal[frac >> FRACBITS]];
+			}
+			else if (SamplerT::Mode == (int)SpriteSamplers::Fill)
+			{
+				return srccolor;
+			}
+			else if (FilterModeT::Mode == (int)FilterModes::Nearest)
+			{
+				int sample_index = (((frac << 2) >> FRACBITS) * textureheight) >> FRACBITS;
+				return source[sample_index];
+			}
+			else
+			{
+				// Clamp to edge
+				unsigned int frac_y0 = (MIN<unsigned int>(frac, 1 << 30) >> (FRACBITS - 2)) * textureheight;
+				unsigned int frac_y1 = (MIN<unsigned int>(frac + one, 1 << 30) >> (FRACBITS - 2)) * textureheight;
+				unsigned int y0 = frac_y0 >> FRACBITS;
+				unsigned int y1 = frac_y1 >> FRACBITS;
+
+				unsigned int p00 = source[y0];
+				unsigned int p01 = source[y1];
+				unsigned int p10 = source2[y0];
+				unsigned int p11 = source2[y1];
+
+				unsigned int inv_b = texturefracx;
+				unsigned int inv_a = (frac_y1 >> (FRACBITS - 4)) & 15;
+				unsigned int a = 16 - inv_a;
+				unsigned int b = 16 - inv_b;
+
+				unsigned int sred = (RPART(p00) * (a * b) + RPART(p01) * (inv_a * b) + RPART(p10) * (a * inv_b) + RPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				unsigned int sgreen = (GPART(p00) * (a * b) + GPART(p01) * (inv_a * b) + GPART(p10) * (a * inv_b) + GPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				unsigned int sblue = (BPART(p00) * (a * b) + BPART(p01) * (inv_a * b) + BPART(p10) * (a * inv_b) + BPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				unsigned int salpha = (APART(p00) * (a * b) + APART(p01) * (inv_a * b) + APART(p10) * (a * inv_b) + APART(p11) * (inv_a * inv_b) + 127) >> 8;
+
+				return (salpha << 24) | (sred << 16) | (sgreen << 8) | sblue;
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE unsigned int VECTORCALL SampleShade(uint32_t frac, const uint32_t *source, const uint8_t *colormap)
+		{
+			using namespace DrawSprite32TModes;
+
+			if (SamplerT::Mode == (int)SpriteSamplers::Shaded)
+			{
+				const uint8_t *sourcepal = (const uint8_t *)source;
+				unsigned int sampleshadeout = colormap[sourcepal[frac >> FRACBITS]];
+				return MIN<unsigned int>(sampleshadeout, 64) * 4;
+			}
+			else
+			{
+				return 0;
+			}
+		}
+
+		// Shades and blends eight pixels
+		template<typename ShadeModeT>
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Shade(__m256i fgcolor, __m256i bgcolor, __m256i fgshade, const ShadeData &shade)
+		{
+			using namespace DrawSprite32TModes;
+
+			__m256i fg_lo = DrawAVX2::UnpackLo(fgcolor);
+			__m256i fg_hi = DrawAVX2::UnpackHi(fgcolor);
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Copy)
+			{
+			}
+			else if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fg_lo = _mm256_srli_epi16(_mm256_mullo_epi16(fg_lo, shade.mlight), 8);
+				fg_hi = _mm256_srli_epi16(_mm256_mullo_epi16(fg_hi, shade.mlight), 8);
+			}
+			else
+			{
+				__m256i intensity_lo, intensity_hi;
+				DrawAVX2::Intensity(fgcolor, shade.desaturate, intensity_lo, intensity_hi);
+				fg_lo = ShadeAdvanced(fg_lo, intensity_lo, shade);
+				fg_hi = ShadeAdvanced(fg_hi, intensity_hi, shade);
+			}
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Opaque || BlendT::Mode == (int)SpriteBlendModes::Copy)
+			{
+				return DrawAVX2::Pack(fg_lo, fg_hi);
+			}
+
+			__m256i bg_lo = DrawAVX2::UnpackLo(bgcolor);
+			__m256i bg_hi = DrawAVX2::UnpackHi(bgcolor);
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Shaded)
+			{
+				__m256i alpha_lo, alpha_hi;
+				DrawAVX2::Splat(fgshade, alpha_lo, alpha_hi);
+				__m256i inv_alpha_lo = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha_lo);
+				__m256i inv_alpha_hi = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha_hi);
+
+				__m256i out_lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fg_lo, alpha_lo), _mm256_mullo_epi16(bg_lo, inv_alpha_lo)), 8);
+				__m256i out_hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fg_hi, alpha_hi), _mm256_mullo_epi16(bg_hi, inv_alpha_hi)), 8);
+				return DrawAVX2::Pack(out_lo, out_hi);
+			}
+			else if (BlendT::Mode == (int)SpriteBlendModes::AddClampShaded)
+			{
+				__m256i alpha_lo, alpha_hi;
+				DrawAVX2::Splat(fgshade, alpha_lo, alpha_hi);
+
+				__m256i out_lo = _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(fg_lo, alpha_lo), 8), bg_lo);
+				__m256i out_hi = _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(fg_hi, alpha_hi), 8), bg_hi);
+				return DrawAVX2::Pack(out_lo, out_hi);
+			}
+			else
+			{
+				__m256i fgalpha, bgalpha, fgalpha_lo, fgalpha_hi, bgalpha_lo, bgalpha_hi;
+				DrawAVX2::BlendAlpha(fgcolor, shade.srcalpha, shade.destalpha, fgalpha, bgalpha);
+				DrawAVX2::Splat(fgalpha, fgalpha_lo, fgalpha_hi);
+				DrawAVX2::Splat(bgalpha, bgalpha_lo, bgalpha_hi);
+
+				const int op =
+					BlendT::Mode == (int)SpriteBlendModes::AddClamp ? DrawAVX2::BlendAdd :
+					BlendT::Mode == (int)SpriteBlendModes::SubClamp ? DrawAVX2::BlendSub : DrawAVX2::BlendRevSub;
+				return DrawAVX2::Pack(DrawAVX2::BlendClamp<op>(fg_lo, bg_lo, fgalpha_lo, bgalpha_lo), DrawAVX2::BlendClamp<op>(fg_hi, bg_hi, fgalpha_hi, bgalpha_hi));
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL ShadeAdvanced(__m256i fgcolor, __m256i intensity, const ShadeData &shade)
+		{
+			__m256i lit_dynlight = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade.lightcontrib), 8);
+
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, shade.inv_desaturate), intensity), 8);
+			fgcolor = _mm256_mullo_epi16(fgcolor, shade.mlight);
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade.shade_fade, fgcolor), 8);
+			fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade.shade_light), 8);
+
+			fgcolor = _mm256_add_epi16(fgcolor, lit_dynlight);
+			return _mm256_min_epi16(fgcolor, _mm256_set1_epi16(255));
+		}
+
+		FString DebugInfo() override { return "DrawSprite32AVX2T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
+	};
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::CopySprite, DrawSprite32TModes::TextureSampler> DrawSpriteCopy32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::TextureSampler> DrawSprite32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteRevSubClamp32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::FillSampler> FillSprite32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::FillSampler> FillSpriteAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::FillSampler> FillSpriteSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::FillSampler> FillSpriteRevSubClamp32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::ShadedSprite, DrawSprite32TModes::ShadedSampler> DrawSpriteShaded32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampShadedSprite, DrawSprite32TModes::ShadedSampler> DrawSpriteAddClampShaded32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslated32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedRevSubClamp32AVX2Command;
+}
@@ -333,6 +333,7 @@ namespace swrenderer
 		}
 
 		FString DebugInfo() override { return "DrawWall32T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
 	};
 
 	typedef DrawWall32T<DrawWall32TModes::OpaqueWall> DrawWall32Command;
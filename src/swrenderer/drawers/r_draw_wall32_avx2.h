@@ -0,0 +1,294 @@
+/*
+**  AVX2 drawer commands for walls
+**  Copyright (c) 2016 Magnus Norddahl
+**  Copyright (c) 2018 The GZDoom development team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw32_avx2.h"
+#include "swrenderer/drawers/r_draw_wall32_sse2.h"
+
+namespace swrenderer
+{
+	template<typename BlendT>
+	class DrawWall32AVX2T : public DrawerCommand
+	{
+	protected:
+		WallDrawerArgs args;
+
+	public:
+		DrawWall32AVX2T(const WallDrawerArgs &drawerargs) : args(drawerargs) { }
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			using namespace DrawWall32TModes;
+
+			const uint32_t *source2 = (const uint32_t*)args.TexturePixels2();
+			bool is_nearest_filter = (source2 == nullptr);
+			auto shade_constants = args.ColormapConstants();
+			if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+					Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+				else
+					Loop<SimpleShade, LinearFilter>(thread, shade_constants);
+			}
+			else
+			{
+				if (is_nearest_filter)
+					Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+				else
+					Loop<AdvancedShade, LinearFilter>(thread, shade_constants);
+			}
+		}
+
+		struct ShadeData
+		{
+			__m256i mlight, inv_desaturate, shade_fade, shade_light;
+			int desaturate;
+			uint32_t srcalpha, destalpha;
+			const DrawerLight *lights;
+			int num_lights;
+		};
+
+		template<typename ShadeModeT, typename FilterModeT>
+		AVX2_TARGET FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, ShadeConstants shade_constants)
+		{
+			using namespace DrawWall32TModes;
+
+			const uint32_t *source = (const uint32_t*)args.TexturePixels();
+			const uint32_t *source2 = (const uint32_t*)args.TexturePixels2();
+			int textureheight = args.TextureHeight();
+			uint32_t one = ((0x80000000 + textureheight - 1) / textureheight) * 2 + 1;
+
+			// Shade constants
+			ShadeData shade;
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			shade.mlight = DrawAVX2::Broadcast(_mm_set_epi16(256, light, light, light, 256, light, light, light));
+			__m128i inv_light = _mm_set_epi16(0, 256 - light, 256 - light, 256 - light, 0, 256 - light, 256 - light, 256 - light);
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				shade.inv_desaturate = DrawAVX2::Broadcast(_mm_setr_epi16(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate));
+				__m128i shade_fade = _mm_set_epi16(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue, shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade.shade_fade = DrawAVX2::Broadcast(_mm_mullo_epi16(shade_fade, inv_light));
+				shade.shade_light = DrawAVX2::Broadcast(_mm_set_epi16(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue, shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue));
+				shade.desaturate = shade_constants.desaturate;
+			}
+			else
+			{
+				shade.inv_desaturate = _mm256_setzero_si256();
+				shade.shade_fade = _mm256_setzero_si256();
+				shade.shade_light = _mm256_setzero_si256();
+				shade.desaturate = 0;
+			}
+
+			int count = args.Count();
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			uint32_t fracstep = args.TextureVStep();
+			uint32_t frac = args.TextureVPos();
+			uint32_t texturefracx = args.TextureUPos();
+			uint32_t *dest = (uint32_t*)args.Dest();
+			int dest_y = args.DestY();
+
+			shade.lights = args.dc_lights;
+			shade.num_lights = args.dc_num_lights;
+			float vpz = args.dc_viewpos.Z + args.dc_viewpos_step.Z * thread->skipped_by_thread(dest_y);
+			float stepvpz = args.dc_viewpos_step.Z * thread->num_cores;
+			__m128 viewpos_z = _mm_setr_ps(vpz, vpz + stepvpz, 0.0f, 0.0f);
+			__m128 step_viewpos_z = _mm_set1_ps(stepvpz * 2.0f);
+
+			count = thread->count_for_thread(dest_y, count);
+			if (count <= 0) return;
+			frac += thread->skipped_by_thread(dest_y) * fracstep;
+			dest = thread->dest_for_thread(dest_y, pitch, dest);
+			fracstep *= thread->num_cores;
+			pitch *= thread->num_cores;
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				frac -= one / 2;
+			}
+
+			shade.srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			shade.destalpha = args.DestAlpha() >> (FRACBITS - 8);
+
+			__m256i offsets = DrawAVX2::Ramp(0u, (uint32_t)pitch);
+
+			int avxcount = count / 8;
+			for (int index = 0; index < avxcount; index++)
+			{
+				uint32_t *d = dest + index * pitch * 8;
+
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)WallBlendModes::Opaque)
+					bgcolor = DrawAVX2::LoadColumn(d, offsets);
+				else
+					bgcolor = _mm256_setzero_si256();
+
+				__m256i fgcolor;
+				if (FilterModeT::Mode == (int)FilterModes::Nearest)
+				{
+					__m256i fracs = DrawAVX2::Ramp(frac, fracstep);
+					__m256i sample_index = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(fracs, FRACBITS), _mm256_set1_epi32(textureheight)), FRACBITS);
+					fgcolor = _mm256_i32gather_epi32((const int*)source, sample_index, 4);
+					frac += fracstep * 8;
+				}
+				else
+				{
+					alignas(32) uint32_t ifgcolor[8];
+					for (int i = 0; i < 8; i++)
+					{
+						ifgcolor[i] = SampleLinear(frac, source, source2, textureheight, one, texturefracx);
+						frac += fracstep;
+					}
+					fgcolor = _mm256_load_si256((const __m256i*)ifgcolor);
+				}
+
+				DrawAVX2::StoreColumn(d, pitch, Shade<ShadeModeT>(fgcolor, bgcolor, shade, DrawAVX2::StepViewPos(viewpos_z, step_viewpos_z)));
+			}
+
+			int rest = count - avxcount * 8;
+			if (rest > 0)
+			{
+				uint32_t *d = dest + avxcount * pitch * 8;
+
+				alignas(32) uint32_t ifgcolor[8] = { 0 };
+				alignas(32) uint32_t ibgcolor[8] = { 0 };
+				for (int i = 0; i < rest; i++)
+				{
+					if (FilterModeT::Mode == (int)FilterModes::Nearest)
+						ifgcolor[i] = source[((frac >> FRACBITS) * textureheight) >> FRACBITS];
+					else
+						ifgcolor[i] = SampleLinear(frac, source, source2, textureheight, one, texturefracx);
+					frac += fracstep;
+
+					if (BlendT::Mode != (int)WallBlendModes::Opaque)
+						ibgcolor[i] = d[i * pitch];
+				}
+
+				alignas(32) uint32_t outcolor[8];
+				_mm256_store_si256((__m256i*)outcolor, Shade<ShadeModeT>(_mm256_load_si256((const __m256i*)ifgcolor), _mm256_load_si256((const __m256i*)ibgcolor), shade, DrawAVX2::StepViewPos(viewpos_z, step_viewpos_z)));
+				for (int i = 0; i < rest; i++)
+					d[i * pitch] = outcolor[i];
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE unsigned int VECTORCALL SampleLinear(uint32_t frac, const uint32_t *source, const uint32_t *source2, int textureheight, uint32_t one, uint32_t texturefracx)
+		{
+			unsigned int frac_y0 = (frac >> FRACBITS) * textureheight;
+			unsigned int frac_y1 = ((frac + one) >> FRACBITS) * textureheight;
+			unsigned int y0 = frac_y0 >> FRACBITS;
+			unsigned int y1 = frac_y1 >> FRACBITS;
+
+			unsigned int p00 = source[y0];
+			unsigned int p01 = source[y1];
+			unsigned int p10 = source2[y0];
+			unsigned int p11 = source2[y1];
+
+			unsigned int inv_b = texturefracx;
+			unsigned int inv_a = (frac_y1 >> (FRACBITS - 4)) & 15;
+			unsigned int a = 16 - inv_a;
+			unsigned int b = 16 - inv_b;
+
+			unsigned int sred = (RPART(p00) * (a * b) + RPART(p01) * (inv_a * b) + RPART(p10) * (a * inv_b) + RPART(p11) * (inv_a * inv_b) + 127) >> 8;
+			unsigned int sgreen = (GPART(p00) * (a * b) + GPART(p01) * (inv_a * b) + GPART(p10) * (a * inv_b) + GPART(p11) * (inv_a * inv_b) + 127) >> 8;
+			unsigned int sblue = (BPART(p00) * (a * b) + BPART(p01) * (inv_a * b) + BPART(p10) * (a * inv_b) + BPART(p11) * (inv_a * inv_b) + 127) >> 8;
+			unsigned int salpha = (APART(p00) * (a * b) + APART(p01) * (inv_a * b) + APART(p10) * (a * inv_b) + APART(p11) * (inv_a * inv_b) + 127) >> 8;
+
+			return (salpha << 24) | (sred << 16) | (sgreen << 8) | sblue;
+		}
+
+		// Shades and blends eight pixels
+		template<typename ShadeModeT>
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Shade(__m256i fgcolor, __m256i bgcolor, const ShadeData &shade, __m256 viewpos_z)
+		{
+			using namespace DrawWall32TModes;
+
+			__m256i fg_lo = DrawAVX2::UnpackLo(fgcolor);
+			__m256i fg_hi = DrawAVX2::UnpackHi(fgcolor);
+			__m256i material_lo = fg_lo;
+			__m256i material_hi = fg_hi;
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fg_lo = _mm256_srli_epi16(_mm256_mullo_epi16(fg_lo, shade.mlight), 8);
+				fg_hi = _mm256_srli_epi16(_mm256_mullo_epi16(fg_hi, shade.mlight), 8);
+			}
+			else
+			{
+				__m256i intensity_lo, intensity_hi;
+				DrawAVX2::Intensity(fgcolor, shade.desaturate, intensity_lo, intensity_hi);
+				fg_lo = ShadeAdvanced(fg_lo, intensity_lo, shade);
+				fg_hi = ShadeAdvanced(fg_hi, intensity_hi, shade);
+			}
+
+			__m256i lit_lo, lit_hi;
+			DrawAVX2::LightContribution(shade.lights, shade.num_lights, viewpos_z, false, lit_lo, lit_hi);
+			fg_lo = DrawAVX2::AddLights(material_lo, fg_lo, lit_lo);
+			fg_hi = DrawAVX2::AddLights(material_hi, fg_hi, lit_hi);
+
+			__m256i bg_lo, bg_hi;
+			if (BlendT::Mode == (int)WallBlendModes::Opaque)
+			{
+				return DrawAVX2::Pack(fg_lo, fg_hi);
+			}
+			else if (BlendT::Mode == (int)WallBlendModes::Masked)
+			{
+				bg_lo = DrawAVX2::UnpackLo(bgcolor);
+				bg_hi = DrawAVX2::UnpackHi(bgcolor);
+				return DrawAVX2::Pack(DrawAVX2::BlendMasked(fg_lo, bg_lo), DrawAVX2::BlendMasked(fg_hi, bg_hi));
+			}
+			else
+			{
+				bg_lo = DrawAVX2::UnpackLo(bgcolor);
+				bg_hi = DrawAVX2::UnpackHi(bgcolor);
+
+				__m256i fgalpha, bgalpha, fgalpha_lo, fgalpha_hi, bgalpha_lo, bgalpha_hi;
+				DrawAVX2::BlendAlpha(fgcolor, shade.srcalpha, shade.destalpha, fgalpha, bgalpha);
+				DrawAVX2::Splat(fgalpha, fgalpha_lo, fgalpha_hi);
+				DrawAVX2::Splat(bgalpha, bgalpha_lo, bgalpha_hi);
+
+				const int op =
+					BlendT::Mode == (int)WallBlendModes::AddClamp ? DrawAVX2::BlendAdd :
+					BlendT::Mode == (int)WallBlendModes::SubClamp ? DrawAVX2::BlendSub : DrawAVX2::BlendRevSub;
+				return DrawAVX2::Pack(DrawAVX2::BlendClamp<op>(fg_lo, bg_lo, fgalpha_lo, bgalpha_lo), DrawAVX2::BlendClamp<op>(fg_hi, bg_hi, fgalpha_hi, bgalpha_hi));
+			}
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL ShadeAdvanced(__m256i fgcolor, __m256i intensity, const ShadeData &shade)
+		{
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, shade.inv_desaturate), intensity), 8);
+			fgcolor = _mm256_mullo_epi16(fgcolor, shade.mlight);
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade.shade_fade, fgcolor), 8);
+			return _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade.shade_light), 8);
+		}
+
+		FString DebugInfo() override { return "DrawWall32AVX2T"; }
+		bool GetLines(int &first_line, int &count) override { first_line = args.DestY(); count = args.Count(); return true; }
+	};
+
+	typedef DrawWall32AVX2T<DrawWall32TModes::OpaqueWall> DrawWall32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::MaskedWall> DrawWallMasked32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::AddClampWall> DrawWallAddClamp32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::SubClampWall> DrawWallSubClamp32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::RevSubClampWall> DrawWallRevSubClamp32AVX2Command;
+}
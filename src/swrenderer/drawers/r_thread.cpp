@@ -40,6 +40,7 @@ void PeekThreadedErrorPane();
 #endif
 
 CVAR(Bool, r_multithreaded, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR(Bool, r_drawerbands, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 CVAR(Int, r_debug_draw, 0, 0);
 
 /////////////////////////////////////////////////////////////////////////////
@@ -66,10 +67,17 @@ void DrawerThreads::Execute(DrawerCommandQueuePtr commands)
 	
 	auto queue = Instance();
 
-	// Add to queue and awaken worker threads
 	std::unique_lock<std::mutex> start_lock(queue->start_mutex);
-	std::unique_lock<std::mutex> end_lock(queue->end_mutex);
 	queue->StartThreads();
+	start_lock.unlock();
+
+	// Give each thread a few bands to steal so that a slow band doesn't stall the others
+	if (r_drawerbands && !r_debug_draw && !commands->interleave_lines)
+		commands->BinCommands((int)queue->threads.size() * 4);
+
+	// Add to queue and awaken worker threads
+	start_lock.lock();
+	std::unique_lock<std::mutex> end_lock(queue->end_mutex);
 	queue->active_commands.push_back(commands);
 	queue->tasks_left += queue->threads.size();
 	end_lock.unlock();
@@ -151,6 +159,10 @@ void DrawerThreads::WorkerMain(DrawerThread *thread)
 					command->Execute(thread);
 			}
 		}
+		else if (list->num_bands > 0)
+		{
+			ExecuteBands(thread, list.get());
+		}
 		else
 		{
 			for (auto& command : list->commands)
@@ -169,6 +181,36 @@ void DrawerThreads::WorkerMain(DrawerThread *thread)
 	}
 }
 
+void DrawerThreads::ExecuteBands(DrawerThread *thread, DrawerCommandQueue *list)
+{
+	// Each band is rendered by a single thread, so its lines are no longer interleaved
+	int core = thread->core;
+	int num_cores = thread->num_cores;
+	thread->core = 0;
+	thread->num_cores = 1;
+
+	while (true)
+	{
+		int band = list->next_band++;
+		if (band >= list->num_bands)
+			break;
+
+		// The last band also gets the lines below the last binned command
+		thread->band_start = band * list->band_height;
+		thread->band_end = (band + 1 < list->num_bands) ? thread->band_start + list->band_height : 0x7fffffff;
+
+		for (auto& command : list->bands[band])
+		{
+			command->Execute(thread);
+		}
+	}
+
+	thread->core = core;
+	thread->num_cores = num_cores;
+	thread->band_start = 0;
+	thread->band_end = 0x7fffffff;
+}
+
 void DrawerThreads::StartThreads()
 {
 	if (!threads.empty())
@@ -220,3 +262,40 @@ void *DrawerCommandQueue::AllocMemory(size_t size)
 {
 	return FrameMemory->AllocMemory<uint8_t>((int)size);
 }
+
+void DrawerCommandQueue::BinCommands(int max_bands)
+{
+	int end_line = 0;
+	for (auto &command : commands)
+	{
+		int first_line, count;
+		if (command->GetLines(first_line, count))
+			end_line = MAX(end_line, first_line + count);
+	}
+
+	band_height = MAX((end_line + max_bands - 1) / MAX(max_bands, 1), 16);
+	num_bands = MAX((end_line + band_height - 1) / band_height, 1);
+	next_band = 0;
+
+	if ((int)bands.size() < num_bands)
+		bands.resize(num_bands);
+	for (int i = 0; i < num_bands; i++)
+		bands[i].clear();
+
+	for (auto &command : commands)
+	{
+		int first_line, count;
+		if (command->GetLines(first_line, count))
+		{
+			int first_band = clamp(first_line / band_height, 0, num_bands - 1);
+			int last_band = clamp((first_line + count - 1) / band_height, first_band, num_bands - 1);
+			for (int i = first_band; i <= last_band; i++)
+				bands[i].push_back(command);
+		}
+		else
+		{
+			for (int i = 0; i < num_bands; i++)
+				bands[i].push_back(command);
+		}
+	}
+}
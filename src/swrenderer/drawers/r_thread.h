@@ -27,11 +27,15 @@
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
 // Use multiple threads when drawing
 EXTERN_CVAR(Bool, r_multithreaded)
 
+// Let the drawer threads work on bands of lines instead of interleaving them
+EXTERN_CVAR(Bool, r_drawerbands)
+
 class PolyTriangleThreadData;
 
 // Worker data for each thread executing drawer commands
@@ -47,6 +51,10 @@ public:
 	// Number of active threads
 	int num_cores = 1;
 
+	// Lines of the band currently rendered by this thread
+	int band_start = 0;
+	int band_end = 0x7fffffff;
+
 	// Working buffer used by the tilted (sloped) span drawer
 	const uint8_t *tiltlighting[MAXWIDTH];
 
@@ -57,20 +65,22 @@ public:
 	// Checks if a line is rendered by this thread
 	bool line_skipped_by_thread(int line)
 	{
-		return line % num_cores != core;
+		return line < band_start || line >= band_end || line % num_cores != core;
 	}
 
 	// The number of lines to skip to reach the first line to be rendered by this thread
 	int skipped_by_thread(int first_line)
 	{
-		int core_skip = (num_cores - (first_line - core) % num_cores) % num_cores;
-		return core_skip;
+		int band_skip = MAX(band_start - first_line, 0);
+		int core_skip = (num_cores - (first_line + band_skip - core) % num_cores) % num_cores;
+		return band_skip + core_skip;
 	}
 
 	// The number of lines to be rendered by this thread
 	int count_for_thread(int first_line, int count)
 	{
-		int c = (count - skipped_by_thread(first_line) + num_cores - 1) / num_cores;
+		int lines = MIN(first_line + count, band_end) - first_line;
+		int c = (lines - skipped_by_thread(first_line) + num_cores - 1) / num_cores;
 		return MAX(c, 0);
 	}
 
@@ -96,6 +106,12 @@ public:
 
 	virtual void Execute(DrawerThread *thread) = 0;
 	virtual FString DebugInfo() = 0;
+
+	// The lines written by the command. Commands returning false are executed for every band.
+	virtual bool GetLines(int &first_line, int &count) { return false; }
+
+	// False for commands that don't clip their output with the DrawerThread line functions
+	virtual bool SupportsBands() { return true; }
 };
 
 void VectoredTryCatch(void *data, void(*tryBlock)(void *data), void(*catchBlock)(void *data, const char *reason, bool fatal));
@@ -121,6 +137,7 @@ private:
 	void StartThreads();
 	void StopThreads();
 	void WorkerMain(DrawerThread *thread);
+	void ExecuteBands(DrawerThread *thread, DrawerCommandQueue *list);
 
 	static DrawerThreads *Instance();
 	static void ReportDrawerError(DrawerCommand *command, bool worker_thread, const char *reason, bool fatal);
@@ -150,7 +167,7 @@ class DrawerCommandQueue
 public:
 	DrawerCommandQueue(RenderMemory *memoryAllocator);
 	
-	void Clear() { commands.clear(); }
+	void Clear() { commands.clear(); num_bands = 0; interleave_lines = false; }
 	
 	// Queue command to be executed by drawer worker threads
 	template<typename T, typename... Types>
@@ -162,6 +179,8 @@ public:
 			void *ptr = AllocMemory(sizeof(T));
 			T *command = new (ptr)T(std::forward<Types>(args)...);
 			commands.push_back(command);
+			if (!command->SupportsBands())
+				interleave_lines = true;
 		}
 		else
 		{
@@ -175,8 +194,17 @@ public:
 private:
 	// Allocate memory valid for the duration of a command execution
 	void *AllocMemory(size_t size);
+
+	// Sorts the commands into bands of lines
+	void BinCommands(int max_bands);
 	
 	std::vector<DrawerCommand *> commands;
+
+	std::vector<std::vector<DrawerCommand *>> bands;
+	int num_bands = 0;
+	int band_height = 0;
+	std::atomic<int> next_band;
+	bool interleave_lines = false;
 	RenderMemory *FrameMemory;
 	
 	friend class DrawerThreads;
@@ -54,6 +54,7 @@
 #include "swrenderer/line/r_wallsetup.h"
 #include "swrenderer/drawers/r_draw.h"
 #include "swrenderer/segments/r_clipsegment.h"
+#include "swrenderer/segments/r_coveragebuffer.h"
 #include "swrenderer/segments/r_drawsegment.h"
 #include "swrenderer/plane/r_visibleplane.h"
 #include "swrenderer/plane/r_visibleplanelist.h"
@@ -191,6 +192,13 @@ namespace swrenderer
 		}
 	}
 
+	void SWRenderLine::RenderMapOnly(seg_t *line, subsector_t *subsector, sector_t *sector)
+	{
+		mMapOnly = true;
+		Render(line, subsector, sector, nullptr, nullptr, nullptr, false, nullptr, Fake3DOpaque::Normal);
+		mMapOnly = false;
+	}
+
 	bool SWRenderLine::IsInvisibleLine() const
 	{
 		// Reject empty lines used for triggers and special events.
@@ -311,6 +319,13 @@ namespace swrenderer
 			I_Error("Bad R_StoreWallRange: %i to %i", start, stop);
 #endif
 
+		if (mMapOnly)
+		{
+			// The columns are closed already, so the solid segments and the automap are all that is left to update
+			if (!Thread->Scene->DontMapLines()) mLineSegment->linedef->flags |= ML_MAPPED;
+			return true;
+		}
+
 		if (!rw_prepped)
 		{
 			rw_prepped = true;
@@ -1127,6 +1142,8 @@ namespace swrenderer
 				memcpy(floorclip + x1, wallbottom.ScreenY + x1, (x2 - x1) * sizeof(short));
 			}
 		}
+
+		Thread->Coverage->Update(ceilingclip, floorclip, x1, x2, MAX(WallC.sz1, WallC.sz2));
 	}
 
 	void SWRenderLine::RenderTopTexture(int x1, int x2)
@@ -74,6 +74,9 @@ namespace swrenderer
 		SWRenderLine(RenderThread *thread);
 		void Render(seg_t *line, subsector_t *subsector, sector_t *sector, sector_t *fakebacksector, VisiblePlane *floorplane, VisiblePlane *ceilingplane, bool foggy, FDynamicColormap *basecolormap, Fake3DOpaque fake3DOpaque);
 
+		// Clips a line of a subsector hidden by the coverage buffer and marks it for the automap, without drawing anything
+		void RenderMapOnly(seg_t *line, subsector_t *subsector, sector_t *sector);
+
 		RenderThread *Thread = nullptr;
 
 	private:
@@ -111,6 +114,7 @@ namespace swrenderer
 		VisiblePlane *mCeilingPlane;
 		seg_t *mLineSegment;
 		Fake3DOpaque m3DFloor;
+		bool mMapOnly = false;
 
 		double mBackCeilingZ1;
 		double mBackCeilingZ2;
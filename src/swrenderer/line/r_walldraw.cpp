@@ -146,7 +146,7 @@ namespace swrenderer
 				xoffset = (xpos >> FRACBITS) * mip_width;
 			}
 
-			const uint32_t *pixels = texture->GetPixelsBgra() + mipmap_offset;
+			const uint32_t *pixels = (mipmap_offset != 0 ? texture->GetPixelsBgraWithMipmaps() : texture->GetPixelsBgra()) + mipmap_offset;
 
 			bool filter_nearest = (magnifying && !r_magfilter) || (!magnifying && !r_minfilter);
 			if (filter_nearest)
@@ -174,15 +174,20 @@ namespace swrenderer
 		}
 	}
 
-	// Draw a column with support for non-power-of-two ranges
-	void RenderWallPart::Draw1Column(int x, int y1, int y2, WallSampler &sampler)
+	// Find column position in view space
+	float RenderWallPart::ColumnDepth(int x) const
 	{
-		// Find column position in view space
 		float w1 = 1.0f / WallC.sz1;
 		float w2 = 1.0f / WallC.sz2;
 		float t = (x - WallC.sx1 + 0.5f) / (WallC.sx2 - WallC.sx1);
 		float wcol = w1 * (1.0f - t) + w2 * t;
-		float zcol = 1.0f / wcol;
+		return 1.0f / wcol;
+	}
+
+	// Draw a column, split into runs of rows touched by the same dynamic lights
+	void RenderWallPart::Draw1Column(int x, int y1, int y2, WallSampler &sampler)
+	{
+		float zcol = ColumnDepth(x);
 		float zbufferdepth = 1.0f / (zcol / Thread->Viewport->viewwindow.FocalTangent);
 
 		if (r_dynlights && light_list)
@@ -191,7 +196,6 @@ namespace swrenderer
 			
 			drawerargs.dc_viewpos.X = (float)((x + 0.5 - viewport->CenterX) / viewport->CenterX * zcol);
 			drawerargs.dc_viewpos.Y = zcol;
-			drawerargs.dc_viewpos.Z = (float)((viewport->CenterY - y1 - 0.5) / viewport->InvZtoScale * zcol);
 			drawerargs.dc_viewpos_step.Z = (float)(-zcol / viewport->InvZtoScale);
 
 			// Calculate max lights that can touch column so we can allocate memory for the list
@@ -204,8 +208,7 @@ namespace swrenderer
 				cur_node = cur_node->nextLight;
 			}
 
-			drawerargs.dc_num_lights = 0;
-			drawerargs.dc_lights = Thread->FrameMemory->AllocMemory<DrawerLight>(max_lights);
+			DrawerLightTiles tiles(Thread, max_lights);
 
 			// Setup lights for column
 			cur_node = light_list;
@@ -234,23 +237,43 @@ namespace swrenderer
 						uint32_t green = cur_node->lightsource->GetGreen();
 						uint32_t blue = cur_node->lightsource->GetBlue();
 
-						auto &light = drawerargs.dc_lights[drawerargs.dc_num_lights++];
+						DrawerLight light;
 						light.x = lconstant;
 						light.y = nlconstant;
 						light.z = lz;
 						light.radius = 256.0f / cur_node->lightsource->GetRadius();
 						light.color = (red << 16) | (green << 8) | blue;
+
+						// Rows where the light sphere crosses the column, with a pixel to spare for rounding
+						double halfheight = sqrt(radius * radius - lconstant) * 1.01;
+						double scale = viewport->InvZtoScale / zcol;
+						int first = (int)floor(viewport->CenterY - 0.5 - (lz + halfheight) * scale) - 1;
+						int last = (int)ceil(viewport->CenterY - 0.5 - (lz - halfheight) * scale) + 1;
+						tiles.AddLight(light, first, last);
 					}
 				}
 
 				cur_node = cur_node->nextLight;
 			}
+
+			int runY1, runY2;
+			tiles.Begin(y1, y2);
+			while (tiles.NextRun(runY1, runY2, drawerargs.dc_lights, drawerargs.dc_num_lights))
+			{
+				drawerargs.dc_viewpos.Z = (float)((viewport->CenterY - runY1 - 0.5) / viewport->InvZtoScale * zcol);
+				DrawColumnRun(x, runY1, runY2, sampler, zbufferdepth);
+			}
 		}
 		else
 		{
 			drawerargs.dc_num_lights = 0;
+			DrawColumnRun(x, y1, y2, sampler, zbufferdepth);
 		}
+	}
 
+	// Draws the rows y1 to y2 of a column with support for non-power-of-two ranges
+	void RenderWallPart::DrawColumnRun(int x, int y1, int y2, WallSampler &sampler, float zbufferdepth)
+	{
 		if (Thread->Viewport->RenderTarget->IsBgra())
 		{
 			int count = y2 - y1;
@@ -325,6 +348,40 @@ namespace swrenderer
 		}
 	}
 
+	// Queues a column for DrawWallColumns4. The batch must only hold adjacent columns.
+	void RenderWallPart::BatchColumn(int x, int y1, int y2, WallSampler &sampler)
+	{
+		int count = y2 - y1;
+
+		drawerargs.SetTexture(sampler.source, sampler.source2, sampler.height);
+		drawerargs.SetTextureUPos(sampler.texturefracx);
+		drawerargs.SetDest(Thread->Viewport.get(), x, y1);
+		drawerargs.SetCount(count);
+		drawerargs.SetTextureVStep(sampler.uv_step);
+		drawerargs.SetTextureVPos(sampler.uv_pos);
+		columnbatch[columnbatchsize++] = drawerargs;
+		if (r_models)
+			drawerargs.DrawDepthColumn(Thread, 1.0f / (ColumnDepth(x) / Thread->Viewport->viewwindow.FocalTangent));
+
+		uint64_t step64 = sampler.uv_step;
+		uint64_t pos64 = sampler.uv_pos;
+		sampler.uv_pos = (uint32_t)(pos64 + step64 * count);
+
+		if (columnbatchsize == 4)
+		{
+			Thread->Drawers(Thread->Viewport.get())->DrawWallColumns4(columnbatch);
+			columnbatchsize = 0;
+		}
+	}
+
+	// Draws the columns left in the batch one by one
+	void RenderWallPart::FlushColumnBatch()
+	{
+		for (int i = 0; i < columnbatchsize; i++)
+			columnbatch[i].DrawColumn(Thread);
+		columnbatchsize = 0;
+	}
+
 	void RenderWallPart::ProcessWallWorker(const short *uwal, const short *dwal, double texturemid, float *swal, fixed_t *lwal)
 	{
 		if (rw_pic->UseType == ETextureType::Null)
@@ -357,13 +414,19 @@ namespace swrenderer
 
 		double xmagnitude = 1.0;
 
+		// Opaque paletted walls without dynamic lights are drawn four columns at a time
+		bool batchcolumns = !Thread->Viewport->RenderTarget->IsBgra() && drawerargs.IsOpaqueDrawer() && !(r_dynlights && light_list);
+
 		float curlight = light;
 		for (int x = x1; x < x2; x++, curlight += lightstep)
 		{
 			int y1 = uwal[x];
 			int y2 = dwal[x];
 			if (y2 <= y1)
+			{
+				FlushColumnBatch();
 				continue;
+			}
 
 			if (!fixed)
 				drawerargs.SetLight(basecolormap, curlight, wallshade);
@@ -371,8 +434,18 @@ namespace swrenderer
 			if (x + 1 < x2) xmagnitude = fabs(FIXED2DBL(lwal[x + 1]) - FIXED2DBL(lwal[x]));
 
 			WallSampler sampler(Thread->Viewport.get(), y1, texturemid, swal[x], yrepeat, lwal[x] + xoffset, xmagnitude, rw_pic);
-			Draw1Column(x, y1, y2, sampler);
+			if (batchcolumns && (sampler.uv_max == 0 || sampler.uv_step == 0))
+			{
+				drawerargs.dc_num_lights = 0;
+				BatchColumn(x, y1, y2, sampler);
+			}
+			else
+			{
+				FlushColumnBatch();
+				Draw1Column(x, y1, y2, sampler);
+			}
 		}
+		FlushColumnBatch();
 
 		if (Thread->MainThread)
 			NetUpdate();
@@ -79,6 +79,10 @@ namespace swrenderer
 		void ProcessNormalWall(const short *uwal, const short *dwal, double texturemid, float *swal, fixed_t *lwal);
 		void ProcessWallWorker(const short *uwal, const short *dwal, double texturemid, float *swal, fixed_t *lwal);
 		void Draw1Column(int x, int y1, int y2, WallSampler &sampler);
+		void DrawColumnRun(int x, int y1, int y2, WallSampler &sampler, float zbufferdepth);
+		void BatchColumn(int x, int y1, int y2, WallSampler &sampler);
+		void FlushColumnBatch();
+		float ColumnDepth(int x) const;
 
 		int x1 = 0;
 		int x2 = 0;
@@ -98,6 +102,10 @@ namespace swrenderer
 		bool mask = false;
 
 		WallDrawerArgs drawerargs;
+
+		// Adjacent columns waiting for the four column drawer
+		WallDrawerArgs columnbatch[4];
+		int columnbatchsize = 0;
 	};
 
 	struct WallSampler
@@ -174,18 +174,12 @@ namespace swrenderer
 
 		auto viewport = Thread->Viewport.get();
 
-		double curxfrac = basexfrac + xstepscale * (x1 - minx);
-		double curyfrac = baseyfrac + ystepscale * (x1 - minx);
-
 		double distance = viewport->PlaneDepth(y, planeheight);
 
 		float zbufferdepth = (float)(1.0 / fabs(planeheight / Thread->Viewport->ScreenToViewY(y, 1.0)));
 
 		drawerargs.SetTextureUStep(distance * xstepscale / drawerargs.TextureWidth());
-		drawerargs.SetTextureUPos((distance * curxfrac + pviewx) / drawerargs.TextureWidth());
-
 		drawerargs.SetTextureVStep(distance * ystepscale / drawerargs.TextureHeight());
-		drawerargs.SetTextureVPos((distance * curyfrac + pviewy) / drawerargs.TextureHeight());
 		
 		if (viewport->RenderTarget->IsBgra())
 		{
@@ -207,7 +201,6 @@ namespace swrenderer
 		{
 			// Find row position in view space
 			float zspan = (float)(planeheight / (fabs(y + 0.5 - viewport->CenterY) / viewport->InvZtoScale));
-			drawerargs.dc_viewpos.X = (float)((x1 + 0.5 - viewport->CenterX) / viewport->CenterX * zspan);
 			drawerargs.dc_viewpos.Y = zspan;
 			drawerargs.dc_viewpos.Z = (float)((viewport->CenterY - y - 0.5) / viewport->InvZtoScale * zspan);
 			drawerargs.dc_viewpos_step.X = (float)(zspan / viewport->CenterX);
@@ -227,8 +220,7 @@ namespace swrenderer
 				cur_node = cur_node->next;
 			}
 
-			drawerargs.dc_num_lights = 0;
-			drawerargs.dc_lights = Thread->FrameMemory->AllocMemory<DrawerLight>(max_lights);
+			DrawerLightTiles tiles(Thread, max_lights);
 
 			// Setup lights for row
 			cur_node = light_list;
@@ -255,23 +247,49 @@ namespace swrenderer
 					uint32_t green = cur_node->lightsource->GetGreen();
 					uint32_t blue = cur_node->lightsource->GetBlue();
 
-					auto &light = drawerargs.dc_lights[drawerargs.dc_num_lights++];
+					DrawerLight light;
 					light.x = lx;
 					light.y = lconstant;
 					light.z = nlconstant;
 					light.radius = 256.0f / radius;
 					light.color = (red << 16) | (green << 8) | blue;
+
+					// Columns where the light sphere crosses the row, with a pixel to spare for rounding
+					double halfwidth = sqrt(radius * radius - lconstant) * 1.01;
+					double scale = viewport->CenterX / zspan;
+					int first = (int)floor(viewport->CenterX - 0.5 + (lx - halfwidth) * scale) - 1;
+					int last = (int)ceil(viewport->CenterX - 0.5 + (lx + halfwidth) * scale) + 1;
+					tiles.AddLight(light, first, last);
 				}
 
 				cur_node = cur_node->next;
 			}
+
+			int runX1, runX2;
+			tiles.Begin(x1, x2 + 1);
+			while (tiles.NextRun(runX1, runX2, drawerargs.dc_lights, drawerargs.dc_num_lights))
+			{
+				drawerargs.dc_viewpos.X = (float)((runX1 + 0.5 - viewport->CenterX) / viewport->CenterX * zspan);
+				DrawSpanRun(y, runX1, runX2 - 1, distance, zbufferdepth);
+			}
 		}
 		else
 		{
 			drawerargs.dc_num_lights = 0;
+			DrawSpanRun(y, x1, x2, distance, zbufferdepth);
 		}
+	}
+
+	// Draws the pixels x1 to x2 (inclusive) of a span
+	void RenderFlatPlane::DrawSpanRun(int y, int x1, int x2, double distance, float zbufferdepth)
+	{
+		double curxfrac = basexfrac + xstepscale * (x1 - minx);
+		double curyfrac = baseyfrac + ystepscale * (x1 - minx);
+
+		drawerargs.SetTextureUPos((distance * curxfrac + pviewx) / drawerargs.TextureWidth());
+		drawerargs.SetTextureVPos((distance * curyfrac + pviewy) / drawerargs.TextureHeight());
 
-		drawerargs.SetDestY(viewport, y);
+		drawerargs.SetDestY(Thread->Viewport.get(), y);
 		drawerargs.SetDestX1(x1);
 		drawerargs.SetDestX2(x2);
 
@@ -40,6 +40,7 @@ namespace swrenderer
 
 	private:
 		void RenderLine(int y, int x1, int x2) override;
+		void DrawSpanRun(int y, int x1, int x2, double distance, float zbufferdepth);
 
 		int minx;
 		double planeheight;
@@ -47,12 +47,14 @@
 #include "swrenderer/plane/r_visibleplanelist.h"
 #include "swrenderer/segments/r_drawsegment.h"
 #include "swrenderer/segments/r_clipsegment.h"
+#include "swrenderer/segments/r_coveragebuffer.h"
 #include "swrenderer/drawers/r_thread.h"
 #include "swrenderer/drawers/r_draw.h"
 #include "swrenderer/drawers/r_draw_rgba.h"
 #include "swrenderer/drawers/r_draw_pal.h"
 #include "swrenderer/viewport/r_viewport.h"
 #include "r_memory.h"
+#include "x86.h"
 
 namespace swrenderer
 {
@@ -73,7 +75,10 @@ namespace swrenderer
 		PlaneList.reset(new VisiblePlaneList(this));
 		DrawSegments.reset(new DrawSegmentList(this));
 		ClipSegments.reset(new RenderClipSegment());
+		Coverage.reset(new RenderCoverageBuffer());
 		tc_drawers.reset(new SWTruecolorDrawers(DrawQueue));
+		if (CPU.bAVX2)
+			tc_drawers_avx2.reset(CreateAVX2TruecolorDrawers(DrawQueue));
 		pal_drawers.reset(new SWPalDrawers(DrawQueue));
 	}
 
@@ -84,7 +89,7 @@ namespace swrenderer
 	SWPixelFormatDrawers *RenderThread::Drawers(RenderViewport *viewport)
 	{
 		if (viewport->RenderTarget->IsBgra())
-			return tc_drawers.get();
+			return tc_drawers_avx2 && r_drawers_avx2 ? tc_drawers_avx2.get() : tc_drawers.get();
 		else
 			return pal_drawers.get();
 	}
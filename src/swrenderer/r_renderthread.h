@@ -24,6 +24,7 @@
 
 #include <memory>
 #include <thread>
+#include "stats.h"
 
 class DrawerCommandQueue;
 typedef std::shared_ptr<DrawerCommandQueue> DrawerCommandQueuePtr;
@@ -44,6 +45,7 @@ namespace swrenderer
 	class VisiblePlaneList;
 	class DrawSegmentList;
 	class RenderClipSegment;
+	class RenderCoverageBuffer;
 	class RenderViewport;
 	class LightVisibility;
 	class SWPixelFormatDrawers;
@@ -60,6 +62,7 @@ namespace swrenderer
 		int X1 = 0;
 		int X2 = MAXWIDTH;
 		bool MainThread = false;
+		cycle_t SliceCycles;	// time spent in RenderThreadSlice during the last run
 
 		std::unique_ptr<RenderMemory> FrameMemory;
 		std::unique_ptr<RenderOpaquePass> OpaquePass;
@@ -71,6 +74,7 @@ namespace swrenderer
 		std::unique_ptr<VisiblePlaneList> PlaneList;
 		std::unique_ptr<DrawSegmentList> DrawSegments;
 		std::unique_ptr<RenderClipSegment> ClipSegments;
+		std::unique_ptr<RenderCoverageBuffer> Coverage;
 		std::unique_ptr<RenderViewport> Viewport;
 		std::unique_ptr<LightVisibility> Light;
 		DrawerCommandQueuePtr DrawQueue;
@@ -82,6 +86,7 @@ namespace swrenderer
 		short cliptop[MAXWIDTH];
 
 		SWPixelFormatDrawers *Drawers(RenderViewport *viewport);
+		bool HasAVX2Drawers() const { return tc_drawers_avx2 != nullptr; }
 
 		// Make sure texture can accessed safely
 		void PrepareTexture(FTexture *texture, FRenderStyle style);
@@ -91,6 +96,7 @@ namespace swrenderer
 		
 	private:
 		std::unique_ptr<SWTruecolorDrawers> tc_drawers;
+		std::unique_ptr<SWTruecolorDrawers> tc_drawers_avx2;
 		std::unique_ptr<SWPalDrawers> pal_drawers;
 	};
 }
@@ -51,6 +51,13 @@
 #include "polyrenderer/poly_renderer.h"
 #include "p_setup.h"
 #include "g_levellocals.h"
+#include "c_dispatch.h"
+#include "d_player.h"
+#include "stats.h"
+#include "x86.h"
+#include "files.h"
+#include "r_utility.h"
+#include "textures/bitmap.h"
 
 // [BB] Use ZDoom's freelook limit for the sotfware renderer.
 // Note: ZDoom's limit is chosen such that the sky is rendered properly.
@@ -63,6 +70,14 @@ CUSTOM_CVAR (Bool, cl_oldfreelooklimit, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG
 EXTERN_CVAR(Float, maxviewpitch)	// [SP] CVAR from OpenGL Renderer
 EXTERN_CVAR(Bool, r_drawvoxels)
 
+CVAR(Int, r_cameratexture_scale, 1, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// camera textures render at 1/scale of their size
+
+// Settings for the renderbench command
+CVAR(Int, renderbench_frames, 100, 0)
+CVAR(String, renderbench_png, "renderbench.png", 0)
+CVAR(String, renderbench_golden, "", 0)
+CVAR(Int, renderbench_tolerance, 0, 0)	// allowed difference per color channel
+
 using namespace swrenderer;
 
 FSoftwareRenderer::FSoftwareRenderer()
@@ -230,6 +245,36 @@ void FSoftwareRenderer::SetClearColor(int color)
 	mScene.SetClearColor(color);
 }
 
+//==========================================================================
+//
+// Copies a camera view that was rendered at a fraction of the texture
+// size into the column major texture buffer, scaling it back up.
+//
+//==========================================================================
+
+template<typename T, typename Convert>
+static void CopyScaledCameraView(T *dst, const T *src, int width, int height, int srcpitch, int scale, Convert convert)
+{
+	int srcwidth = (width + scale - 1) / scale;
+	int srcheight = (height + scale - 1) / scale;
+
+	// The destination can be the canvas itself, so get the view out of the way first.
+	TArray<T> view(srcwidth * srcheight, true);
+	for (int y = 0; y < srcheight; y++)
+	{
+		memcpy(&view[y * srcwidth], src + y * srcpitch, srcwidth * sizeof(T));
+	}
+
+	for (int x = 0; x < width; x++)
+	{
+		const T *column = &view[x / scale];
+		for (int y = 0; y < height; y++)
+		{
+			*dst++ = convert(column[(y / scale) * srcwidth]);
+		}
+	}
+}
+
 void FSoftwareRenderer::RenderTextureView (FCanvasTexture *tex, AActor *viewpoint, double fov)
 {
 	auto renderTarget = V_IsPolyRenderer() ? PolyRenderer::Instance()->RenderTarget : mScene.MainThread()->Viewport->RenderTarget;
@@ -250,14 +295,29 @@ void FSoftwareRenderer::RenderTextureView (FCanvasTexture *tex, AActor *viewpoin
 	DAngle savedfov = cameraViewpoint.FieldOfView;
 	R_SetFOV (cameraViewpoint, fov);
 
+	int scale = clamp(*r_cameratexture_scale, 1, 8);
+	int renderwidth = (tex->GetWidth() + scale - 1) / scale;
+	int renderheight = (tex->GetHeight() + scale - 1) / scale;
+
 	if (V_IsPolyRenderer())
-		PolyRenderer::Instance()->RenderViewToCanvas(viewpoint, Canvas, 0, 0, tex->GetWidth(), tex->GetHeight(), tex->bFirstUpdate);
+		PolyRenderer::Instance()->RenderViewToCanvas(viewpoint, Canvas, 0, 0, renderwidth, renderheight, tex->bFirstUpdate);
 	else
-		mScene.RenderViewToCanvas(viewpoint, Canvas, 0, 0, tex->GetWidth(), tex->GetHeight(), tex->bFirstUpdate);
+		mScene.RenderViewToCanvas(viewpoint, Canvas, 0, 0, renderwidth, renderheight, tex->bFirstUpdate);
 
 	R_SetFOV (cameraViewpoint, savedfov);
 
-	if (Canvas->IsBgra())
+	if (scale > 1)
+	{
+		if (Canvas->IsBgra())
+		{
+			CopyScaledCameraView((uint32_t*)Pixels, (const uint32_t*)Canvas->GetPixels(), tex->GetWidth(), tex->GetHeight(), Canvas->GetPitch(), scale, [](uint32_t c) { return c; });
+		}
+		else
+		{
+			CopyScaledCameraView(Pixels, Canvas->GetPixels(), tex->GetWidth(), tex->GetHeight(), Canvas->GetPitch(), scale, [](uint8_t c) { return GPalette.Remap[c]; });
+		}
+	}
+	else if (Canvas->IsBgra())
 	{
 		if (Pixels == Canvas->GetPixels())
 		{
@@ -324,3 +384,284 @@ void FSoftwareRenderer::SetColormap()
 	}
 }
 
+
+//==========================================================================
+//
+// Renders the current view to an offscreen true color canvas, first with
+// the SSE2 and then with the AVX2 drawers.
+//
+//==========================================================================
+
+void FSoftwareRenderer::BenchmarkDrawers(int frames)
+{
+	using namespace swrenderer;
+
+	AActor *camera = players[consoleplayer].camera;
+	int width = screen->GetWidth();
+	int height = screen->GetHeight();
+	DSimpleCanvas canvas(width, height, true);
+
+	bool avx2 = mScene.MainThread()->HasAVX2Drawers();
+	bool savedavx2 = r_drawers_avx2;
+	double frametime[2] = { 0.0, 0.0 };
+
+	mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
+	mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
+	for (int pass = 0; pass < (avx2 ? 2 : 1); pass++)
+	{
+		r_drawers_avx2 = pass == 1;
+
+		// The first frame pulls the textures into the cache.
+		mScene.RenderViewToCanvas(camera, &canvas, 0, 0, width, height);
+
+		cycle_t timer;
+		timer.Reset();
+		timer.Clock();
+		for (int i = 0; i < frames; i++)
+		{
+			mScene.RenderViewToCanvas(camera, &canvas, 0, 0, width, height);
+		}
+		timer.Unclock();
+		frametime[pass] = timer.TimeMS() / frames;
+	}
+	r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
+	r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
+	r_drawers_avx2 = savedavx2;
+
+	Printf("%dx%d, %d frames\n", width, height, frames);
+	Printf("SSE2: %.2f ms per frame\n", frametime[0]);
+	if (avx2)
+	{
+		Printf("AVX2: %.2f ms per frame (%.2fx)\n", frametime[1], frametime[0] / MAX(frametime[1], 1e-6));
+	}
+	else
+	{
+		Printf("AVX2: not supported by this %s\n", CPU.bAVX2 ? "build" : "CPU");
+	}
+}
+
+CCMD(bench_drawers)
+{
+	if (gamestate != GS_LEVEL || players[consoleplayer].camera == nullptr)
+	{
+		Printf("bench_drawers can only be used in a level\n");
+		return;
+	}
+	if (!V_IsSoftwareRenderer())
+	{
+		Printf("bench_drawers needs the software renderer\n");
+		return;
+	}
+
+	int frames = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 10000) : 100;
+	static_cast<FSoftwareRenderer*>(SWRenderer)->BenchmarkDrawers(frames);
+}
+
+//==========================================================================
+//
+// Counts the pixels that differ from a golden image by more than the
+// tolerance in any color channel. Returns -1 if the image can't be used.
+//
+//==========================================================================
+
+static int CompareToGolden(DCanvas *canvas, const PalEntry *palette, const char *goldenfile, int tolerance)
+{
+	FileReader fr;
+	if (!fr.OpenFile(goldenfile))
+	{
+		Printf("Could not open %s\n", goldenfile);
+		return -1;
+	}
+
+	PNGHandle *png = M_VerifyPNG(fr);
+	FTexture *golden = png != nullptr ? PNGTexture_CreateFromFile(png, goldenfile) : nullptr;
+	delete png;
+	if (golden == nullptr)
+	{
+		Printf("%s is not a supported PNG file\n", goldenfile);
+		return -1;
+	}
+
+	int width = canvas->GetWidth();
+	int height = canvas->GetHeight();
+	if (golden->GetWidth() != width || golden->GetHeight() != height)
+	{
+		Printf("%s is %dx%d, but the frame is %dx%d\n", goldenfile, golden->GetWidth(), golden->GetHeight(), width, height);
+		delete golden;
+		return -1;
+	}
+
+	FBitmap bmp;
+	bmp.Create(width, height);
+	golden->CopyTrueColorPixels(&bmp, 0, 0);
+	delete golden;
+
+	int differences = 0;
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t *expected = bmp.GetPixels() + y * bmp.GetPitch();
+		for (int x = 0; x < width; x++, expected += 4)
+		{
+			PalEntry color;
+			if (canvas->IsBgra())
+				color = ((const uint32_t *)canvas->GetPixels())[x + y * canvas->GetPitch()];
+			else
+				color = palette[canvas->GetPixels()[x + y * canvas->GetPitch()]];
+
+			if (abs(color.b - expected[0]) > tolerance || abs(color.g - expected[1]) > tolerance || abs(color.r - expected[2]) > tolerance)
+				differences++;
+		}
+	}
+	return differences;
+}
+
+//==========================================================================
+//
+// Renders the view repeatedly into an offscreen canvas, prints the average
+// time spent in each render pass and writes the last frame to a PNG.
+//
+//==========================================================================
+
+bool FSoftwareRenderer::RenderBenchmark(AActor *camera, int frames, const char *pngfile, const char *goldenfile, int tolerance)
+{
+	using namespace swrenderer;
+
+	bool poly = V_IsPolyRenderer();
+	int width = screen->GetWidth();
+	int height = screen->GetHeight();
+	DSimpleCanvas canvas(width, height, V_IsTrueColor());
+
+	double opaque = 0.0, translucent = 0.0, planes = 0.0, drawers = 0.0, total = 0.0;
+
+	R_ResetViewInterpolation();
+	for (int i = 0; i <= frames; i++)
+	{
+		cycle_t frametime;
+		frametime.Reset();
+		frametime.Clock();
+		if (poly)
+		{
+			PolyRenderer::Instance()->Viewpoint = r_viewpoint;
+			PolyRenderer::Instance()->Viewwindow = r_viewwindow;
+			PolyRenderer::Instance()->RenderViewToCanvas(camera, &canvas, 0, 0, width, height, true);
+			r_viewpoint = PolyRenderer::Instance()->Viewpoint;
+			r_viewwindow = PolyRenderer::Instance()->Viewwindow;
+		}
+		else
+		{
+			mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
+			mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
+			mScene.RenderViewToCanvas(camera, &canvas, 0, 0, width, height, true);
+			r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
+			r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
+		}
+		frametime.Unclock();
+
+		// The first frame pulls the textures into the cache and is not counted.
+		if (i == 0)
+			continue;
+
+		if (poly)
+		{
+			opaque += PolyOpaqueCycles.TimeMS();
+			translucent += PolyMaskedCycles.TimeMS();
+			planes += PolyCullCycles.TimeMS();
+			drawers += PolyDrawerWaitCycles.TimeMS();
+		}
+		else
+		{
+			opaque += WallCycles.TimeMS();
+			translucent += MaskedCycles.TimeMS();
+			planes += PlaneCycles.TimeMS();
+			drawers += DrawerWaitCycles.TimeMS();
+		}
+		total += frametime.TimeMS();
+	}
+
+	Printf("renderbench: %s renderer, %dx%d, %s, %d frames\n", poly ? "poly" : "software", width, height, canvas.IsBgra() ? "true color" : "paletted", frames);
+	Printf("frame=%.2f ms  opaque=%.2f ms  %s=%.2f ms  translucent=%.2f ms  drawers=%.2f ms\n",
+		total / frames, opaque / frames, poly ? "cull" : "planes", planes / frames, translucent / frames, drawers / frames);
+
+	PalEntry palette[256];
+	screen->GetFlashedPalette(palette);
+
+	if (pngfile != nullptr && *pngfile != 0)
+	{
+		FileWriter *file = FileWriter::Open(pngfile);
+		if (file == nullptr)
+		{
+			Printf("Could not create %s\n", pngfile);
+		}
+		else
+		{
+			if (canvas.IsBgra())
+				M_CreatePNG(file, canvas.GetPixels(), nullptr, SS_BGRA, width, height, canvas.GetPitch() * 4, Gamma);
+			else
+				M_CreatePNG(file, canvas.GetPixels(), palette, SS_PAL, width, height, canvas.GetPitch(), Gamma);
+			M_FinishPNG(file);
+			delete file;
+			Printf("Wrote %s\n", pngfile);
+		}
+	}
+
+	if (goldenfile != nullptr && *goldenfile != 0)
+	{
+		int differences = CompareToGolden(&canvas, palette, goldenfile, tolerance);
+		if (differences != 0)
+		{
+			if (differences > 0)
+				Printf("%d pixels differ from %s\n", differences, goldenfile);
+			return false;
+		}
+		Printf("Frame matches %s\n", goldenfile);
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// renderbench x y z angle [quit]
+//
+// Places the player's eye at the given position and benchmarks the view.
+// With quit the game exits afterwards, with exit code 1 if the benchmark
+// failed or the frame differs from renderbench_golden.
+//
+//==========================================================================
+
+CCMD(renderbench)
+{
+	if (argv.argc() < 5)
+	{
+		Printf("Usage: renderbench <x> <y> <z> <angle> [quit]\n");
+		return;
+	}
+
+	bool success = false;
+	player_t *player = &players[consoleplayer];
+	if (gamestate != GS_LEVEL || player->mo == nullptr)
+	{
+		Printf("renderbench can only be used in a level\n");
+	}
+	else if (V_IsHardwareRenderer())
+	{
+		Printf("renderbench needs the software or the poly renderer\n");
+	}
+	else
+	{
+		double viewz = atof(argv[3]);
+		player->mo->SetOrigin(atof(argv[1]), atof(argv[2]), viewz - player->viewheight, false);
+		player->mo->Angles.Yaw = DAngle(atof(argv[4]));
+		player->mo->Angles.Pitch = 0.;
+		player->mo->ClearInterpolation();
+		player->viewz = viewz;
+		player->camera = player->mo;
+
+		int frames = clamp(*renderbench_frames, 1, 10000);
+		success = static_cast<FSoftwareRenderer*>(SWRenderer)->RenderBenchmark(player->mo, frames, renderbench_png, renderbench_golden, renderbench_tolerance);
+	}
+
+	if (argv.argc() > 5 && stricmp(argv[5], "quit") == 0)
+	{
+		exit(success ? 0 : 1);
+	}
+}
@@ -26,6 +26,13 @@ struct FSoftwareRenderer : public FRenderer
 	void SetColormap() override;
 	void Init() override;
 
+	// renders the current view with the SSE2 and the AVX2 true color drawers and prints the times
+	void BenchmarkDrawers(int frames);
+
+	// renders the camera's view into an offscreen canvas and prints the time spent in each pass.
+	// returns false if the last frame differs from the golden image.
+	bool RenderBenchmark(AActor *camera, int frames, const char *pngfile, const char *goldenfile, int tolerance);
+
 private:
 	void PrecacheTexture(FTexture *tex, int cache);
 
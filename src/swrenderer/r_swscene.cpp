@@ -33,11 +33,17 @@
 #include "d_player.h"
 #include "textures/bitmap.h"
 #include "swrenderer/scene/r_light.h"
+#include "swrenderer/r_memory.h"
+#include "swrenderer/drawers/r_draw_pal.h"
+#include "r_videoscale.h"
+#include "stats.h"
 
 // [RH] Base blending values (for e.g. underwater)
 int BaseBlendR, BaseBlendG, BaseBlendB;
 float BaseBlendA;
 
+// Expand the paletted scene to BGRA on the drawer threads instead of doing the palette lookup in the shader
+CVAR(Bool, r_expandpalette, false, CVAR_ARCHIVE)
 
 
 class FSWPaletteTexture : public FTexture
@@ -87,6 +93,8 @@ public:
 SWSceneDrawer::SWSceneDrawer()
 {
 	PaletteTexture = new FSWPaletteTexture;
+	FrameMemory.reset(new RenderMemory());
+	DrawQueue.reset(new DrawerCommandQueue(FrameMemory.get()));
 }
 
 SWSceneDrawer::~SWSceneDrawer()
@@ -97,27 +105,102 @@ SWSceneDrawer::~SWSceneDrawer()
 
 sector_t *SWSceneDrawer::RenderView(player_t *player)
 {
-	DCanvas buffer(screen->GetWidth(), screen->GetHeight(), V_IsTrueColor());
+	bool expand = r_expandpalette && !V_IsTrueColor();
+	bool bgra = V_IsTrueColor() || expand;
+
+	int width = screen->GetWidth();
+	int height = screen->GetHeight();
+
+	// With dynamic scaling the scene is rendered into the top left part of the texture and stretched to the screen.
+	float scale = ViewportDynamicSceneScale();
+	int scenewidth = clamp((int)(width * scale + 0.5f), 1, width);
+	int sceneheight = clamp((int)(height * scale + 0.5f), 1, height);
+
+	DCanvas buffer(scenewidth, sceneheight, V_IsTrueColor());
 	if (FBTexture == nullptr || FBTexture->SystemTexture[0] == nullptr || 
-		FBTexture->GetWidth() != screen->GetWidth() || 
-		FBTexture->GetHeight() != screen->GetHeight() || 
-		(V_IsTrueColor() ? 1:0) != FBTexture->WidthBits)
+		FBTexture->GetWidth() != width || 
+		FBTexture->GetHeight() != height || 
+		(bgra ? 1:0) != FBTexture->WidthBits)
 	{
 		// This manually constructs its own material here.
 		if (FBTexture != nullptr) delete FBTexture;
-		FBTexture = new FSWSceneTexture(screen->GetWidth(), screen->GetHeight(), V_IsTrueColor());
-		FBTexture->SystemTexture[0]->AllocateBuffer(screen->GetWidth(), screen->GetHeight(), V_IsTrueColor() ? 4 : 1);
+		FBTexture = new FSWSceneTexture(width, height, bgra);
+		FBTexture->SystemTexture[0]->AllocateBuffer(width, height, bgra ? 4 : 1);
 		auto mat = FMaterial::ValidateTexture(FBTexture, false);
 		mat->AddTextureLayer(PaletteTexture);
 	}
 	auto buf = FBTexture->SystemTexture[0]->MapBuffer();
 	if (!buf) I_FatalError("Unable to map buffer for software rendering");
-	buffer.SetBuffer(screen->GetWidth(), screen->GetHeight(), screen->GetWidth(), buf);
+	if (expand)
+	{
+		PalettedCanvas.Resize(width * height);
+		buffer.SetBuffer(scenewidth, sceneheight, width, &PalettedCanvas[0]);
+	}
+	else
+	{
+		buffer.SetBuffer(scenewidth, sceneheight, width, buf);
+	}
+
+	cycle_t scenetime;
+	scenetime.Reset();
+	scenetime.Clock();
 	SWRenderer->RenderView(player, &buffer);
-	FBTexture->SystemTexture[0]->CreateTexture(nullptr, screen->GetWidth(), screen->GetHeight(), 0, false, 0, "swbuffer");
+	scenetime.Unclock();
+	ViewportUpdateDynamicSceneScale(scenetime.TimeMS());
+
+	// Restore the view window at screen resolution for the 2D drawing
+	if (scenewidth != width || sceneheight != height)
+		R_ExecuteSetViewSize(r_viewpoint, r_viewwindow);
 
 	auto map = swrenderer::CameraLight::Instance()->ShaderColormap();
-	screen->DrawTexture(FBTexture, 0, 0, DTA_SpecialColormap, map, TAG_DONE);
+	if (expand)
+	{
+		// The special colormap only depends on the palette index, so it is applied to the lookup table instead of the screen.
+		ExpandPalette(buf, width, scenewidth, sceneheight, map);
+		map = nullptr;
+	}
+
+	FBTexture->SystemTexture[0]->CreateTexture(nullptr, width, height, 0, false, 0, "swbuffer");
+
+	screen->DrawTexture(FBTexture, 0, 0,
+		DTA_SrcWidth, (double)scenewidth,
+		DTA_SrcHeight, (double)sceneheight,
+		DTA_DestWidth, width,
+		DTA_DestHeight, height,
+		DTA_SpecialColormap, map,
+		TAG_DONE);
 	SWRenderer->DrawRemainingPlayerSprites();
 	return r_viewpoint.sector;
 }
+
+//==========================================================================
+//
+// SWSceneDrawer :: ExpandPalette
+//
+// Converts the paletted canvas to BGRA in bands on the drawer threads
+//
+//==========================================================================
+
+void SWSceneDrawer::ExpandPalette(uint8_t *dest, int pitch, int width, int height, FSpecialColormap *colormap)
+{
+	for (int i = 0; i < 256; i++)
+	{
+		PalEntry color = GPalette.BaseColors[i];
+		if (colormap != nullptr)
+		{
+			// Same grayscale weights as the shader
+			float gray = (color.r * 0.4f + color.g * 0.56f + color.b * 0.14f) / 255.0f;
+			int r = int((colormap->ColorizeStart[0] + gray * (colormap->ColorizeEnd[0] - colormap->ColorizeStart[0])) * 255.0f);
+			int g = int((colormap->ColorizeStart[1] + gray * (colormap->ColorizeEnd[1] - colormap->ColorizeStart[1])) * 255.0f);
+			int b = int((colormap->ColorizeStart[2] + gray * (colormap->ColorizeEnd[2] - colormap->ColorizeStart[2])) * 255.0f);
+			color = PalEntry(clamp(r, 0, 255), clamp(g, 0, 255), clamp(b, 0, 255));
+		}
+		ExpandedPalette[i] = color.d | 0xff000000;
+	}
+
+	FrameMemory->Clear();
+	DrawQueue->Clear();
+	DrawQueue->Push<swrenderer::ExpandPaletteCommand>(&PalettedCanvas[0], pitch, (uint32_t*)dest, pitch, width, height, ExpandedPalette);
+	DrawerThreads::Execute(DrawQueue);
+	DrawerThreads::WaitForWorkers();
+}
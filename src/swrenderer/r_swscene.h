@@ -6,8 +6,12 @@
 #include "hwrenderer/scene/hw_clipper.h"
 #include "r_utility.h"
 #include "c_cvars.h"
+#include <memory>
 
 class FSWSceneTexture;
+class DrawerCommandQueue;
+class RenderMemory;
+struct FSpecialColormap;
 
 class SWSceneDrawer
 {
@@ -15,6 +19,14 @@ class SWSceneDrawer
 	FSWSceneTexture *FBTexture = nullptr;
 	bool FBIsTruecolor = false;
 
+	// Paletted canvas and lookup table used when the scene is expanded to BGRA on the drawer threads
+	TArray<uint8_t> PalettedCanvas;
+	uint32_t ExpandedPalette[256];
+	std::unique_ptr<RenderMemory> FrameMemory;
+	std::shared_ptr<DrawerCommandQueue> DrawQueue;
+
+	void ExpandPalette(uint8_t *dest, int pitch, int width, int height, FSpecialColormap *colormap);
+
 public:
 	SWSceneDrawer();
 	~SWSceneDrawer();
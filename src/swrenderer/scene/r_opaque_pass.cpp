@@ -47,6 +47,7 @@
 #include "swrenderer/things/r_particle.h"
 #include "swrenderer/things/r_model.h"
 #include "swrenderer/segments/r_clipsegment.h"
+#include "swrenderer/segments/r_coveragebuffer.h"
 #include "swrenderer/line/r_wallsetup.h"
 #include "swrenderer/line/r_farclip_line.h"
 #include "swrenderer/scene/r_scene.h"
@@ -435,6 +436,66 @@ namespace swrenderer
 		return Thread->ClipSegments->IsVisible(sx1, sx2);
 	}
 
+	// Checks the subsector against the coverage buffer.
+	// Returns true if everything the subsector would draw is hidden by what has been drawn already.
+	//
+	// The BSP walk visits subsectors front to back, so lying outside the open window is enough. But the
+	// planes of a sector are marked by the segs behind them, which means a seg projecting below the window
+	// still marks a visible ceiling all the way up to it, and one above the window marks a visible floor.
+	// Such subsectors may only be culled where their columns are closed.
+	bool RenderOpaquePass::IsSubsectorCovered(subsector_t *sub)
+	{
+		sector_t *sector = sub->sector;
+		if (sector->GetHeightSec() || (sector->e && sector->e->XFloor.ffloors.Size()) ||
+			sector->ValidatePortal(sector_t::ceiling) || sector->ValidatePortal(sector_t::floor))
+			return false;
+
+		auto viewport = Thread->Viewport.get();
+		const auto &viewpoint = viewport->viewpoint;
+		bool mirror = (Thread->Portal->MirrorFlags & RF_XFLIP) != 0;
+
+		double sx1 = DBL_MAX, sx2 = -DBL_MAX;
+		double minDepth = DBL_MAX, maxDepth = 0.0;
+		double topZ = -DBL_MAX, bottomZ = DBL_MAX;
+
+		seg_t *line = sub->firstline;
+		for (uint32_t i = 0; i < sub->numlines; i++, line++)
+		{
+			DVector2 pos = line->v1->fPos();
+			double tr_x = pos.X - viewpoint.Pos.X;
+			double tr_y = pos.Y - viewpoint.Pos.Y;
+			double tz = tr_x * viewpoint.TanCos + tr_y * viewpoint.TanSin;
+			if (tz < TOO_CLOSE_Z) // Crosses the view plane
+				return false;
+
+			double tx = tr_x * viewpoint.Sin - tr_y * viewpoint.Cos;
+			if (mirror)
+				tx = -tx;
+
+			double sx = viewport->CenterX + tx * viewport->CenterX / tz;
+			sx1 = MIN(sx1, sx);
+			sx2 = MAX(sx2, sx);
+			minDepth = MIN(minDepth, tz);
+			maxDepth = MAX(maxDepth, tz);
+			topZ = MAX(topZ, sector->ceilingplane.ZatPoint(pos));
+			bottomZ = MIN(bottomZ, sector->floorplane.ZatPoint(pos));
+		}
+
+		if (sx2 < 0.0 || sx1 > viewwidth)
+			return false;
+		int x1 = (int)MAX(sx1, 0.0);
+		int x2 = (int)MIN(sx2 + 1.0, (double)viewwidth);
+
+		// Nearer points project farther from the horizon
+		double viewz = viewpoint.Pos.Z;
+		double top = viewport->CenterY - (topZ - viewz) * viewport->InvZtoScale / (topZ > viewz ? minDepth : maxDepth);
+		double bottom = viewport->CenterY - (bottomZ - viewz) * viewport->InvZtoScale / (bottomZ > viewz ? maxDepth : minDepth);
+
+		bool ceilingVisible = sector->ceilingplane.PointOnSide(viewpoint.Pos) > 0 || sector->GetTexture(sector_t::ceiling) == skyflatnum;
+		bool floorVisible = sector->floorplane.PointOnSide(viewpoint.Pos) > 0 || sector->GetTexture(sector_t::floor) == skyflatnum;
+		return Thread->Coverage->IsHidden(x1, x2, top, bottom, DBL_MAX, !floorVisible, !ceilingVisible);
+	}
+
 	void RenderOpaquePass::AddPolyobjs(subsector_t *sub)
 	{
 		Thread->PreparePolyObject(sub);
@@ -506,6 +567,17 @@ namespace swrenderer
 			return;
 		}
 
+		// A covered subsector draws no planes or walls, but its sprites and particles are still
+		// culled one by one and the automap still has to learn which of its lines are in view.
+		bool covered = false;
+		if (outersubsector)
+		{
+			Thread->Coverage->Stats.Subsectors++;
+			covered = IsSubsectorCovered(sub);
+			if (covered)
+				Thread->Coverage->Stats.CulledSubsectors++;
+		}
+
 		sub->sector->MoreFlags |= SECMF_DRAWN;
 
 		// killough 3/8/98, 4/4/98: Deep water / fake ceiling effect
@@ -539,10 +611,10 @@ namespace swrenderer
 		FSectorPortal *portal = frontsector->ValidatePortal(sector_t::ceiling);
 
 		VisiblePlane *ceilingplane = nullptr;
-		if (frontsector->ceilingplane.PointOnSide(Thread->Viewport->viewpoint.Pos) > 0 ||
+		if (!covered && (frontsector->ceilingplane.PointOnSide(Thread->Viewport->viewpoint.Pos) > 0 ||
 			frontsector->GetTexture(sector_t::ceiling) == skyflatnum ||
 			portal ||
-			(frontsector->GetHeightSec() && frontsector->heightsec->GetTexture(sector_t::floor) == skyflatnum))
+			(frontsector->GetHeightSec() && frontsector->heightsec->GetTexture(sector_t::floor) == skyflatnum)))
 		{
 			ceilingplane = Thread->PlaneList->FindPlane(
 				frontsector->ceilingplane,
@@ -580,10 +652,10 @@ namespace swrenderer
 		portal = frontsector->ValidatePortal(sector_t::floor);
 
 		VisiblePlane *floorplane = nullptr;
-		if (frontsector->floorplane.PointOnSide(Thread->Viewport->viewpoint.Pos) > 0 ||
+		if (!covered && (frontsector->floorplane.PointOnSide(Thread->Viewport->viewpoint.Pos) > 0 ||
 			frontsector->GetTexture(sector_t::floor) == skyflatnum ||
 			portal ||
-			(frontsector->GetHeightSec() && frontsector->heightsec->GetTexture(sector_t::ceiling) == skyflatnum))
+			(frontsector->GetHeightSec() && frontsector->heightsec->GetTexture(sector_t::ceiling) == skyflatnum)))
 		{
 			floorplane = Thread->PlaneList->FindPlane(frontsector->floorplane,
 				frontsector->GetTexture(sector_t::floor),
@@ -629,7 +701,12 @@ namespace swrenderer
 		{
 			double dist1 = (line->v1->fPos() - viewpointPos).LengthSquared();
 			double dist2 = (line->v2->fPos() - viewpointPos).LengthSquared();
-			if (dist1 > line_distance_cull && dist2 > line_distance_cull)
+			if (covered)
+			{
+				if ((dist1 <= line_distance_cull || dist2 <= line_distance_cull) && (line->sidedef == nullptr || !(line->sidedef->Flags & WALLF_POLYOBJ)))
+					renderline.RenderMapOnly(line, InSubsector, frontsector);
+			}
+			else if (dist1 > line_distance_cull && dist2 > line_distance_cull)
 			{
 				FarClipLine farclip(Thread);
 				farclip.Render(line, InSubsector, floorplane, ceilingplane, Fake3DOpaque::Normal);
@@ -832,6 +909,7 @@ namespace swrenderer
 		SeenActors.clear();
 
 		InSubsector = nullptr;
+		Thread->Coverage->Clear(ceilingclip, floorclip, viewwidth);
 		RenderBSPNode(level.HeadNode());	// The head node is the last node output.
 
 		if (Thread->MainThread)
@@ -82,6 +82,7 @@ namespace swrenderer
 		void RenderBSPNode(void *node);
 		void RenderSubsector(subsector_t *sub);
 		bool CheckBBox(float *bspcoord);
+		bool IsSubsectorCovered(subsector_t *sub);
 
 		void AddPolyobjs(subsector_t *sub);
 
@@ -47,6 +47,7 @@
 #include "swrenderer/scene/r_translucent_pass.h"
 #include "swrenderer/scene/r_portal.h"
 #include "swrenderer/segments/r_clipsegment.h"
+#include "swrenderer/segments/r_coveragebuffer.h"
 #include "swrenderer/segments/r_drawsegment.h"
 #include "swrenderer/segments/r_portalsegment.h"
 #include "swrenderer/plane/r_visibleplanelist.h"
@@ -67,11 +68,19 @@ EXTERN_CVAR(Int, r_clearbuffer)
 EXTERN_CVAR(Int, r_debug_draw)
 
 CVAR(Bool, r_scene_multithreaded, false, 0);
+CVAR(Bool, r_scene_balanceslices, true, 0);
 CVAR(Bool, r_models, false, 0);
 
 namespace swrenderer
 {
 	cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
+
+	// Per thread busy time and the total time of the last sliced scene, for the slices stat.
+	static std::vector<double> SliceBusyMS;
+	static double SliceTotalMS;
+
+	// Coverage buffer culling counts of the last scene, summed over all threads.
+	static CoverageStats SceneCoverageStats;
 	
 	RenderScene::RenderScene()
 	{
@@ -94,10 +103,12 @@ namespace swrenderer
 		viewport->RenderTarget = target;
 		viewport->RenderingToCanvas = false;
 
-		R_ExecuteSetViewSize(MainThread()->Viewport->viewpoint, MainThread()->Viewport->viewwindow);
+		// The target can be smaller than the screen when the scene is rendered at a lower resolution
+		int width = target->GetWidth();
+		int height = target->GetHeight();
+
+		R_ExecuteSetViewSize(MainThread()->Viewport->viewpoint, MainThread()->Viewport->viewwindow, width, height);
 
-		int width = SCREENWIDTH;
-		int height = SCREENHEIGHT;
 		float trueratio;
 		ActiveRatio(width, height, &trueratio);
 		viewport->SetViewport(MainThread(), width, height, trueratio);
@@ -200,14 +211,28 @@ namespace swrenderer
 			StartThreads(numThreads);
 		}
 
+		// Camera textures always get equal slices so that they do not disturb
+		// the balance found for the main view.
+		bool balance = numThreads > 1 && r_scene_balanceslices && !MainThread()->Viewport->RenderingToCanvas;
+		if (balance && (slice_bounds.size() != (size_t)numThreads + 1 || slice_bounds.back() != viewwidth))
+		{
+			slice_bounds.resize(numThreads + 1);
+			for (int i = 0; i <= numThreads; i++)
+				slice_bounds[i] = viewwidth * i / numThreads;
+		}
+
+		cycle_t totalCycles;
+		totalCycles.Reset();
+		totalCycles.Clock();
+
 		// Setup threads:
 		std::unique_lock<std::mutex> start_lock(start_mutex);
 		for (int i = 0; i < numThreads; i++)
 		{
 			*Threads[i]->Viewport = *MainThread()->Viewport;
 			*Threads[i]->Light = *MainThread()->Light;
-			Threads[i]->X1 = viewwidth * i / numThreads;
-			Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+			Threads[i]->X1 = balance ? slice_bounds[i] : viewwidth * i / numThreads;
+			Threads[i]->X2 = balance ? slice_bounds[i + 1] : viewwidth * (i + 1) / numThreads;
 		}
 		run_id++;
 		start_lock.unlock();
@@ -239,19 +264,82 @@ namespace swrenderer
 			finished_threads = 0;
 		}
 
+		totalCycles.Unclock();
+		if (!MainThread()->Viewport->RenderingToCanvas)
+		{
+			SliceBusyMS.resize(numThreads);
+			for (int i = 0; i < numThreads; i++)
+				SliceBusyMS[i] = Threads[i]->SliceCycles.TimeMS();
+			SliceTotalMS = totalCycles.TimeMS();
+
+			SceneCoverageStats = CoverageStats();
+			for (int i = 0; i < numThreads; i++)
+			{
+				const CoverageStats &stats = Threads[i]->Coverage->Stats;
+				SceneCoverageStats.Subsectors += stats.Subsectors;
+				SceneCoverageStats.CulledSubsectors += stats.CulledSubsectors;
+				SceneCoverageStats.Sprites += stats.Sprites;
+				SceneCoverageStats.CulledSprites += stats.CulledSprites;
+			}
+		}
+		if (balance)
+			BalanceSlices(numThreads);
+
 		// Change main thread back to covering the whole screen for player sprites
 		MainThread()->X1 = 0;
 		MainThread()->X2 = viewwidth;
 	}
 
+	// Moves the slice boundaries so that each thread gets the same share of the
+	// time the threads took in this frame. Within a slice the time is assumed to
+	// be spread evenly over its columns. The boundaries only move halfway to their
+	// target each frame so that they settle instead of oscillating.
+	void RenderScene::BalanceSlices(int numThreads)
+	{
+		std::vector<double> cost(numThreads);
+		double total = 0.0;
+		for (int i = 0; i < numThreads; i++)
+		{
+			cost[i] = Threads[i]->SliceCycles.Time();
+			total += cost[i];
+		}
+		if (total <= 0.0 || viewwidth < numThreads * 2)
+			return;
+
+		std::vector<int> bounds = slice_bounds;
+		int slice = 0;
+		double before = 0.0;
+		for (int i = 1; i < numThreads; i++)
+		{
+			double target = total * i / numThreads;
+			while (slice < numThreads - 1 && before + cost[slice] < target)
+			{
+				before += cost[slice];
+				slice++;
+			}
+			double frac = cost[slice] > 0.0 ? clamp((target - before) / cost[slice], 0.0, 1.0) : 0.0;
+			int x = slice_bounds[slice] + (int)(frac * (slice_bounds[slice + 1] - slice_bounds[slice]) + 0.5);
+			bounds[i] = (slice_bounds[i] + x) / 2;
+		}
+
+		int minwidth = clamp(viewwidth / (numThreads * 4), 1, 16);
+		for (int i = 1; i < numThreads; i++)
+			bounds[i] = clamp(bounds[i], bounds[i - 1] + minwidth, viewwidth - (numThreads - i) * minwidth);
+		slice_bounds = bounds;
+	}
+
 	void RenderScene::RenderThreadSlice(RenderThread *thread)
 	{
+		thread->SliceCycles.Reset();
+		thread->SliceCycles.Clock();
+
 		thread->DrawQueue->Clear();
 		thread->FrameMemory->Clear();
 		thread->Clip3D->Cleanup();
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
 		thread->Portal->CopyStackedViewParameters();
 		thread->ClipSegments->Clear(0, viewwidth);
+		thread->Coverage->Stats = CoverageStats();
 		thread->DrawSegments->Clear();
 		thread->PlaneList->Clear();
 		thread->TranslucentPass->Clear();
@@ -291,6 +379,8 @@ namespace swrenderer
 		}
 
 		DrawerThreads::Execute(thread->DrawQueue);
+
+		thread->SliceCycles.Unclock();
 	}
 
 	void RenderScene::StartThreads(size_t numThreads)
@@ -419,6 +509,26 @@ namespace swrenderer
 		return out;
 	}
 
+	ADD_STAT(slices)
+	{
+		FString out;
+		out.Format("scene=%04.1f ms  busy/idle:", SliceTotalMS);
+		for (size_t i = 0; i < SliceBusyMS.size(); i++)
+		{
+			out.AppendFormat("  %04.1f/%04.1f", SliceBusyMS[i], MAX(SliceTotalMS - SliceBusyMS[i], 0.0));
+		}
+		return out;
+	}
+
+	ADD_STAT(coverage)
+	{
+		FString out;
+		out.Format("subsectors=%d culled=%d  sprites=%d culled=%d  (r_coveragecull %s)",
+			SceneCoverageStats.Subsectors, SceneCoverageStats.CulledSubsectors,
+			SceneCoverageStats.Sprites, SceneCoverageStats.CulledSprites, r_coveragecull ? "on" : "off");
+		return out;
+	}
+
 	static double bestwallcycles = HUGE_VAL;
 
 	ADD_STAT(wallcycles)
@@ -59,6 +59,7 @@ namespace swrenderer
 		void RenderActorView(AActor *actor, bool dontmaplines = false);
 		void RenderThreadSlices();
 		void RenderThreadSlice(RenderThread *thread);
+		void BalanceSlices(int numThreads);
 		void RenderPSprites();
 
 		void StartThreads(size_t numThreads);
@@ -75,5 +76,6 @@ namespace swrenderer
 		std::mutex end_mutex;
 		std::condition_variable end_condition;
 		size_t finished_threads = 0;
+		std::vector<int> slice_bounds;	// first column of each thread's slice, followed by viewwidth
 	};
 }
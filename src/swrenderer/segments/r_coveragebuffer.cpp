@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright 2018 The GZDoom development team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include "templates.h"
+#include "doomdef.h"
+#include "c_cvars.h"
+#include "swrenderer/segments/r_coveragebuffer.h"
+
+CVAR(Bool, r_coveragecull, true, 0)
+
+namespace swrenderer
+{
+	void RenderCoverageBuffer::Clear(const short *ceilingclip, const short *floorclip, int width)
+	{
+		Width = width;
+		int count = (width + ColumnWidth - 1) >> ColumnShift;
+		for (int i = 0; i < count; i++)
+		{
+			UpdateColumn(ceilingclip, floorclip, i);
+			Columns[i].Depth = 0.0f;
+		}
+	}
+
+	void RenderCoverageBuffer::Update(const short *ceilingclip, const short *floorclip, int x1, int x2, float depth)
+	{
+		if (x1 >= x2)
+			return;
+
+		int end = (x2 - 1) >> ColumnShift;
+		for (int i = x1 >> ColumnShift; i <= end; i++)
+		{
+			UpdateColumn(ceilingclip, floorclip, i);
+			Columns[i].Depth = MAX(Columns[i].Depth, depth);
+		}
+	}
+
+	void RenderCoverageBuffer::UpdateColumn(const short *ceilingclip, const short *floorclip, int column)
+	{
+		int x1 = column << ColumnShift;
+		int x2 = MIN(x1 + ColumnWidth, Width);
+
+		short top = ceilingclip[x1];
+		short bottom = floorclip[x1];
+		for (int x = x1 + 1; x < x2; x++)
+		{
+			top = MIN(top, ceilingclip[x]);
+			bottom = MAX(bottom, floorclip[x]);
+		}
+		Columns[column].Top = top;
+		Columns[column].Bottom = bottom;
+	}
+
+	bool RenderCoverageBuffer::IsHidden(int x1, int x2, double top, double bottom, double depth, bool testAbove, bool testBelow) const
+	{
+		if (!r_coveragecull)
+			return false;
+
+		// Grow the rectangle by a pixel to stay on the safe side of the rounding done by the drawers
+		x1 = MAX(x1 - 1, 0);
+		x2 = MIN(x2 + 1, Width);
+		if (x1 >= x2)
+			return false;
+		top -= 1.0;
+		bottom += 1.0;
+
+		int end = (x2 - 1) >> ColumnShift;
+		for (int i = x1 >> ColumnShift; i <= end; i++)
+		{
+			const CoverageColumn &column = Columns[i];
+			if (depth <= column.Depth)
+				return false;
+
+			if (column.Top >= column.Bottom)
+				continue;
+			if (testAbove && bottom <= column.Top)
+				continue;
+			if (testBelow && top >= column.Bottom)
+				continue;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright 2018 The GZDoom development team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include "r_defs.h"
+
+EXTERN_CVAR(Bool, r_coveragecull)
+
+namespace swrenderer
+{
+	struct CoverageStats
+	{
+		int Subsectors = 0;
+		int CulledSubsectors = 0;
+		int Sprites = 0;
+		int CulledSprites = 0;
+	};
+
+	// Low resolution copy of the opaque pass ceilingclip/floorclip arrays.
+	//
+	// Each column covers ColumnWidth screen columns and stores the union of their
+	// open windows plus the depth of the farthest wall that has narrowed them.
+	// Anything projecting entirely outside the window and lying beyond that depth
+	// is hidden by walls and planes that have already been drawn.
+	class RenderCoverageBuffer
+	{
+	public:
+		void Clear(const short *ceilingclip, const short *floorclip, int width);
+		void Update(const short *ceilingclip, const short *floorclip, int x1, int x2, float depth);
+
+		// Returns true if the screen rectangle [x1,x2) x [top,bottom] at the given depth is hidden.
+		// testAbove/testBelow allow it to be hidden by lying above or below the open window.
+		bool IsHidden(int x1, int x2, double top, double bottom, double depth, bool testAbove = true, bool testBelow = true) const;
+
+		CoverageStats Stats;
+
+		enum { ColumnShift = 3, ColumnWidth = 1 << ColumnShift };
+
+	private:
+		void UpdateColumn(const short *ceilingclip, const short *floorclip, int column);
+
+		struct CoverageColumn
+		{
+			short Top, Bottom;	// union of the open windows
+			float Depth;		// farthest occluder that narrowed the windows
+		};
+
+		int Width = 0;
+		CoverageColumn Columns[(MAXWIDTH >> ColumnShift) + 1];
+	};
+}
@@ -57,6 +57,7 @@
 #include "p_local.h"
 #include "r_voxel.h"
 #include "swrenderer/segments/r_drawsegment.h"
+#include "swrenderer/segments/r_coveragebuffer.h"
 #include "swrenderer/scene/r_portal.h"
 #include "swrenderer/scene/r_scene.h"
 #include "swrenderer/scene/r_light.h"
@@ -168,6 +169,17 @@ namespace swrenderer
 		if ((x2 < renderportal->WindowLeft || x2 <= x1))
 			return;
 
+		// hidden behind walls drawn so far?
+		RenderCoverageBuffer *coverage = thread->Coverage.get();
+		coverage->Stats.Sprites++;
+		double spritetop = viewport->CenterY - (gzt - viewport->viewpoint.Pos.Z) * viewport->InvZtoScale / tz;
+		double spritebottom = viewport->CenterY - (gzb - viewport->viewpoint.Pos.Z) * viewport->InvZtoScale / tz;
+		if (coverage->IsHidden(x1, x2, spritetop, spritebottom, tz))
+		{
+			coverage->Stats.CulledSprites++;
+			return;
+		}
+
 		xscale = spriteScale.X * xscale / tex->Scale.X;
 		fixed_t iscale = (fixed_t)(FRACUNIT / xscale); // Round towards zero to avoid wrapping in edge cases
 
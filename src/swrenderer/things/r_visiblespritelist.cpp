@@ -90,7 +90,15 @@ namespace swrenderer
 				FVector2 worldPos = SortedSprites[i]->WorldPos().XY();
 				SortedSprites[i]->SubsectorDepth = FindSubsectorDepth(thread, { worldPos.X, worldPos.Y });
 			}
+		}
 
+		// The scratch buffers of the radix sort must fit in a RenderMemory block
+		if (count >= MinRadixSortCount && count <= MaxRadixSortCount)
+		{
+			RadixSort(thread, count);
+		}
+		else if (r_models)
+		{
 			std::stable_sort(&SortedSprites[0], &SortedSprites[count], [](VisibleSprite *a, VisibleSprite *b) -> bool
 			{
 				if (a->SubsectorDepth != b->SubsectorDepth)
@@ -108,6 +116,87 @@ namespace swrenderer
 		}
 	}
 
+	// Sorts SortedSprites in the same order as the std::stable_sort comparisons above:
+	// by ascending subsector depth when models are enabled, then by descending distance.
+	void VisibleSpriteList::RadixSort(RenderThread *thread, unsigned int count)
+	{
+		SortEntry *entries = thread->FrameMemory->AllocMemory<SortEntry>(count);
+		SortEntry *scratch = thread->FrameMemory->AllocMemory<SortEntry>(count);
+
+		// The least significant key is sorted first
+		for (unsigned int i = 0; i < count; i++)
+		{
+			entries[i].Key = DistanceKey(SortedSprites[i]->SortDist());
+			entries[i].Index = i;
+		}
+		RadixSortEntries(entries, scratch, count);
+
+		if (r_models)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				entries[i].Key = (uint32_t)SortedSprites[entries[i].Index]->SubsectorDepth ^ 0x80000000;
+			RadixSortEntries(entries, scratch, count);
+		}
+
+		VisibleSprite **sprites = thread->FrameMemory->AllocMemory<VisibleSprite *>(count);
+		for (unsigned int i = 0; i < count; i++)
+			sprites[i] = SortedSprites[i];
+		for (unsigned int i = 0; i < count; i++)
+			SortedSprites[i] = sprites[entries[i].Index];
+	}
+
+	// Maps a distance to a key where larger distances get smaller keys
+	uint32_t VisibleSpriteList::DistanceKey(float dist)
+	{
+		uint32_t bits;
+		memcpy(&bits, &dist, sizeof(uint32_t));
+		if (bits == 0x80000000) // -0 equals 0
+			bits = 0;
+		uint32_t ascending = (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+		return ~ascending;
+	}
+
+	// Stable LSD radix sort on the keys. Leaves the sorted entries in entries.
+	void VisibleSpriteList::RadixSortEntries(SortEntry *&entries, SortEntry *&scratch, unsigned int count)
+	{
+		enum { DigitBits = 11, NumDigits = 1 << DigitBits, DigitMask = NumDigits - 1, NumPasses = 3 };
+
+		unsigned int histogram[NumPasses][NumDigits];
+		memset(histogram, 0, sizeof(histogram));
+		for (unsigned int i = 0; i < count; i++)
+		{
+			uint32_t key = entries[i].Key;
+			for (int pass = 0; pass < NumPasses; pass++)
+				histogram[pass][(key >> (pass * DigitBits)) & DigitMask]++;
+		}
+
+		for (int pass = 0; pass < NumPasses; pass++)
+		{
+			int shift = pass * DigitBits;
+			unsigned int *offsets = histogram[pass];
+
+			// Nothing to do if all keys have the same digit
+			if (offsets[(entries[0].Key >> shift) & DigitMask] == count)
+				continue;
+
+			unsigned int sum = 0;
+			for (int digit = 0; digit < NumDigits; digit++)
+			{
+				unsigned int digitcount = offsets[digit];
+				offsets[digit] = sum;
+				sum += digitcount;
+			}
+
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const SortEntry &entry = entries[i];
+				scratch[offsets[(entry.Key >> shift) & DigitMask]++] = entry;
+			}
+
+			std::swap(entries, scratch);
+		}
+	}
+
 	uint32_t VisibleSpriteList::FindSubsectorDepth(RenderThread *thread, const DVector2 &worldPos)
 	{
 		if (level.nodes.Size() == 0)
@@ -17,6 +17,19 @@ namespace swrenderer
 		TArray<VisibleSprite *> SortedSprites;
 
 	private:
+		struct SortEntry
+		{
+			uint32_t Key;
+			uint32_t Index;
+		};
+
+		// Lists with fewer than about a thousand sprites are faster with std::stable_sort
+		enum { MinRadixSortCount = 1024, MaxRadixSortCount = 32768 };
+
+		void RadixSort(RenderThread *thread, unsigned int count);
+		static uint32_t DistanceKey(float dist);
+		static void RadixSortEntries(SortEntry *&entries, SortEntry *&scratch, unsigned int count);
+
 		uint32_t FindSubsectorDepth(RenderThread *thread, const DVector2 &worldPos);
 		uint32_t FindSubsectorDepth(RenderThread *thread, const DVector2 &worldPos, void *node);
 
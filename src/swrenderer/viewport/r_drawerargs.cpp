@@ -21,9 +21,89 @@
 
 #include <stddef.h>
 #include "r_drawerargs.h"
+#include "swrenderer/r_renderthread.h"
+#include "swrenderer/r_memory.h"
 
 namespace swrenderer
 {
+	DrawerLightTiles::DrawerLightTiles(RenderThread *thread, int maxLights) : Thread(thread)
+	{
+		Lights = thread->FrameMemory->AllocMemory<DrawerLight>(maxLights);
+		First = thread->FrameMemory->AllocMemory<int>(maxLights);
+		Last = thread->FrameMemory->AllocMemory<int>(maxLights);
+		TileLights = thread->FrameMemory->AllocMemory<int>(maxLights);
+	}
+
+	void DrawerLightTiles::AddLight(const DrawerLight &light, int first, int last)
+	{
+		Lights[Count] = light;
+		First[Count] = first;
+		Last[Count] = last;
+		Count++;
+	}
+
+	void DrawerLightTiles::Begin(int start, int end)
+	{
+		Pos = start;
+		End = end;
+	}
+
+	bool DrawerLightTiles::NextRun(int &runStart, int &runEnd, DrawerLight *&lights, int &numLights)
+	{
+		if (Pos >= End)
+			return false;
+
+		int count = CollectLights(Pos, TileEnd(Pos));
+
+		// Merge following tiles as long as they are touched by the same lights
+		int end = TileEnd(Pos);
+		while (end < End && HasSameLights(end, TileEnd(end), count))
+			end = TileEnd(end);
+
+		runStart = Pos;
+		runEnd = end;
+		Pos = end;
+
+		numLights = count;
+		if (count == Count)
+		{
+			lights = Lights;
+		}
+		else
+		{
+			lights = Thread->FrameMemory->AllocMemory<DrawerLight>(count);
+			for (int i = 0; i < count; i++)
+				lights[i] = Lights[TileLights[i]];
+		}
+		return true;
+	}
+
+	int DrawerLightTiles::CollectLights(int tileStart, int tileEnd)
+	{
+		int count = 0;
+		for (int i = 0; i < Count; i++)
+		{
+			if (First[i] < tileEnd && Last[i] >= tileStart)
+				TileLights[count++] = i;
+		}
+		return count;
+	}
+
+	bool DrawerLightTiles::HasSameLights(int tileStart, int tileEnd, int count) const
+	{
+		int index = 0;
+		for (int i = 0; i < Count; i++)
+		{
+			bool touches = First[i] < tileEnd && Last[i] >= tileStart;
+			bool inRun = index < count && TileLights[index] == i;
+			if (touches != inRun)
+				return false;
+			if (inRun)
+				index++;
+		}
+		return true;
+	}
+
 	void DrawerArgs::SetLight(FSWColormap *base_colormap, float light, int shade)
 	{
 		mBaseColormap = base_colormap;
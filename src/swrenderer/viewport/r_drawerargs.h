@@ -18,6 +18,7 @@ namespace swrenderer
 {
 	class SWPixelFormatDrawers;
 	class DrawerArgs;
+	class RenderThread;
 	struct ShadeConstants;
 
 	struct DrawerLight
@@ -27,6 +28,37 @@ namespace swrenderer
 		float radius;
 	};
 
+	// Bins the dynamic lights of a column or span into screen tiles.
+	// The column or span is split into runs of tiles touched by the same lights,
+	// so that each drawer command only loops over the lights that reach its pixels.
+	class DrawerLightTiles
+	{
+	public:
+		enum { TileShift = 5, TileSize = 1 << TileShift };
+
+		DrawerLightTiles(RenderThread *thread, int maxLights);
+
+		// Adds a light that reaches the pixels first to last (inclusive)
+		void AddLight(const DrawerLight &light, int first, int last);
+
+		void Begin(int start, int end);
+		bool NextRun(int &runStart, int &runEnd, DrawerLight *&lights, int &numLights);
+
+	private:
+		int TileEnd(int pos) const { return MIN(((pos >> TileShift) + 1) << TileShift, End); }
+		int CollectLights(int tileStart, int tileEnd);
+		bool HasSameLights(int tileStart, int tileEnd, int count) const;
+
+		RenderThread *Thread;
+		DrawerLight *Lights;
+		int *First;
+		int *Last;
+		int *TileLights;
+		int Count = 0;
+		int Pos = 0;
+		int End = 0;
+	};
+
 	class DrawerArgs
 	{
 	public:
@@ -47,8 +47,12 @@ namespace swrenderer
 			ds_ybits--;
 		}
 
-		ds_source = thread->Viewport->RenderTarget->IsBgra() ? (const uint8_t*)tex->GetPixelsBgra() : tex->GetPixels(DefaultRenderStyle()); // Get correct render style? Shaded won't get here.
+		// The span drawers pick the mipmap level themselves.
 		ds_source_mipmapped = tex->Mipmapped() && tex->GetWidth() > 1 && tex->GetHeight() > 1;
+		if (thread->Viewport->RenderTarget->IsBgra())
+			ds_source = (const uint8_t*)(r_mipmap && ds_source_mipmapped ? tex->GetPixelsBgraWithMipmaps() : tex->GetPixelsBgra());
+		else
+			ds_source = tex->GetPixels(DefaultRenderStyle()); // Get correct render style? Shaded won't get here.
 	}
 
 	void SpanDrawerArgs::SetStyle(bool masked, bool additive, fixed_t alpha)
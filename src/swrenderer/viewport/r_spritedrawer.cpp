@@ -166,7 +166,7 @@ namespace swrenderer
 		}
 		xoffset = (xpos >> FRACBITS) * mip_width;
 
-		const uint32_t *pixels = tex->GetPixelsBgra() + mipmap_offset;
+		const uint32_t *pixels = (mipmap_offset != 0 ? tex->GetPixelsBgraWithMipmaps() : tex->GetPixelsBgra()) + mipmap_offset;
 
 		bool filter_nearest = (magnifying && !r_magfilter) || (!magnifying && !r_minfilter);
 		if (filter_nearest)
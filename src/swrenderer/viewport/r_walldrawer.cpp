@@ -77,4 +77,9 @@ namespace swrenderer
 	{
 		return wallfunc == &SWPixelFormatDrawers::DrawWallMaskedColumn;
 	}
+
+	bool WallDrawerArgs::IsOpaqueDrawer() const
+	{
+		return wallfunc == &SWPixelFormatDrawers::DrawWallColumn;
+	}
 }
@@ -29,6 +29,7 @@ namespace swrenderer
 		void SetTextureVStep(fixed_t step) { dc_iscale = step; }
 
 		bool IsMaskedDrawer() const;
+		bool IsOpaqueDrawer() const;
 
 		void DrawDepthColumn(RenderThread *thread, float idepth);
 		void DrawColumn(RenderThread *thread);
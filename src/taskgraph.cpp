@@ -0,0 +1,197 @@
+/*
+** taskgraph.cpp
+** Dependency driven task execution for startup
+**
+**---------------------------------------------------------------------------
+** Copyright 2018 The GZDoom development team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <vector>
+#include "taskgraph.h"
+#include "c_console.h"
+#include "templates.h"
+#include "d_profile.h"
+
+//==========================================================================
+//
+// FTaskGraph :: AddTask
+//
+// Dependencies must have been added before the tasks that depend on them,
+// which rules out cycles by construction.
+//
+//==========================================================================
+
+int FTaskGraph::AddTask(const char *name, std::function<void()> func, std::initializer_list<int> dependencies, int flags)
+{
+	int index = Tasks.Reserve(1);
+	Task &task = Tasks[index];
+	task.Name = name;
+	task.Func = std::move(func);
+	task.Pending = (int)dependencies.size();
+	task.Flags = flags;
+
+	for (int dep : dependencies)
+	{
+		assert(dep >= 0 && dep < index);
+		Tasks[dep].Dependents.Push(index);
+	}
+	return index;
+}
+
+//==========================================================================
+//
+// FTaskGraph :: Run
+//
+//==========================================================================
+
+void FTaskGraph::Run()
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	TArray<int> mainReady, workerReady;
+	TArray<FCapturedPrint> output;
+	std::exception_ptr error;
+	int remaining = Tasks.Size();
+	int running = 0;
+	int numWorkerTasks = 0;
+	bool stop = false;
+
+	for (unsigned i = 0; i < Tasks.Size(); i++)
+	{
+		bool main = !!(Tasks[i].Flags & MainThread);
+		if (!main) numWorkerTasks++;
+		if (Tasks[i].Pending == 0) (main ? mainReady : workerReady).Push(i);
+	}
+
+	int numWorkers = MIN<int>(numWorkerTasks, (int)std::thread::hardware_concurrency() - 1);
+
+	// Must be called with the mutex locked.
+	auto finishTask = [&](int index)
+	{
+		for (int dep : Tasks[index].Dependents)
+		{
+			if (--Tasks[dep].Pending == 0)
+			{
+				((Tasks[dep].Flags & MainThread) || numWorkers <= 0 ? mainReady : workerReady).Push(dep);
+			}
+		}
+		remaining--;
+		running--;
+		condition.notify_all();
+	};
+
+	auto runTask = [&](int index, TArray<FCapturedPrint> *capture)
+	{
+		C_SetPrintCapture(capture);
+		try
+		{
+			FProfileScope profile(Tasks[index].Name, "task");
+			Tasks[index].Func();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) error = std::current_exception();
+			stop = true;
+		}
+		C_SetPrintCapture(nullptr);
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numWorkers; i++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			TArray<FCapturedPrint> capture;
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true)
+			{
+				condition.wait(lock, [&] { return stop || remaining == 0 || workerReady.Size() > 0; });
+				if (stop || remaining == 0) break;
+
+				int index = workerReady[0];
+				workerReady.Delete(0);
+				running++;
+				lock.unlock();
+
+				runTask(index, &capture);
+
+				lock.lock();
+				for (auto &line : capture) output.Push(line);
+				capture.Clear();
+				finishTask(index);
+			}
+		}));
+	}
+
+	// Without workers everything runs on this thread.
+	if (numWorkers <= 0)
+	{
+		for (auto index : workerReady) mainReady.Push(index);
+		workerReady.Clear();
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		for (auto &line : output) PrintString(line.PrintLevel, line.Text);
+		output.Clear();
+
+		if (remaining == 0 || (stop && running == 0)) break;
+
+		if (!stop && mainReady.Size() > 0)
+		{
+			int index = mainReady[0];
+			mainReady.Delete(0);
+			running++;
+			lock.unlock();
+
+			runTask(index, nullptr);
+
+			lock.lock();
+			finishTask(index);
+		}
+		else
+		{
+			condition.wait(lock);
+		}
+	}
+	stop = true;
+	condition.notify_all();
+	lock.unlock();
+
+	for (auto &thread : workers) thread.join();
+	Tasks.Clear();
+
+	if (error) std::rethrow_exception(error);
+}
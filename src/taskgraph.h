@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include "tarray.h"
+
+//==========================================================================
+//
+// A small task graph for running independent startup phases concurrently.
+//
+// Tasks only start after all tasks they depend on have finished. Anything
+// that touches the console, the video or sound system, the CVar system or
+// other non thread safe engine state must be flagged MainThread. Worker
+// tasks may print - their output gets buffered and printed by the main
+// thread once the task is done. If any task throws, no further tasks are
+// started and the exception is rethrown from Run on the calling thread.
+//
+//==========================================================================
+
+class FTaskGraph
+{
+public:
+	enum
+	{
+		MainThread = 1,
+	};
+
+	int AddTask(const char *name, std::function<void()> func, std::initializer_list<int> dependencies = {}, int flags = 0);
+	void Run();
+
+private:
+	struct Task
+	{
+		const char *Name;
+		std::function<void()> Func;
+		TArray<int> Dependents;
+		int Pending;
+		int Flags;
+	};
+
+	TArray<Task> Tasks;
+};
@@ -34,6 +34,12 @@
 */
 
 #include <ctype.h>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "doomtype.h"
 #include "files.h"
 #include "w_wad.h"
@@ -49,6 +55,11 @@
 #include "v_video.h"
 #include "v_text.h"
 #include "cmdlib.h"
+#include "c_cvars.h"
+#include "m_misc.h"
+#include "m_swap.h"
+#include "md5.h"
+#include "doomerrors.h"
 
 // On the Alpha, accessing the shorts directly if they aren't aligned on a
 // 4-byte boundary causes unaligned access warnings. Why it does this at
@@ -194,8 +205,14 @@ protected:
 	TexInit *Inits;
 	bool bRedirect;
 	bool bTranslucentPatches;
+	std::atomic<int> CacheKeyState { 0 };	// 0: not computed yet, 1: CacheKey is valid, -1: not cacheable
+	uint8_t CacheKey[16];
 
 	uint8_t *MakeTexture (FRenderStyle style);
+	uint8_t *ComposeTexture (FRenderStyle style);
+	int ComposeTrueColor (FBitmap *bmp, int x, int y);
+	bool HashComposition (MD5Context &md5);
+	bool GetCacheName (int kind, FString &name);
 
 	// The getters must optionally redirect if it's a simple one-patch texture.
 	const uint8_t *GetPixels(FRenderStyle style) override { return bRedirect ? Parts->Texture->GetPixels(style) : FWorldTexture::GetPixels(style); }
@@ -394,6 +411,227 @@ uint8_t *GetBlendMap(PalEntry blend, uint8_t *blendwork)
 	return NULL;
 }
 
+//==========================================================================
+//
+// Disk cache for composed textures
+//
+// Composing a texture means loading all its patches, which for large
+// texture packs is a good part of the startup and precache time. The
+// results are stored in the user's cache path, named by the MD5 of
+// everything that goes into them: the part list with all translations
+// and blends, the palette and, for each patch, the name, size and
+// modification time of the file it comes from. Textures using anything
+// that cannot be identified this way, like camera textures or patches
+// from directories and nested archives, are not cached.
+//
+// The directory is limited to r_compositecache_size megabytes. Entries
+// for changed textures are never read again, so whenever a write takes
+// the cache over the limit the oldest files are removed.
+//
+//==========================================================================
+
+CVAR(Bool, r_compositecache, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Int, r_compositecache_size, 256, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+enum
+{
+	CACHE_Paletted,
+	CACHE_Alpha,
+	CACHE_Bgra,
+};
+
+static const char CompositeCacheMagic[4] = { 'M', 'P', 'T', '1' };
+
+static bool HashLumpSource(MD5Context &md5, int lump)
+{
+	if (lump < 0) return false;
+
+	const char *wadname = Wads.GetWadFullName(Wads.GetLumpFile(lump));
+	struct stat info;
+	if (wadname == nullptr || stat(wadname, &info) != 0 || (info.st_mode & S_IFDIR)) return false;
+
+	const char *lumpname = Wads.GetLumpFullName(lump);
+	int64_t stamp[3] = { (int64_t)info.st_size, (int64_t)info.st_mtime, Wads.LumpLength(lump) };
+	md5.Update((const uint8_t *)wadname, (unsigned)strlen(wadname) + 1);
+	md5.Update((const uint8_t *)lumpname, (unsigned)strlen(lumpname) + 1);
+	md5.Update((const uint8_t *)stamp, sizeof(stamp));
+	return true;
+}
+
+bool FMultiPatchTexture::HashComposition(MD5Context &md5)
+{
+	int32_t params[4] = { Width, Height, NumParts, bComplex };
+	md5.Update((const uint8_t *)params, sizeof(params));
+
+	for (int i = 0; i < NumParts; i++)
+	{
+		const TexPart &part = Parts[i];
+		FTexture *tex = part.Texture;
+
+		if (tex->bHasCanvas || tex->bWarped) return false;
+		if (tex->bMultiPatch)
+		{
+			if (!static_cast<FMultiPatchTexture *>(tex)->HashComposition(md5)) return false;
+		}
+		else if (!HashLumpSource(md5, tex->GetSourceLump()))
+		{
+			return false;
+		}
+
+		int32_t partparams[6] = { part.OriginX, part.OriginY, part.Rotate, part.op, part.Alpha, (int32_t)part.Blend.d };
+		md5.Update((const uint8_t *)partparams, sizeof(partparams));
+		if (part.Translation != nullptr)
+		{
+			md5.Update(part.Translation->Remap, 256);
+			md5.Update((const uint8_t *)part.Translation->Palette, 256 * sizeof(PalEntry));
+		}
+	}
+	return true;
+}
+
+static std::atomic<int64_t> CompositeCacheSize;
+static std::mutex CompositeCacheMutex;
+
+// Computed once, since this can get called from several threads. Leftovers
+// beyond the size limit are cleared out the first time.
+static const FString &GetCompositeCachePath()
+{
+	static const FString path = []()
+	{
+		FString dir = M_GetCachePath(true);
+		dir << "/composite/";
+		CreatePath(dir);
+		CompositeCacheSize = M_PruneCacheDirectory(dir, int64_t(MAX(*r_compositecache_size, 0)) << 20);
+		return dir;
+	}();
+	return path;
+}
+
+// Removes the oldest entries once new ones push the cache over its limit.
+static void AddCompositeCacheSize(int64_t size)
+{
+	int64_t limit = int64_t(MAX(*r_compositecache_size, 0)) << 20;
+	if ((CompositeCacheSize += size) > limit)
+	{
+		std::lock_guard<std::mutex> lock(CompositeCacheMutex);
+		if (CompositeCacheSize > limit)
+		{
+			CompositeCacheSize = M_PruneCacheDirectory(GetCompositeCachePath(), limit);
+		}
+	}
+}
+
+bool FMultiPatchTexture::GetCacheName(int kind, FString &name)
+{
+	if (!r_compositecache || bRedirect) return false;
+
+	// Hashing the composition stats every patch's file, so it is only done
+	// once per texture.
+	int state = CacheKeyState.load(std::memory_order_acquire);
+	if (state == 0)
+	{
+		static std::mutex keymutex;
+		std::lock_guard<std::mutex> lock(keymutex);
+
+		state = CacheKeyState.load(std::memory_order_relaxed);
+		if (state == 0)
+		{
+			MD5Context md5;
+			int32_t params[1] = { (int32_t)sizeof(PalEntry) };
+
+			md5.Init();
+			md5.Update((const uint8_t *)params, sizeof(params));
+			md5.Update((const uint8_t *)GPalette.BaseColors, 256 * sizeof(PalEntry));
+			state = HashComposition(md5) ? 1 : -1;
+			if (state > 0) md5.Final(CacheKey);
+			CacheKeyState.store(state, std::memory_order_release);
+		}
+	}
+	if (state < 0) return false;
+
+	name = GetCompositeCachePath();
+	for (auto b : CacheKey)
+	{
+		name.AppendFormat("%02x", b);
+	}
+	name.AppendFormat("-%d", kind);
+	return true;
+}
+
+//==========================================================================
+//
+// Each cache file is a small header followed by the zlib compressed
+// pixels, which get decompressed straight into the caller's buffer.
+//
+//==========================================================================
+
+static bool ReadCompositeCache(const FString &name, uint8_t *buffer, uint32_t size, int *retv)
+{
+	FileReader fr;
+	char magic[4];
+	uint32_t header[2];
+
+	if (!fr.OpenFile(name)) return false;
+	if (fr.Read(magic, 4) != 4 || memcmp(magic, CompositeCacheMagic, 4)) return false;
+	if (fr.Read(header, 8) != 8 || LittleLong(header[0]) != size) return false;
+
+	long compressedsize = fr.GetLength() - 12;
+	if (compressedsize <= 0) return false;
+	TArray<uint8_t> compressed(compressedsize, true);
+	if (fr.Read(&compressed[0], compressedsize) != compressedsize) return false;
+
+	uLongf outsize = size;
+	if (uncompress(buffer, &outsize, &compressed[0], compressedsize) != Z_OK || outsize != size) return false;
+	if (retv != nullptr) *retv = (int32_t)LittleLong(header[1]);
+	return true;
+}
+
+static void WriteCompositeCache(const FString &name, const uint8_t *buffer, uint32_t size, int retv)
+{
+	static std::atomic<int> tempcount;
+
+	uLongf outlen = compressBound(size);
+	TArray<uint8_t> compressed(outlen + 12, true);
+
+	if (compress2(&compressed[12], &outlen, buffer, size, Z_BEST_SPEED) != Z_OK) return;
+
+	uint32_t header[2] = { LittleLong(size), LittleLong(uint32_t(retv)) };
+	memcpy(&compressed[0], CompositeCacheMagic, 4);
+	memcpy(&compressed[4], header, 8);
+
+	// Textures may be composed on several threads at once, so write to a
+	// temporary file first and never leave a partial entry behind.
+	FString tempname;
+	tempname.Format("%s.%d.tmp", name.GetChars(), tempcount++);
+	FileWriter *fw = FileWriter::Open(tempname);
+	if (fw == nullptr) return;
+
+	bool ok = fw->Write(&compressed[0], outlen + 12) == outlen + 12;
+	delete fw;
+	if (!ok || rename(tempname, name) != 0)
+	{
+		remove(tempname);
+		return;
+	}
+	AddCompositeCacheSize(outlen + 12);
+}
+
+static bool IsClipAreaEmpty(const FBitmap *bmp)
+{
+	const FClipRect &cr = bmp->GetClipRect();
+	if (cr.width <= 0 || cr.height <= 0) return true;
+
+	const uint8_t *pixels = bmp->GetPixels() + cr.y * bmp->GetPitch() + cr.x * 4;
+	for (int y = 0; y < cr.height; y++, pixels += bmp->GetPitch())
+	{
+		for (int x = 0; x < cr.width * 4; x++)
+		{
+			if (pixels[x] != 0) return false;
+		}
+	}
+	return true;
+}
+
 //==========================================================================
 //
 // FMultiPatchTexture :: MakeTexture
@@ -404,6 +642,33 @@ uint8_t *FMultiPatchTexture::MakeTexture (FRenderStyle style)
 {
 	// Add a little extra space at the end if the texture's height is not
 	// a power of 2, in case somebody accidentally makes it repeat vertically.
+	int numpix = Width * Height + (1 << HeightBits) - Height;
+	FString cachename;
+
+	if (GetCacheName((style.Flags & STYLEF_RedIsAlpha) ? CACHE_Alpha : CACHE_Paletted, cachename))
+	{
+		auto Pixels = new uint8_t[numpix];
+		if (ReadCompositeCache(cachename, Pixels, numpix, nullptr))
+		{
+			return Pixels;
+		}
+		delete[] Pixels;
+
+		Pixels = ComposeTexture(style);
+		WriteCompositeCache(cachename, Pixels, numpix, 0);
+		return Pixels;
+	}
+	return ComposeTexture(style);
+}
+
+//==========================================================================
+//
+// FMultiPatchTexture :: ComposeTexture
+//
+//==========================================================================
+
+uint8_t *FMultiPatchTexture::ComposeTexture (FRenderStyle style)
+{
 	int numpix = Width * Height + (1 << HeightBits) - Height;
 	uint8_t blendwork[256];
 	bool buildrgb = bComplex;
@@ -509,6 +774,45 @@ int FMultiPatchTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rota
 		bmp->Zero();
 	}
 
+	// Composing onto an empty area always gives the same result, so only
+	// that case can come from the cache.
+	FString cachename;
+	if (GetCacheName(CACHE_Bgra, cachename) && IsClipAreaEmpty(bmp))
+	{
+		FBitmap tbmp;
+		if (tbmp.Create(Width, Height))
+		{
+			if (!ReadCompositeCache(cachename, tbmp.GetPixels(), Width * Height * 4, &retv))
+			{
+				retv = ComposeTrueColor(&tbmp, 0, 0);
+				WriteCompositeCache(cachename, tbmp.GetPixels(), Width * Height * 4, retv);
+			}
+			FCopyInfo overwrite = { OP_OVERWRITE, BLEND_NONE, {0}, 0, 0 };
+			bmp->CopyPixelDataRGB(x, y, tbmp.GetPixels(), Width, Height, 4, tbmp.GetPitch(), 0, CF_BGRA, &overwrite);
+			bmp->SetClipRect(saved_cr);
+			return retv;
+		}
+	}
+
+	retv = ComposeTrueColor(bmp, x, y);
+
+	// Restore previous clipping rectangle.
+	bmp->SetClipRect(saved_cr);
+	return retv;
+}
+
+//===========================================================================
+//
+// FMultipatchTexture::ComposeTrueColor
+//
+// Draws all parts, clipped to the bitmap's current clipping rectangle.
+//
+//===========================================================================
+
+int FMultiPatchTexture::ComposeTrueColor(FBitmap *bmp, int x, int y)
+{
+	int retv = -1;
+
 	for(int i = 0; i < NumParts; i++)
 	{
 		int ret = -1;
@@ -557,8 +861,6 @@ int FMultiPatchTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rota
 		if (ret == -1) retv = ret;
 		else if (retv != -1 && ret > retv) retv = ret;
 	}
-	// Restore previous clipping rectangle.
-	bmp->SetClipRect(saved_cr);
 	return retv;
 }
 
@@ -67,35 +67,66 @@ bool FWarpTexture::CheckModified (FRenderStyle style)
 	return screen->FrameTime != GenTime[!!(style.Flags & STYLEF_RedIsAlpha)];
 }
 
+//==========================================================================
+//
+// Once a buffer exists it gets warped in place. Going through Unload would
+// also throw away the source texture and have it reloaded every frame.
+//
+//==========================================================================
+
+const uint8_t *FWarpTexture::GetPixels(FRenderStyle style)
+{
+	int index = !!(style.Flags & STYLEF_RedIsAlpha);
+	if (Pixeldata[index] != nullptr && CheckModified(style))
+	{
+		Warp(Pixeldata[index], style);
+	}
+	return FWorldTexture::GetPixels(style);
+}
+
 const uint32_t *FWarpTexture::GetPixelsBgra()
 {
 	auto Pixels = GetPixels(DefaultRenderStyle());
 	if (PixelsBgra.empty() || GenTime[0] != GenTimeBgra)
 	{
-		CreatePixelsBgraWithMipmaps();
+		if (PixelsBgra.empty()) CreatePixelsBgraWithMipmaps();
+
+		uint32_t palette[256];
+		palette[0] = 0;
+		for (int i = 1; i < 256; i++)
+		{
+			palette[i] = 0xff000000 | GPalette.BaseColors[i].d;
+		}
 		for (int i = 0; i < Width * Height; i++)
 		{
-			if (Pixels[i] != 0)
-				PixelsBgra[i] = 0xff000000 | GPalette.BaseColors[Pixels[i]].d;
-			else
-				PixelsBgra[i] = 0;
+			PixelsBgra[i] = palette[Pixels[i]];
 		}
-		GenerateBgraMipmapsFast();
+		// The mipmaps only get rebuilt if something samples them.
+		BgraMipmapsPending = true;
 		GenTimeBgra = GenTime[0];
 	}
 	return PixelsBgra.data();
 }
 
+void FWarpTexture::GenerateBgraMipmaps()
+{
+	GenerateBgraMipmapsFast();
+}
 
 uint8_t *FWarpTexture::MakeTexture(FRenderStyle style)
+{
+	auto Pixels = new uint8_t[Width * Height];
+	Warp(Pixels, style);
+	return Pixels;
+}
+
+void FWarpTexture::Warp(uint8_t *Pixels, FRenderStyle style)
 {
 	uint64_t time = screen->FrameTime;
 	const uint8_t *otherpix = SourcePic->GetPixels(style);
-	auto Pixels = new uint8_t[Width * Height];
 	WarpBuffer(Pixels, otherpix, Width, Height, WidthOffsetMultiplier, HeightOffsetMultiplier, time, Speed, bWarped);
 	FreeAllSpans();
 	GenTime[!!(style.Flags & STYLEF_RedIsAlpha)] = time;
-	return Pixels;
 }
 
 // [mxd] Non power of 2 textures need different offset multipliers, otherwise warp animation won't sync across texture
@@ -348,11 +348,13 @@ int FTexture::CheckExternalFile(bool & hascolorkey)
 
 //==========================================================================
 //
-// Checks for the presence of a hires texture replacement and loads it
+// Checks for the presence of a hires texture replacement
+//
+// This may add files and textures so it must be done on the main thread.
 //
 //==========================================================================
 
-unsigned char *FTexture::LoadHiresTexture(int *width, int *height)
+void FTexture::ResolveHiresTexture()
 {
 	if (HiresLump == -1)
 	{
@@ -367,6 +369,17 @@ unsigned char *FTexture::LoadHiresTexture(int *width, int *height)
 			TexMan.AddTexture(HiresTexture);	// let the texture manager manage this.
 		}
 	}
+}
+
+//==========================================================================
+//
+// Checks for the presence of a hires texture replacement and loads it
+//
+//==========================================================================
+
+unsigned char *FTexture::LoadHiresTexture(int *width, int *height)
+{
+	ResolveHiresTexture();
 	if (HiresTexture != nullptr)
 	{
 		int w = HiresTexture->GetWidth();
@@ -20,6 +20,7 @@
 
 #include "common.h"
 #include "hqx.h"
+#include "../upscale_simd.h"
 
 #define PIXEL00_1M  *dp = Interp1(w[5], w[1]);
 #define PIXEL00_1U  *dp = Interp1(w[5], w[2]);
@@ -77,14 +78,17 @@
 
 HQX_API void HQX_CALLCONV hq3x_32_rb( uint32_t * sp, uint32_t srb, uint32_t * dp, uint32_t drb, int Xres, int Yres )
 {
-    int  i, j, k;
+    int  i, j;
     int  prevline, nextline;
     uint32_t  w[10];
     int dpL = (drb >> 2);
     int spL = (srb >> 2);
     uint8_t *sRowP = (uint8_t *) sp;
     uint8_t *dRowP = (uint8_t *) dp;
-    uint32_t yuv1, yuv2;
+    uint8_t *patterns = new uint8_t[Xres * Yres];
+    const uint8_t *pp = patterns;
+
+    HQxComputePatterns(sp, spL, Xres, Yres, patterns);
 
     //   +----+----+----+
     //   |    |    |    |
@@ -134,23 +138,8 @@ HQX_API void HQX_CALLCONV hq3x_32_rb( uint32_t * sp, uint32_t srb, uint32_t * dp
                 w[9] = w[8];
             }
 
-            int pattern = 0;
-            int flag = 1;
-
-            yuv1 = rgb_to_yuv(w[5]);
-
-            for (k=1; k<=9; k++)
-            {
-                if (k==5) continue;
-
-                if ( w[k] != w[5] )
-                {
-                    yuv2 = rgb_to_yuv(w[k]);
-                    if (yuv_diff(yuv1, yuv2))
-                        pattern |= flag;
-                }
-                flag <<= 1;
-            }
+            // Computed up front for the whole image by the vectorized kernels.
+            int pattern = *pp++;
 
             switch (pattern)
             {
@@ -3777,6 +3766,7 @@ HQX_API void HQX_CALLCONV hq3x_32_rb( uint32_t * sp, uint32_t srb, uint32_t * dp
         dRowP += drb * 3;
         dp = (uint32_t *) dRowP;
     }
+    delete[] patterns;
 }
 
 HQX_API void HQX_CALLCONV hq3x_32( uint32_t * sp, uint32_t * dp, int Xres, int Yres )
@@ -26,7 +26,7 @@ HQX_API void HQX_CALLCONV hqxInit(void)
     /* Initalize RGB to YUV lookup table */
     uint32_t c, r, g, b, y, u, v;
 	RGBtoYUV = new uint32_t[16777216];
-    for (c = 0; c < 16777215; c++) {
+    for (c = 0; c < 16777216; c++) {
         r = (c & 0xFF0000) >> 16;
         g = (c & 0x00FF00) >> 8;
         b = c & 0x0000FF;
@@ -34,9 +34,22 @@
 **
 */
 
+#include <atomic>
+#include <mutex>
+#include <zlib.h>
 #include "c_cvars.h"
+#include "c_dispatch.h"
+#include "i_time.h"
+#include "templates.h"
+#include "v_text.h"
 #include "v_video.h"
+#include "m_misc.h"
+#include "md5.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "m_swap.h"
 #include "hqnx/hqx.h"
+#include "upscale_simd.h"
 #ifdef HAVE_MMX
 #include "hqnx_asm/hqnx_asm.h"
 #endif
@@ -75,6 +88,8 @@ CVAR (Flag, gl_texture_hqresize_sprites, gl_texture_hqresize_targets, 2);
 CVAR (Flag, gl_texture_hqresize_fonts, gl_texture_hqresize_targets, 4);
 
 CVAR(Bool, gl_texture_hqresize_multithread, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR(Bool, gl_texture_hqresize_cache, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR(Int, gl_texture_hqresize_cache_size, 256, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 
 CUSTOM_CVAR(Int, gl_texture_hqresize_mt_width, 16, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 {
@@ -91,86 +106,12 @@ CUSTOM_CVAR(Int, gl_texture_hqresize_mt_height, 4, CVAR_ARCHIVE | CVAR_GLOBALCON
 
 static void scale2x ( uint32_t* inputBuffer, uint32_t* outputBuffer, int inWidth, int inHeight )
 {
-	const int width = 2* inWidth;
-	const int height = 2 * inHeight;
-
-	for ( int i = 0; i < inWidth; ++i )
-	{
-		const int iMinus = (i > 0) ? (i-1) : 0;
-		const int iPlus = (i < inWidth - 1 ) ? (i+1) : i;
-		for ( int j = 0; j < inHeight; ++j )
-		{
-			const int jMinus = (j > 0) ? (j-1) : 0;
-			const int jPlus = (j < inHeight - 1 ) ? (j+1) : j;
-			const uint32_t A = inputBuffer[ iMinus +inWidth*jMinus];
-			const uint32_t B = inputBuffer[ iMinus +inWidth*j    ];
-			const uint32_t C = inputBuffer[ iMinus +inWidth*jPlus];
-			const uint32_t D = inputBuffer[ i     +inWidth*jMinus];
-			const uint32_t E = inputBuffer[ i     +inWidth*j    ];
-			const uint32_t F = inputBuffer[ i     +inWidth*jPlus];
-			const uint32_t G = inputBuffer[ iPlus +inWidth*jMinus];
-			const uint32_t H = inputBuffer[ iPlus +inWidth*j    ];
-			const uint32_t I = inputBuffer[ iPlus +inWidth*jPlus];
-			if (B != H && D != F) {
-				outputBuffer[2*i   + width*2*j    ] = D == B ? D : E;
-				outputBuffer[2*i   + width*(2*j+1)] = B == F ? F : E;
-				outputBuffer[2*i+1 + width*2*j    ] = D == H ? D : E;
-				outputBuffer[2*i+1 + width*(2*j+1)] = H == F ? F : E;
-			} else {
-				outputBuffer[2*i   + width*2*j    ] = E;
-				outputBuffer[2*i   + width*(2*j+1)] = E;
-				outputBuffer[2*i+1 + width*2*j    ] = E;
-				outputBuffer[2*i+1 + width*(2*j+1)] = E;
-			}
-		}
-	}
+	Scale2x(inputBuffer, outputBuffer, inWidth, inHeight);
 }
 
 static void scale3x ( uint32_t* inputBuffer, uint32_t* outputBuffer, int inWidth, int inHeight )
 {
-	const int width = 3* inWidth;
-	const int height = 3 * inHeight;
-
-	for ( int i = 0; i < inWidth; ++i )
-	{
-		const int iMinus = (i > 0) ? (i-1) : 0;
-		const int iPlus = (i < inWidth - 1 ) ? (i+1) : i;
-		for ( int j = 0; j < inHeight; ++j )
-		{
-			const int jMinus = (j > 0) ? (j-1) : 0;
-			const int jPlus = (j < inHeight - 1 ) ? (j+1) : j;
-			const uint32_t A = inputBuffer[ iMinus +inWidth*jMinus];
-			const uint32_t B = inputBuffer[ iMinus +inWidth*j    ];
-			const uint32_t C = inputBuffer[ iMinus +inWidth*jPlus];
-			const uint32_t D = inputBuffer[ i     +inWidth*jMinus];
-			const uint32_t E = inputBuffer[ i     +inWidth*j    ];
-			const uint32_t F = inputBuffer[ i     +inWidth*jPlus];
-			const uint32_t G = inputBuffer[ iPlus +inWidth*jMinus];
-			const uint32_t H = inputBuffer[ iPlus +inWidth*j    ];
-			const uint32_t I = inputBuffer[ iPlus +inWidth*jPlus];
-			if (B != H && D != F) {
-				outputBuffer[3*i   + width*3*j    ] = D == B ? D : E;
-				outputBuffer[3*i   + width*(3*j+1)] = (D == B && E != C) || (B == F && E != A) ? B : E;
-				outputBuffer[3*i   + width*(3*j+2)] = B == F ? F : E;
-				outputBuffer[3*i+1 + width*3*j    ] = (D == B && E != G) || (D == H && E != A) ? D : E;
-				outputBuffer[3*i+1 + width*(3*j+1)] = E;
-				outputBuffer[3*i+1 + width*(3*j+2)] = (B == F && E != I) || (H == F && E != C) ? F : E;
-				outputBuffer[3*i+2 + width*3*j    ] = D == H ? D : E;
-				outputBuffer[3*i+2 + width*(3*j+1)] = (D == H && E != I) || (H == F && E != G) ? H : E;
-				outputBuffer[3*i+2 + width*(3*j+2)] = H == F ? F : E;
-			} else {
-				outputBuffer[3*i   + width*3*j    ] = E;
-				outputBuffer[3*i   + width*(3*j+1)] = E;
-				outputBuffer[3*i   + width*(3*j+2)] = E;
-				outputBuffer[3*i+1 + width*3*j    ] = E;
-				outputBuffer[3*i+1 + width*(3*j+1)] = E;
-				outputBuffer[3*i+1 + width*(3*j+2)] = E;
-				outputBuffer[3*i+2 + width*3*j    ] = E;
-				outputBuffer[3*i+2 + width*(3*j+1)] = E;
-				outputBuffer[3*i+2 + width*(3*j+2)] = E;
-			}
-		}
-	}
+	Scale3x(inputBuffer, outputBuffer, inWidth, inHeight);
 }
 
 static void scale4x ( uint32_t* inputBuffer, uint32_t* outputBuffer, int inWidth, int inHeight )
@@ -216,13 +157,9 @@ static unsigned char *hqNxAsmHelper( void (*hqNxFunction) ( int*, unsigned char*
 	outWidth = N * inWidth;
 	outHeight = N *inHeight;
 
-	static int initdone = false;
-
-	if (!initdone)
-	{
-		HQnX_asm::InitLUTs();
-		initdone = true;
-	}
+	// Textures can get upscaled on the precache worker threads.
+	static bool initdone = (HQnX_asm::InitLUTs(), true);
+	(void)initdone;
 
 	HQnX_asm::CImage cImageIn;
 	cImageIn.SetImage(inputBuffer, inWidth, inHeight, 32);
@@ -243,13 +180,9 @@ static unsigned char *hqNxHelper( void (*hqNxFunction) ( unsigned*, unsigned*, i
 							  int &outWidth,
 							  int &outHeight )
 {
-	static int initdone = false;
-
-	if (!initdone)
-	{
-		hqxInit();
-		initdone = true;
-	}
+	// Textures can get upscaled on the precache worker threads.
+	static bool initdone = (hqxInit(), true);
+	(void)initdone;
 	outWidth = N * inWidth;
 	outHeight = N *inHeight;
 
@@ -304,6 +237,252 @@ static void xbrzOldScale(size_t factor, const uint32_t* src, uint32_t* trg, int
 }
 
 
+//===========================================================================
+// 
+// Runs the selected upscaler. Returns inputBuffer if there is none.
+//
+//===========================================================================
+
+static unsigned char *UpscaleBuffer(int type, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight)
+{
+	switch (type)
+	{
+	case 1:
+		return scaleNxHelper( &scale2x, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 2:
+		return scaleNxHelper( &scale3x, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 3:
+		return scaleNxHelper( &scale4x, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 4:
+		return hqNxHelper( &hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 5:
+		return hqNxHelper( &hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 6:
+		return hqNxHelper( &hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+#ifdef HAVE_MMX
+	case 7:
+		return hqNxAsmHelper( &HQnX_asm::hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 8:
+		return hqNxAsmHelper( &HQnX_asm::hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 9:
+		return hqNxAsmHelper( &HQnX_asm::hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+#endif
+	case 10:
+	case 11:
+	case 12:
+		return xbrzHelper(xbrz::scale, type - 8, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+		
+	case 13:
+	case 14:
+	case 15:
+		return xbrzHelper(xbrzOldScale, type - 11, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+		
+	}
+	return inputBuffer;
+}
+
+//===========================================================================
+// 
+// Times the scaleNx and hqNx upscalers with each set of kernels the CPU
+// supports and checks that they all produce the same output as the
+// scalar code.
+//
+//===========================================================================
+
+CCMD(hqresize_benchmark)
+{
+	static const char *const names[] = { "scale2x", "scale3x", "scale4x", "hq2x", "hq3x", "hq4x" };
+	const int size = argv.argc() > 1 ? clamp(atoi(argv[1]), 16, 1024) : 256;
+	const int runs = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 100) : 5;
+
+	// Something with flat areas, soft gradients and hard edges, so that
+	// all code paths get used.
+	TArray<uint32_t> source(size * size, true);
+	uint32_t seed = 1;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			uint32_t c = 0xff000000 | ((x * 64 / size) << 16) | ((y * 64 / size) << 8);
+			if (((x >> 3) ^ (y >> 3)) & 1) c += 0x605040;
+			if ((seed >> 28) == 0) c ^= (seed >> 4) & 0x1f1f1f;
+			source[y * size + x] = c;
+		}
+	}
+
+	const FUpscaleKernels *kernels[4];
+	const int numkernels = GetSupportedUpscaleKernels(kernels, 4);
+
+	Printf("Upscaling %dx%d, best of %d runs\n", size, size, runs);
+	for (int type = 1; type <= 6; type++)
+	{
+		unsigned char *reference = nullptr;
+		int outWidth = 0, outHeight = 0;
+		FString line;
+		line.Format("%-8s", names[type - 1]);
+
+		double scalartime = 0;
+		for (int k = 0; k < numkernels; k++)
+		{
+			SetUpscaleKernels(kernels[k]);
+			double best = 0;
+			unsigned char *result = nullptr;
+			for (int run = 0; run < runs; run++)
+			{
+				unsigned char *input = new unsigned char[size * size * 4];
+				memcpy(input, &source[0], size * size * 4);
+				delete[] result;
+
+				uint64_t start = I_nsTime();
+				result = UpscaleBuffer(type, input, size, size, outWidth, outHeight);
+				double ms = (I_nsTime() - start) / 1e6;
+				if (run == 0 || ms < best) best = ms;
+			}
+
+			if (k == 0)
+			{
+				reference = result;
+				scalartime = best;
+				line.AppendFormat(" %s %.2f ms", kernels[k]->Name, best);
+			}
+			else
+			{
+				bool same = !memcmp(reference, result, outWidth * outHeight * 4);
+				line.AppendFormat(" | %s %.2f ms (%.1fx)%s", kernels[k]->Name, best, scalartime / best, same ? "" : TEXTCOLOR_RED " MISMATCH" TEXTCOLOR_NORMAL);
+				delete[] result;
+			}
+		}
+		delete[] reference;
+		Printf("%s\n", line.GetChars());
+	}
+	SetUpscaleKernels(nullptr);
+}
+
+//===========================================================================
+// 
+// Disk cache for upscaled textures
+//
+// Files are named by the MD5 of the source pixels, their size and the
+// upscaler, so changed textures simply get new entries. Each file holds
+// a small header and the zlib compressed result. The directory is limited
+// to gl_texture_hqresize_cache_size megabytes and whenever a write takes
+// it over the limit the oldest files are removed.
+//
+//===========================================================================
+
+static const char UpscaleCacheMagic[4] = { 'H', 'Q', 'R', '1' };
+static std::atomic<int64_t> UpscaleCacheSize;
+static std::mutex UpscaleCacheMutex;
+
+// Computed once, since this can get called from several threads. Leftovers
+// beyond the size limit are cleared out the first time.
+static const FString &GetUpscaleCachePath()
+{
+	static const FString path = []()
+	{
+		FString dir = M_GetCachePath(true);
+		dir << "/hqresize/";
+		CreatePath(dir);
+		UpscaleCacheSize = M_PruneCacheDirectory(dir, int64_t(MAX(*gl_texture_hqresize_cache_size, 0)) << 20);
+		return dir;
+	}();
+	return path;
+}
+
+static void AddUpscaleCacheSize(int64_t size)
+{
+	int64_t limit = int64_t(MAX(*gl_texture_hqresize_cache_size, 0)) << 20;
+	if ((UpscaleCacheSize += size) > limit)
+	{
+		std::lock_guard<std::mutex> lock(UpscaleCacheMutex);
+		if (UpscaleCacheSize > limit)
+		{
+			UpscaleCacheSize = M_PruneCacheDirectory(GetUpscaleCachePath(), limit);
+		}
+	}
+}
+
+static FString GetUpscaleCacheName(const unsigned char *buffer, int width, int height, int type)
+{
+	MD5Context md5;
+	uint8_t digest[16];
+	uint32_t params[3] = { LittleLong(uint32_t(width)), LittleLong(uint32_t(height)), LittleLong(uint32_t(type)) };
+
+	md5.Init();
+	md5.Update(buffer, width * height * 4);
+	md5.Update((const uint8_t *)params, sizeof(params));
+	md5.Final(digest);
+
+	FString name = GetUpscaleCachePath();
+	for (auto b : digest)
+	{
+		name.AppendFormat("%02x", b);
+	}
+	return name;
+}
+
+static unsigned char *ReadUpscaleCache(const FString &name, int &outWidth, int &outHeight)
+{
+	FileReader fr;
+	char magic[4];
+	uint32_t header[2];
+
+	if (!fr.OpenFile(name)) return nullptr;
+	if (fr.Read(magic, 4) != 4 || memcmp(magic, UpscaleCacheMagic, 4)) return nullptr;
+	if (fr.Read(header, 8) != 8) return nullptr;
+
+	int width = LittleLong(header[0]);
+	int height = LittleLong(header[1]);
+	if (width <= 0 || height <= 0 || width > 16384 || height > 16384) return nullptr;
+
+	long compressedsize = fr.GetLength() - 12;
+	TArray<uint8_t> compressed(compressedsize, true);
+	if (compressedsize <= 0 || fr.Read(&compressed[0], compressedsize) != compressedsize) return nullptr;
+
+	uLongf size = width * height * 4;
+	unsigned char *buffer = new unsigned char[size];
+	if (uncompress(buffer, &size, &compressed[0], compressedsize) != Z_OK || size != uLongf(width * height * 4))
+	{
+		delete[] buffer;
+		return nullptr;
+	}
+	outWidth = width;
+	outHeight = height;
+	return buffer;
+}
+
+static void WriteUpscaleCache(const FString &name, const unsigned char *buffer, int width, int height)
+{
+	static std::atomic<int> tempcount;
+
+	uLongf size = width * height * 4;
+	uLongf outlen = compressBound(size);
+	TArray<uint8_t> compressed(outlen + 12, true);
+
+	if (compress2(&compressed[12], &outlen, buffer, size, Z_BEST_SPEED) != Z_OK) return;
+
+	uint32_t header[2] = { LittleLong(uint32_t(width)), LittleLong(uint32_t(height)) };
+	memcpy(&compressed[0], UpscaleCacheMagic, 4);
+	memcpy(&compressed[4], header, 8);
+
+	// Write to a temporary file first so that other threads or a crash
+	// never leave a partially written entry behind.
+	FString tempname;
+	tempname.Format("%s.%d.tmp", name.GetChars(), tempcount++);
+	FileWriter *fw = FileWriter::Open(tempname);
+	if (fw == nullptr) return;
+
+	bool ok = fw->Write(&compressed[0], outlen + 12) == outlen + 12;
+	delete fw;
+	if (!ok || rename(tempname, name) != 0)
+	{
+		remove(tempname);
+		return;
+	}
+	AddUpscaleCacheSize(outlen + 12);
+}
+
 //===========================================================================
 // 
 // [BB] Upsamples the texture in inputBuffer, frees inputBuffer and returns
@@ -358,39 +537,24 @@ unsigned char *FTexture::CreateUpsampledTextureBuffer (unsigned char *inputBuffe
 		}
 #endif
 
-		switch (type)
+		FString cachename;
+		if (gl_texture_hqresize_cache && type > 0)
 		{
-		case 1:
-			return scaleNxHelper( &scale2x, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 2:
-			return scaleNxHelper( &scale3x, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 3:
-			return scaleNxHelper( &scale4x, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 4:
-			return hqNxHelper( &hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 5:
-			return hqNxHelper( &hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 6:
-			return hqNxHelper( &hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-#ifdef HAVE_MMX
-		case 7:
-			return hqNxAsmHelper( &HQnX_asm::hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 8:
-			return hqNxAsmHelper( &HQnX_asm::hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 9:
-			return hqNxAsmHelper( &HQnX_asm::hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-#endif
-		case 10:
-		case 11:
-		case 12:
-			return xbrzHelper(xbrz::scale, type - 8, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-			
-		case 13:
-		case 14:
-		case 15:
-			return xbrzHelper(xbrzOldScale, type - 11, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-			
+			cachename = GetUpscaleCacheName(inputBuffer, inWidth, inHeight, type);
+			unsigned char *cached = ReadUpscaleCache(cachename, outWidth, outHeight);
+			if (cached != nullptr)
+			{
+				delete[] inputBuffer;
+				return cached;
+			}
+		}
+
+		unsigned char *outputBuffer = UpscaleBuffer(type, inputBuffer, inWidth, inHeight, outWidth, outHeight);
+		if (outputBuffer != inputBuffer && cachename.IsNotEmpty())
+		{
+			WriteUpscaleCache(cachename, outputBuffer, outWidth, outHeight);
 		}
+		return outputBuffer;
 	}
 	return inputBuffer;
 }
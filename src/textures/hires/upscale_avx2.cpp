@@ -0,0 +1,226 @@
+/*
+** upscale_avx2.cpp
+** AVX2 row kernels for the scaleNx and hqNx upscalers
+**
+**---------------------------------------------------------------------------
+** Copyright 2018 The GZDoom development team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** This file needs to be compiled with AVX2 enabled. The kernels only get
+** used after CheckCPUID has confirmed that both CPU and OS support it.
+**
+*/
+
+#include <string.h>
+#include "upscale_simd.h"
+
+#if !defined(NO_SSE) && (defined(__AVX2__) || (defined(_MSC_VER) && !defined(__clang__)))
+
+#include <immintrin.h>
+#include "hqnx/common.h"
+
+//==========================================================================
+//
+// The table is 16M entries, so gathering does not make the lookups any
+// cheaper, but it overlaps eight cache misses at a time.
+//
+//==========================================================================
+
+static void ToYUV_AVX2(const uint32_t *src, uint32_t *yuv, int width)
+{
+	const __m256i rgbmask = _mm256_set1_epi32(MASK_RGB);
+	int i = 0;
+	for (; i + 8 <= width; i += 8)
+	{
+		__m256i index = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(src + i)), rgbmask);
+		_mm256_storeu_si256((__m256i*)(yuv + i), _mm256_i32gather_epi32((const int*)RGBtoYUV, index, 4));
+	}
+	for (; i < width; i++)
+	{
+		yuv[i] = rgb_to_yuv(src[i]);
+	}
+}
+
+static inline __m256i HQxDiffBit_AVX2(__m256i c, const uint32_t *neighbor, __m256i threshold, int bit)
+{
+	__m256i n = _mm256_loadu_si256((const __m256i*)neighbor);
+	__m256i d = _mm256_or_si256(_mm256_subs_epu8(c, n), _mm256_subs_epu8(n, c));
+	__m256i same = _mm256_cmpeq_epi32(_mm256_subs_epu8(d, threshold), _mm256_setzero_si256());
+	return _mm256_andnot_si256(same, _mm256_set1_epi32(bit));
+}
+
+static void HQxPatterns_AVX2(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint8_t *pattern, int width)
+{
+	const __m256i threshold = _mm256_set1_epi32(HQX_YUV_THRESHOLDS);
+	int i = 0;
+	for (; i + 8 <= width; i += 8)
+	{
+		__m256i c = _mm256_loadu_si256((const __m256i*)(cur + i));
+		__m256i bits = HQxDiffBit_AVX2(c, prev + i - 1, threshold, 1);
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, prev + i, threshold, 2));
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, prev + i + 1, threshold, 4));
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, cur + i - 1, threshold, 8));
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, cur + i + 1, threshold, 16));
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, next + i - 1, threshold, 32));
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, next + i, threshold, 64));
+		bits = _mm256_or_si256(bits, HQxDiffBit_AVX2(c, next + i + 1, threshold, 128));
+
+		// Packing works per 128 bit lane, each lane ends up with 4 patterns.
+		bits = _mm256_packs_epi32(bits, bits);
+		bits = _mm256_packus_epi16(bits, bits);
+		uint32_t packed[2] = { (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(bits)), (uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(bits, 1)) };
+		memcpy(pattern + i, packed, 8);
+	}
+	for (; i < width; i++)
+	{
+		pattern[i] = HQxPattern(prev, cur, next, i);
+	}
+}
+
+static inline __m256i Select_AVX2(__m256i mask, __m256i a, __m256i b)
+{
+	return _mm256_blendv_epi8(b, a, mask);
+}
+
+static void Scale2xRow_AVX2(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, int width)
+{
+	int i = 0;
+	for (; i + 8 <= width; i += 8)
+	{
+		__m256i U = _mm256_loadu_si256((const __m256i*)(prev + i));
+		__m256i L = _mm256_loadu_si256((const __m256i*)(cur + i - 1));
+		__m256i E = _mm256_loadu_si256((const __m256i*)(cur + i));
+		__m256i R = _mm256_loadu_si256((const __m256i*)(cur + i + 1));
+		__m256i D = _mm256_loadu_si256((const __m256i*)(next + i));
+
+		__m256i flat = _mm256_or_si256(_mm256_cmpeq_epi32(L, R), _mm256_cmpeq_epi32(U, D));
+		__m256i p00 = Select_AVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi32(U, L)), U, E);
+		__m256i p01 = Select_AVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi32(U, R)), U, E);
+		__m256i p10 = Select_AVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi32(L, D)), D, E);
+		__m256i p11 = Select_AVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi32(R, D)), D, E);
+
+		// Unpacking works per 128 bit lane, so the halves need to be swapped into place.
+		__m256i lo = _mm256_unpacklo_epi32(p00, p01);
+		__m256i hi = _mm256_unpackhi_epi32(p00, p01);
+		_mm256_storeu_si256((__m256i*)(out0 + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(out0 + 2 * i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+		lo = _mm256_unpacklo_epi32(p10, p11);
+		hi = _mm256_unpackhi_epi32(p10, p11);
+		_mm256_storeu_si256((__m256i*)(out1 + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(out1 + 2 * i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	for (; i < width; i++)
+	{
+		Scale2xPixel(prev, cur, next, out0, out1, i);
+	}
+}
+
+// Stores a0 b0 c0 a1 b1 c1 ... a7 b7 c7.
+static inline void StoreInterleaved3_AVX2(uint32_t *dest, __m256i a, __m256i b, __m256i c)
+{
+	// Same shuffles as the SSE2 version, once per 128 bit lane.
+	__m256 ab_lo = _mm256_castsi256_ps(_mm256_unpacklo_epi32(a, b));
+	__m256 ab_hi = _mm256_castsi256_ps(_mm256_unpackhi_epi32(a, b));
+	__m256 bc_lo = _mm256_castsi256_ps(_mm256_unpacklo_epi32(b, c));
+	__m256 bc_hi = _mm256_castsi256_ps(_mm256_unpackhi_epi32(b, c));
+	__m256 ca_lo = _mm256_castsi256_ps(_mm256_unpacklo_epi32(c, a));
+	__m256 ca_hi = _mm256_castsi256_ps(_mm256_unpackhi_epi32(c, a));
+	__m256i o0 = _mm256_castps_si256(_mm256_shuffle_ps(ab_lo, ca_lo, _MM_SHUFFLE(3, 0, 1, 0)));
+	__m256i o1 = _mm256_castps_si256(_mm256_shuffle_ps(bc_lo, ab_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	__m256i o2 = _mm256_castps_si256(_mm256_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 3, 0)));
+	_mm256_storeu_si256((__m256i*)dest, _mm256_permute2x128_si256(o0, o1, 0x20));
+	_mm256_storeu_si256((__m256i*)(dest + 8), _mm256_permute2x128_si256(o2, o0, 0x30));
+	_mm256_storeu_si256((__m256i*)(dest + 16), _mm256_permute2x128_si256(o1, o2, 0x31));
+}
+
+static void Scale3xRow_AVX2(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, uint32_t *out2, int width)
+{
+	int i = 0;
+	for (; i + 8 <= width; i += 8)
+	{
+		__m256i UL = _mm256_loadu_si256((const __m256i*)(prev + i - 1));
+		__m256i U = _mm256_loadu_si256((const __m256i*)(prev + i));
+		__m256i UR = _mm256_loadu_si256((const __m256i*)(prev + i + 1));
+		__m256i L = _mm256_loadu_si256((const __m256i*)(cur + i - 1));
+		__m256i E = _mm256_loadu_si256((const __m256i*)(cur + i));
+		__m256i R = _mm256_loadu_si256((const __m256i*)(cur + i + 1));
+		__m256i DL = _mm256_loadu_si256((const __m256i*)(next + i - 1));
+		__m256i D = _mm256_loadu_si256((const __m256i*)(next + i));
+		__m256i DR = _mm256_loadu_si256((const __m256i*)(next + i + 1));
+
+		__m256i flat = _mm256_or_si256(_mm256_cmpeq_epi32(L, R), _mm256_cmpeq_epi32(U, D));
+		__m256i UeqL = _mm256_andnot_si256(flat, _mm256_cmpeq_epi32(U, L));
+		__m256i UeqR = _mm256_andnot_si256(flat, _mm256_cmpeq_epi32(U, R));
+		__m256i LeqD = _mm256_andnot_si256(flat, _mm256_cmpeq_epi32(L, D));
+		__m256i ReqD = _mm256_andnot_si256(flat, _mm256_cmpeq_epi32(R, D));
+		__m256i EeqUL = _mm256_cmpeq_epi32(E, UL);
+		__m256i EeqUR = _mm256_cmpeq_epi32(E, UR);
+		__m256i EeqDL = _mm256_cmpeq_epi32(E, DL);
+		__m256i EeqDR = _mm256_cmpeq_epi32(E, DR);
+
+		__m256i p00 = Select_AVX2(UeqL, U, E);
+		__m256i p01 = Select_AVX2(_mm256_or_si256(_mm256_andnot_si256(EeqUR, UeqL), _mm256_andnot_si256(EeqUL, UeqR)), U, E);
+		__m256i p02 = Select_AVX2(UeqR, U, E);
+		__m256i p10 = Select_AVX2(_mm256_or_si256(_mm256_andnot_si256(EeqDL, UeqL), _mm256_andnot_si256(EeqUL, LeqD)), L, E);
+		__m256i p12 = Select_AVX2(_mm256_or_si256(_mm256_andnot_si256(EeqDR, UeqR), _mm256_andnot_si256(EeqUR, ReqD)), R, E);
+		__m256i p20 = Select_AVX2(LeqD, D, E);
+		__m256i p21 = Select_AVX2(_mm256_or_si256(_mm256_andnot_si256(EeqDR, LeqD), _mm256_andnot_si256(EeqDL, ReqD)), D, E);
+		__m256i p22 = Select_AVX2(ReqD, D, E);
+
+		StoreInterleaved3_AVX2(out0 + 3 * i, p00, p01, p02);
+		StoreInterleaved3_AVX2(out1 + 3 * i, p10, E, p12);
+		StoreInterleaved3_AVX2(out2 + 3 * i, p20, p21, p22);
+	}
+	for (; i < width; i++)
+	{
+		Scale3xPixel(prev, cur, next, out0, out1, out2, i);
+	}
+}
+
+static const FUpscaleKernels AVX2Kernels =
+{
+	"AVX2",
+	ToYUV_AVX2,
+	HQxPatterns_AVX2,
+	Scale2xRow_AVX2,
+	Scale3xRow_AVX2
+};
+
+const FUpscaleKernels *GetAVX2UpscaleKernels()
+{
+	return &AVX2Kernels;
+}
+
+#else
+
+// The compiler cannot generate AVX2 code for this file.
+const FUpscaleKernels *GetAVX2UpscaleKernels()
+{
+	return nullptr;
+}
+
+#endif
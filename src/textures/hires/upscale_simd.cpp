@@ -0,0 +1,358 @@
+/*
+** upscale_simd.cpp
+** Vectorized row kernels for the scaleNx and hqNx upscalers
+**
+**---------------------------------------------------------------------------
+** Copyright 2018 The GZDoom development team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The hqNx classification compares the YUV values of each pixel with its
+** eight neighbors. With the values packed as 0x00YYUUVV the comparison is
+** a per byte absolute difference followed by a saturating subtraction of
+** the thresholds: a pixel pair is different if any byte is left nonzero.
+**
+*/
+
+#include <string.h>
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
+#include "upscale_simd.h"
+#include "hqnx/common.h"
+#include "tarray.h"
+#include "x86.h"
+
+//==========================================================================
+//
+// Scalar kernels
+//
+//==========================================================================
+
+static void ToYUV_C(const uint32_t *src, uint32_t *yuv, int width)
+{
+	for (int i = 0; i < width; i++)
+	{
+		yuv[i] = rgb_to_yuv(src[i]);
+	}
+}
+
+static void HQxPatterns_C(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint8_t *pattern, int width)
+{
+	for (int i = 0; i < width; i++)
+	{
+		pattern[i] = HQxPattern(prev, cur, next, i);
+	}
+}
+
+static void Scale2xRow_C(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, int width)
+{
+	for (int i = 0; i < width; i++)
+	{
+		Scale2xPixel(prev, cur, next, out0, out1, i);
+	}
+}
+
+static void Scale3xRow_C(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, uint32_t *out2, int width)
+{
+	for (int i = 0; i < width; i++)
+	{
+		Scale3xPixel(prev, cur, next, out0, out1, out2, i);
+	}
+}
+
+static const FUpscaleKernels ScalarKernels =
+{
+	"scalar",
+	ToYUV_C,
+	HQxPatterns_C,
+	Scale2xRow_C,
+	Scale3xRow_C
+};
+
+#ifndef NO_SSE
+
+//==========================================================================
+//
+// SSE2 kernels
+//
+//==========================================================================
+
+static inline __m128i HQxDiffBit_SSE2(__m128i c, const uint32_t *neighbor, __m128i threshold, int bit)
+{
+	__m128i n = _mm_loadu_si128((const __m128i*)neighbor);
+	__m128i d = _mm_or_si128(_mm_subs_epu8(c, n), _mm_subs_epu8(n, c));
+	__m128i same = _mm_cmpeq_epi32(_mm_subs_epu8(d, threshold), _mm_setzero_si128());
+	return _mm_andnot_si128(same, _mm_set1_epi32(bit));
+}
+
+static void HQxPatterns_SSE2(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint8_t *pattern, int width)
+{
+	const __m128i threshold = _mm_set1_epi32(HQX_YUV_THRESHOLDS);
+	int i = 0;
+	for (; i + 4 <= width; i += 4)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)(cur + i));
+		__m128i bits = HQxDiffBit_SSE2(c, prev + i - 1, threshold, 1);
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, prev + i, threshold, 2));
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, prev + i + 1, threshold, 4));
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, cur + i - 1, threshold, 8));
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, cur + i + 1, threshold, 16));
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, next + i - 1, threshold, 32));
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, next + i, threshold, 64));
+		bits = _mm_or_si128(bits, HQxDiffBit_SSE2(c, next + i + 1, threshold, 128));
+
+		bits = _mm_packs_epi32(bits, bits);
+		bits = _mm_packus_epi16(bits, bits);
+		uint32_t packed = _mm_cvtsi128_si32(bits);
+		memcpy(pattern + i, &packed, 4);
+	}
+	for (; i < width; i++)
+	{
+		pattern[i] = HQxPattern(prev, cur, next, i);
+	}
+}
+
+static inline __m128i Select_SSE2(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void Scale2xRow_SSE2(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, int width)
+{
+	int i = 0;
+	for (; i + 4 <= width; i += 4)
+	{
+		__m128i U = _mm_loadu_si128((const __m128i*)(prev + i));
+		__m128i L = _mm_loadu_si128((const __m128i*)(cur + i - 1));
+		__m128i E = _mm_loadu_si128((const __m128i*)(cur + i));
+		__m128i R = _mm_loadu_si128((const __m128i*)(cur + i + 1));
+		__m128i D = _mm_loadu_si128((const __m128i*)(next + i));
+
+		// Lanes where either pair matches just copy E.
+		__m128i flat = _mm_or_si128(_mm_cmpeq_epi32(L, R), _mm_cmpeq_epi32(U, D));
+		__m128i p00 = Select_SSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi32(U, L)), U, E);
+		__m128i p01 = Select_SSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi32(U, R)), U, E);
+		__m128i p10 = Select_SSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi32(L, D)), D, E);
+		__m128i p11 = Select_SSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi32(R, D)), D, E);
+
+		_mm_storeu_si128((__m128i*)(out0 + 2 * i), _mm_unpacklo_epi32(p00, p01));
+		_mm_storeu_si128((__m128i*)(out0 + 2 * i + 4), _mm_unpackhi_epi32(p00, p01));
+		_mm_storeu_si128((__m128i*)(out1 + 2 * i), _mm_unpacklo_epi32(p10, p11));
+		_mm_storeu_si128((__m128i*)(out1 + 2 * i + 4), _mm_unpackhi_epi32(p10, p11));
+	}
+	for (; i < width; i++)
+	{
+		Scale2xPixel(prev, cur, next, out0, out1, i);
+	}
+}
+
+// Stores a0 b0 c0 a1 b1 c1 a2 b2 c2 a3 b3 c3.
+static inline void StoreInterleaved3_SSE2(uint32_t *dest, __m128i a, __m128i b, __m128i c)
+{
+	__m128 ab_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));	// a0 b0 a1 b1
+	__m128 ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));	// a2 b2 a3 b3
+	__m128 bc_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));	// b0 c0 b1 c1
+	__m128 bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));	// b2 c2 b3 c3
+	__m128 ca_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a));	// c0 a0 c1 a1
+	__m128 ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a));	// c2 a2 c3 a3
+	_mm_storeu_ps((float*)dest, _mm_shuffle_ps(ab_lo, ca_lo, _MM_SHUFFLE(3, 0, 1, 0)));
+	_mm_storeu_ps((float*)dest + 4, _mm_shuffle_ps(bc_lo, ab_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	_mm_storeu_ps((float*)dest + 8, _mm_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 3, 0)));
+}
+
+static void Scale3xRow_SSE2(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, uint32_t *out2, int width)
+{
+	int i = 0;
+	for (; i + 4 <= width; i += 4)
+	{
+		__m128i UL = _mm_loadu_si128((const __m128i*)(prev + i - 1));
+		__m128i U = _mm_loadu_si128((const __m128i*)(prev + i));
+		__m128i UR = _mm_loadu_si128((const __m128i*)(prev + i + 1));
+		__m128i L = _mm_loadu_si128((const __m128i*)(cur + i - 1));
+		__m128i E = _mm_loadu_si128((const __m128i*)(cur + i));
+		__m128i R = _mm_loadu_si128((const __m128i*)(cur + i + 1));
+		__m128i DL = _mm_loadu_si128((const __m128i*)(next + i - 1));
+		__m128i D = _mm_loadu_si128((const __m128i*)(next + i));
+		__m128i DR = _mm_loadu_si128((const __m128i*)(next + i + 1));
+
+		__m128i flat = _mm_or_si128(_mm_cmpeq_epi32(L, R), _mm_cmpeq_epi32(U, D));
+		__m128i UeqL = _mm_andnot_si128(flat, _mm_cmpeq_epi32(U, L));
+		__m128i UeqR = _mm_andnot_si128(flat, _mm_cmpeq_epi32(U, R));
+		__m128i LeqD = _mm_andnot_si128(flat, _mm_cmpeq_epi32(L, D));
+		__m128i ReqD = _mm_andnot_si128(flat, _mm_cmpeq_epi32(R, D));
+		__m128i EeqUL = _mm_cmpeq_epi32(E, UL);
+		__m128i EeqUR = _mm_cmpeq_epi32(E, UR);
+		__m128i EeqDL = _mm_cmpeq_epi32(E, DL);
+		__m128i EeqDR = _mm_cmpeq_epi32(E, DR);
+
+		__m128i p00 = Select_SSE2(UeqL, U, E);
+		__m128i p01 = Select_SSE2(_mm_or_si128(_mm_andnot_si128(EeqUR, UeqL), _mm_andnot_si128(EeqUL, UeqR)), U, E);
+		__m128i p02 = Select_SSE2(UeqR, U, E);
+		__m128i p10 = Select_SSE2(_mm_or_si128(_mm_andnot_si128(EeqDL, UeqL), _mm_andnot_si128(EeqUL, LeqD)), L, E);
+		__m128i p12 = Select_SSE2(_mm_or_si128(_mm_andnot_si128(EeqDR, UeqR), _mm_andnot_si128(EeqUR, ReqD)), R, E);
+		__m128i p20 = Select_SSE2(LeqD, D, E);
+		__m128i p21 = Select_SSE2(_mm_or_si128(_mm_andnot_si128(EeqDR, LeqD), _mm_andnot_si128(EeqDL, ReqD)), D, E);
+		__m128i p22 = Select_SSE2(ReqD, D, E);
+
+		StoreInterleaved3_SSE2(out0 + 3 * i, p00, p01, p02);
+		StoreInterleaved3_SSE2(out1 + 3 * i, p10, E, p12);
+		StoreInterleaved3_SSE2(out2 + 3 * i, p20, p21, p22);
+	}
+	for (; i < width; i++)
+	{
+		Scale3xPixel(prev, cur, next, out0, out1, out2, i);
+	}
+}
+
+static const FUpscaleKernels SSE2Kernels =
+{
+	"SSE2",
+	ToYUV_C,
+	HQxPatterns_SSE2,
+	Scale2xRow_SSE2,
+	Scale3xRow_SSE2
+};
+
+#endif
+
+//==========================================================================
+//
+// Kernel selection
+//
+// The list is ordered from slowest to fastest.
+//
+//==========================================================================
+
+static const FUpscaleKernels *ActiveKernels;
+
+int GetSupportedUpscaleKernels(const FUpscaleKernels **list, int max)
+{
+	int count = 0;
+	if (count < max) list[count++] = &ScalarKernels;
+#ifndef NO_SSE
+	if (CPU.bSSE2 && count < max) list[count++] = &SSE2Kernels;
+#endif
+	if (CPU.bAVX2 && GetAVX2UpscaleKernels() != nullptr && count < max) list[count++] = GetAVX2UpscaleKernels();
+	return count;
+}
+
+const FUpscaleKernels *GetUpscaleKernels()
+{
+	static const FUpscaleKernels *best = []()
+	{
+		const FUpscaleKernels *list[4];
+		return list[GetSupportedUpscaleKernels(list, 4) - 1];
+	}();
+	return ActiveKernels != nullptr ? ActiveKernels : best;
+}
+
+// Only meant for benchmarking, nullptr restores the automatic choice.
+void SetUpscaleKernels(const FUpscaleKernels *kernels)
+{
+	ActiveKernels = kernels;
+}
+
+//==========================================================================
+//
+// Copies the image into rows with one pixel of padding on either side.
+// Returns the pitch of the padded rows.
+//
+//==========================================================================
+
+static int PadRows(const uint32_t *src, int srcpitch, int width, int height, TArray<uint32_t> &rows, void (*convert)(const uint32_t *, uint32_t *, int))
+{
+	const int pitch = width + 2;
+	rows.Resize(pitch * height);
+	for (int y = 0; y < height; y++)
+	{
+		uint32_t *row = &rows[y * pitch + 1];
+		if (convert != nullptr) convert(src + y * srcpitch, row, width);
+		else memcpy(row, src + y * srcpitch, width * 4);
+		row[-1] = row[0];
+		row[width] = row[width - 1];
+	}
+	return pitch;
+}
+
+//==========================================================================
+//
+// Computes the neighbor pattern of every pixel for hqNx.
+//
+//==========================================================================
+
+void HQxComputePatterns(const uint32_t *src, int srcpitch, int width, int height, uint8_t *patterns)
+{
+	const FUpscaleKernels *kernels = GetUpscaleKernels();
+	TArray<uint32_t> yuv;
+	const int pitch = PadRows(src, srcpitch, width, height, yuv, kernels->ToYUV);
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint32_t *cur = &yuv[y * pitch + 1];
+		const uint32_t *prev = y > 0 ? cur - pitch : cur;
+		const uint32_t *next = y < height - 1 ? cur + pitch : cur;
+		kernels->HQxPatterns(prev, cur, next, patterns + y * width, width);
+	}
+}
+
+//==========================================================================
+//
+// Scale2x / Scale3x
+//
+//==========================================================================
+
+void Scale2x(const uint32_t *src, uint32_t *dest, int width, int height)
+{
+	const FUpscaleKernels *kernels = GetUpscaleKernels();
+	TArray<uint32_t> rows;
+	const int pitch = PadRows(src, width, width, height, rows, nullptr);
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint32_t *cur = &rows[y * pitch + 1];
+		const uint32_t *prev = y > 0 ? cur - pitch : cur;
+		const uint32_t *next = y < height - 1 ? cur + pitch : cur;
+		uint32_t *out0 = dest + 2 * y * 2 * width;
+		kernels->Scale2xRow(prev, cur, next, out0, out0 + 2 * width, width);
+	}
+}
+
+void Scale3x(const uint32_t *src, uint32_t *dest, int width, int height)
+{
+	const FUpscaleKernels *kernels = GetUpscaleKernels();
+	TArray<uint32_t> rows;
+	const int pitch = PadRows(src, width, width, height, rows, nullptr);
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint32_t *cur = &rows[y * pitch + 1];
+		const uint32_t *prev = y > 0 ? cur - pitch : cur;
+		const uint32_t *next = y < height - 1 ? cur + pitch : cur;
+		uint32_t *out0 = dest + 3 * y * 3 * width;
+		kernels->Scale3xRow(prev, cur, next, out0, out0 + 3 * width, out0 + 6 * width, width);
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//==========================================================================
+//
+// Row kernels for the scaleNx and hqNx upscalers
+//
+// All rows passed to the kernels have one replicated pixel of padding on
+// either side, i.e. row[-1] == row[0] and row[width] == row[width-1], and
+// the previous/next row of the top/bottom row is the row itself. This is
+// the same edge handling the scalar upscalers always used, so every
+// kernel produces exactly the same output as the original code.
+//
+//==========================================================================
+
+struct FUpscaleKernels
+{
+	const char *Name;
+
+	// Converts a row of ARGB pixels to the YUV values hqNx compares.
+	void (*ToYUV)(const uint32_t *src, uint32_t *yuv, int width);
+
+	// Computes the hqNx neighbor pattern of each pixel in a row of YUV values.
+	void (*HQxPatterns)(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint8_t *pattern, int width);
+
+	// Produces the 2 or 3 output rows for one input row.
+	void (*Scale2xRow)(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, int width);
+	void (*Scale3xRow)(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, uint32_t *out2, int width);
+};
+
+const FUpscaleKernels *GetUpscaleKernels();
+void SetUpscaleKernels(const FUpscaleKernels *kernels);
+int GetSupportedUpscaleKernels(const FUpscaleKernels **list, int max);
+const FUpscaleKernels *GetAVX2UpscaleKernels();
+
+void HQxComputePatterns(const uint32_t *src, int srcpitch, int width, int height, uint8_t *patterns);
+void Scale2x(const uint32_t *src, uint32_t *dest, int width, int height);
+void Scale3x(const uint32_t *src, uint32_t *dest, int width, int height);
+
+//==========================================================================
+//
+// Scalar versions of the per-pixel operations. The vector kernels use
+// these for the pixels left over at the end of a row.
+//
+//==========================================================================
+
+// Per byte thresholds for V, U and Y, as used by the vector kernels.
+// The top byte is not compared.
+enum { HQX_YUV_THRESHOLDS = 0xff300706 };
+
+static inline bool HQxYUVDiff(uint32_t yuv1, uint32_t yuv2)
+{
+	return abs((int)(yuv1 & 0xff0000) - (int)(yuv2 & 0xff0000)) > 0x300000 ||
+		abs((int)(yuv1 & 0xff00) - (int)(yuv2 & 0xff00)) > 0x700 ||
+		abs((int)(yuv1 & 0xff) - (int)(yuv2 & 0xff)) > 6;
+}
+
+static inline uint8_t HQxPattern(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, int i)
+{
+	const uint32_t c = cur[i];
+	return uint8_t(
+		(HQxYUVDiff(c, prev[i - 1]) ? 1 : 0) |
+		(HQxYUVDiff(c, prev[i]) ? 2 : 0) |
+		(HQxYUVDiff(c, prev[i + 1]) ? 4 : 0) |
+		(HQxYUVDiff(c, cur[i - 1]) ? 8 : 0) |
+		(HQxYUVDiff(c, cur[i + 1]) ? 16 : 0) |
+		(HQxYUVDiff(c, next[i - 1]) ? 32 : 0) |
+		(HQxYUVDiff(c, next[i]) ? 64 : 0) |
+		(HQxYUVDiff(c, next[i + 1]) ? 128 : 0));
+}
+
+static inline void Scale2xPixel(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, int i)
+{
+	const uint32_t U = prev[i], L = cur[i - 1], E = cur[i], R = cur[i + 1], D = next[i];
+	if (L != R && U != D)
+	{
+		out0[2 * i] = U == L ? U : E;
+		out0[2 * i + 1] = U == R ? U : E;
+		out1[2 * i] = L == D ? D : E;
+		out1[2 * i + 1] = R == D ? D : E;
+	}
+	else
+	{
+		out0[2 * i] = out0[2 * i + 1] = out1[2 * i] = out1[2 * i + 1] = E;
+	}
+}
+
+static inline void Scale3xPixel(const uint32_t *prev, const uint32_t *cur, const uint32_t *next, uint32_t *out0, uint32_t *out1, uint32_t *out2, int i)
+{
+	const uint32_t UL = prev[i - 1], U = prev[i], UR = prev[i + 1];
+	const uint32_t L = cur[i - 1], E = cur[i], R = cur[i + 1];
+	const uint32_t DL = next[i - 1], D = next[i], DR = next[i + 1];
+	if (L != R && U != D)
+	{
+		out0[3 * i] = U == L ? U : E;
+		out0[3 * i + 1] = (U == L && E != UR) || (U == R && E != UL) ? U : E;
+		out0[3 * i + 2] = U == R ? U : E;
+		out1[3 * i] = (U == L && E != DL) || (L == D && E != UL) ? L : E;
+		out1[3 * i + 1] = E;
+		out1[3 * i + 2] = (U == R && E != DR) || (R == D && E != UR) ? R : E;
+		out2[3 * i] = L == D ? D : E;
+		out2[3 * i + 1] = (L == D && E != DR) || (R == D && E != DL) ? D : E;
+		out2[3 * i + 2] = R == D ? D : E;
+	}
+	else
+	{
+		out0[3 * i] = out0[3 * i + 1] = out0[3 * i + 2] = E;
+		out1[3 * i] = out1[3 * i + 1] = out1[3 * i + 2] = E;
+		out2[3 * i] = out2[3 * i + 1] = out2[3 * i + 2] = E;
+	}
+}
@@ -0,0 +1,305 @@
+/*
+** mipmaps.cpp
+** Mipmap generation for the true color software renderer
+**
+**---------------------------------------------------------------------------
+** Copyright 2018 The GZDoom development team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** All the float math is done one channel per lane in the same order as
+** the original per channel code, so the SSE2 and the scalar version give
+** identical results. The pow() calls of the gamma conversion are replaced
+** by tables built from the very same expressions: 8 bit values go through
+** a 256 entry table, and converting back counts how many of the 255
+** thresholds between two output values a float is above.
+**
+*/
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
+
+#include "doomtype.h"
+#include "templates.h"
+#include "v_palette.h"
+#include "x86.h"
+#include "textures/mipmaps.h"
+
+//==========================================================================
+//
+// Gamma conversion tables
+//
+//==========================================================================
+
+struct FMipmapGammaTables
+{
+	enum
+	{
+		// The thresholds are located with the help of a table indexed by
+		// the exponent and the top 7 mantissa bits of the value. Below
+		// 2^-24 everything converts to 0, from 2.0 on everything is 255.
+		LowBits = 0x33800000,		// 2^-24
+		HighBits = 0x40000000,		// 2.0
+		BucketShift = 16,
+		NumBuckets = (HighBits - LowBits) >> BucketShift,
+	};
+
+	float ToLinear[256];
+	float Thresholds[256];			// smallest value converting to n or more
+	uint8_t Buckets[NumBuckets];	// result for the smallest value in the bucket
+
+	static uint32_t FloatBits(float f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &f, 4);
+		return bits;
+	}
+
+	static float BitsFloat(uint32_t bits)
+	{
+		float f;
+		memcpy(&f, &bits, 4);
+		return f;
+	}
+
+	static uint32_t ToGamma(float v)
+	{
+		return (uint32_t)clamp(powf(MAX(v, 0.0f), 1.0f / 2.2f) * 255.0f + 0.5f, 0.0f, 255.0f);
+	}
+
+	FMipmapGammaTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			ToLinear[i] = powf(i * (1.0f / 255.0f), 2.2f);
+		}
+
+		// Non-negative floats sort the same as their bit patterns.
+		Thresholds[0] = 0.0f;
+		for (uint32_t n = 1; n < 256; n++)
+		{
+			uint32_t lo = 0, hi = HighBits;
+			while (lo < hi)
+			{
+				uint32_t mid = lo + (hi - lo) / 2;
+				if (ToGamma(BitsFloat(mid)) >= n) hi = mid;
+				else lo = mid + 1;
+			}
+			Thresholds[n] = BitsFloat(lo);
+		}
+
+		for (int i = 0; i < NumBuckets; i++)
+		{
+			Buckets[i] = (uint8_t)ToGamma(BitsFloat(LowBits + (i << BucketShift)));
+		}
+	}
+
+	uint32_t ToSRGB(float v) const
+	{
+		uint32_t bits = FloatBits(v);
+		uint32_t n;
+		if ((int32_t)bits < LowBits) n = 0;		// also anything negative
+		else if (bits >= HighBits) return bits <= 0x7f800000 ? 255 : 0;
+		else n = Buckets[(bits - LowBits) >> BucketShift];
+
+		while (n < 255 && v >= Thresholds[n + 1]) n++;
+		return n;
+	}
+};
+
+static const FMipmapGammaTables &GetGammaTables()
+{
+	static const FMipmapGammaTables tables;
+	return tables;
+}
+
+//==========================================================================
+//
+// Four float channels in the order a, r, g, b
+//
+//==========================================================================
+
+struct FColor4f
+{
+	float a, r, g, b;
+
+	static FColor4f Zero() { return { 0.0f, 0.0f, 0.0f, 0.0f }; }
+	static FColor4f Load(const float *p) { return { p[0], p[1], p[2], p[3] }; }
+	void Store(float *p) const { p[0] = a; p[1] = r; p[2] = g; p[3] = b; }
+
+	static FColor4f FromBgra(const FMipmapGammaTables &tables, uint32_t c8)
+	{
+		return { tables.ToLinear[APART(c8)], tables.ToLinear[RPART(c8)], tables.ToLinear[GPART(c8)], tables.ToLinear[BPART(c8)] };
+	}
+
+	FColor4f operator+(const FColor4f &v) const { return { a + v.a, r + v.r, g + v.g, b + v.b }; }
+	FColor4f operator-(const FColor4f &v) const { return { a - v.a, r - v.r, g - v.g, b - v.b }; }
+	FColor4f operator*(float s) const { return { a * s, r * s, g * s, b * s }; }
+};
+
+#ifndef NO_SSE
+struct FColor4fSSE2
+{
+	__m128 v;
+
+	static FColor4fSSE2 Zero() { return { _mm_setzero_ps() }; }
+	static FColor4fSSE2 Load(const float *p) { return { _mm_loadu_ps(p) }; }
+	void Store(float *p) const { _mm_storeu_ps(p, v); }
+
+	static FColor4fSSE2 FromBgra(const FMipmapGammaTables &tables, uint32_t c8)
+	{
+		return { _mm_setr_ps(tables.ToLinear[APART(c8)], tables.ToLinear[RPART(c8)], tables.ToLinear[GPART(c8)], tables.ToLinear[BPART(c8)]) };
+	}
+
+	FColor4fSSE2 operator+(const FColor4fSSE2 &o) const { return { _mm_add_ps(v, o.v) }; }
+	FColor4fSSE2 operator-(const FColor4fSSE2 &o) const { return { _mm_sub_ps(v, o.v) }; }
+	FColor4fSSE2 operator*(float s) const { return { _mm_mul_ps(v, _mm_set1_ps(s)) }; }
+};
+#endif
+
+//==========================================================================
+//
+// The 2x2 box filter. Note that the second sample is two texels away,
+// not one. That is what the renderer has always used.
+//
+//==========================================================================
+
+template<typename Color, typename Fetch>
+static void Downscale(Fetch fetch, int srcw, int srch, float *dest, int w, int h)
+{
+	for (int x = 0; x < w; x++)
+	{
+		int sx0 = x * 2;
+		int sx1 = MIN((x + 1) * 2, srcw - 1);
+		for (int y = 0; y < h; y++)
+		{
+			int sy0 = y * 2;
+			int sy1 = MIN((y + 1) * 2, srch - 1);
+
+			Color src00 = fetch(sy0 + sx0 * srch);
+			Color src01 = fetch(sy1 + sx0 * srch);
+			Color src10 = fetch(sy0 + sx1 * srch);
+			Color src11 = fetch(sy1 + sx1 * srch);
+			((src00 + src01 + src10 + src11) * 0.25f).Store(dest + (y + x * h) * 4);
+		}
+	}
+}
+
+//==========================================================================
+//
+// Sharpens the level by subtracting a wrapping 3x3 box blur of it.
+//
+//==========================================================================
+
+template<typename Color>
+static void Sharpen(float *level, float *smoothed, int w, int h)
+{
+	for (int x = 0; x < w; x++)
+	{
+		const int cols[3] = { (x == 0 ? w - 1 : x - 1) * h, x * h, (x + 1 == w ? 0 : x + 1) * h };
+		for (int y = 0; y < h; y++)
+		{
+			const int rows[3] = { y == 0 ? h - 1 : y - 1, y, y + 1 == h ? 0 : y + 1 };
+			Color c = Color::Zero();
+			for (int kx = 0; kx < 3; kx++)
+			{
+				for (int ky = 0; ky < 3; ky++)
+				{
+					c = c + Color::Load(level + (rows[ky] + cols[kx]) * 4);
+				}
+			}
+			(c * (1.0f / 9.0f)).Store(smoothed + (y + x * h) * 4);
+		}
+	}
+
+	const float k = 0.08f;
+	for (int j = 0; j < w * h * 4; j += 4)
+	{
+		Color c = Color::Load(level + j);
+		(c + (c - Color::Load(smoothed + j)) * k).Store(level + j);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+template<typename Color>
+static void GenerateChain(uint32_t *pixels, int width, int height, int levels)
+{
+	const FMipmapGammaTables &tables = GetGammaTables();
+	if (levels < 2) return;
+
+	const int size1 = MAX(width >> 1, 1) * MAX(height >> 1, 1) * 4;
+	std::vector<float> src(size1), dest(size1), smoothed(size1);
+
+	uint32_t *out = pixels + width * height;
+	for (int i = 1; i < levels; i++)
+	{
+		int srcw = MAX(width >> (i - 1), 1);
+		int srch = MAX(height >> (i - 1), 1);
+		int w = MAX(width >> i, 1);
+		int h = MAX(height >> i, 1);
+
+		// The first level is taken straight from the 8 bit base level.
+		if (i == 1)
+		{
+			Downscale<Color>([&](int index) { return Color::FromBgra(tables, pixels[index]); }, srcw, srch, dest.data(), w, h);
+		}
+		else
+		{
+			const float *s = src.data();
+			Downscale<Color>([=](int index) { return Color::Load(s + index * 4); }, srcw, srch, dest.data(), w, h);
+		}
+		Sharpen<Color>(dest.data(), smoothed.data(), w, h);
+
+		const float *c = dest.data();
+		for (int j = 0; j < w * h; j++, c += 4)
+		{
+			out[j] = (tables.ToSRGB(c[0]) << 24) | (tables.ToSRGB(c[1]) << 16) | (tables.ToSRGB(c[2]) << 8) | tables.ToSRGB(c[3]);
+		}
+		out += w * h;
+		std::swap(src, dest);
+	}
+}
+
+void GenerateBgraMipmapChain(uint32_t *pixels, int width, int height, int levels)
+{
+#ifndef NO_SSE
+	if (CPU.bSSE2)
+	{
+		GenerateChain<FColor4fSSE2>(pixels, width, height, levels);
+		return;
+	}
+#endif
+	GenerateChain<FColor4f>(pixels, width, height, levels);
+}
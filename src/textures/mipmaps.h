@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+//==========================================================================
+//
+// Builds the mipmap levels the true color software renderer samples.
+//
+// pixels holds the base level followed by room for the other levels, all
+// stored column major like FTexture::PixelsBgra. Each level is averaged in
+// linear space, sharpened and converted back to 8 bit sRGB.
+//
+//==========================================================================
+
+void GenerateBgraMipmapChain(uint32_t *pixels, int width, int height, int levels);
@@ -34,6 +34,7 @@
 **
 */
 
+#include <mutex>
 #include "doomtype.h"
 #include "files.h"
 #include "w_wad.h"
@@ -46,6 +47,7 @@
 #include "v_video.h"
 #include "m_fixed.h"
 #include "textures/warpbuffer.h"
+#include "textures/mipmaps.h"
 #include "hwrenderer/textures/hw_material.h"
 #include "hwrenderer/textures/hw_ihwtexture.h"
 
@@ -226,12 +228,13 @@ FTexture::~FTexture ()
 		if (SystemTexture[i] != nullptr) delete SystemTexture[i];
 		SystemTexture[i] = nullptr;
 	}
-
+	FreePrecacheBuffers();
 }
 
 void FTexture::Unload()
 {
 	PixelsBgra = std::vector<uint32_t>();
+	BgraMipmapsPending = false;
 }
 
 //==========================================================================
@@ -267,6 +270,31 @@ const uint32_t *FTexture::GetPixelsBgra()
 	return PixelsBgra.data();
 }
 
+//==========================================================================
+//
+// Same as GetPixelsBgra, but with all mipmap levels filled in. Walls and
+// sprites call this when they need a level other than the base level,
+// which may happen on any of the scene threads.
+//
+//==========================================================================
+
+static std::mutex MipmapMutex;
+
+const uint32_t *FTexture::GetPixelsBgraWithMipmaps()
+{
+	const uint32_t *pixels = GetPixelsBgra();
+	if (pixels != nullptr && BgraMipmapsPending)
+	{
+		std::lock_guard<std::mutex> lock(MipmapMutex);
+		if (BgraMipmapsPending)
+		{
+			GenerateBgraMipmaps();
+			BgraMipmapsPending = false;
+		}
+	}
+	return pixels;
+}
+
 //==========================================================================
 //
 // 
@@ -447,7 +475,8 @@ void FTexture::GenerateBgraFromBitmap(const FBitmap &bitmap)
 		}
 	}
 
-	GenerateBgraMipmaps();
+	// The mipmap levels only get generated once something needs them.
+	BgraMipmapsPending = true;
 }
 
 void FTexture::CreatePixelsBgraWithMipmaps()
@@ -482,123 +511,7 @@ int FTexture::MipmapLevels() const
 
 void FTexture::GenerateBgraMipmaps()
 {
-	struct Color4f
-	{
-		float a, r, g, b;
-		Color4f operator*(const Color4f &v) const { return Color4f{ a * v.a, r * v.r, g * v.g, b * v.b }; }
-		Color4f operator/(const Color4f &v) const { return Color4f{ a / v.a, r / v.r, g / v.g, b / v.b }; }
-		Color4f operator+(const Color4f &v) const { return Color4f{ a + v.a, r + v.r, g + v.g, b + v.b }; }
-		Color4f operator-(const Color4f &v) const { return Color4f{ a - v.a, r - v.r, g - v.g, b - v.b }; }
-		Color4f operator*(float s) const { return Color4f{ a * s, r * s, g * s, b * s }; }
-		Color4f operator/(float s) const { return Color4f{ a / s, r / s, g / s, b / s }; }
-		Color4f operator+(float s) const { return Color4f{ a + s, r + s, g + s, b + s }; }
-		Color4f operator-(float s) const { return Color4f{ a - s, r - s, g - s, b - s }; }
-	};
-
-	int levels = MipmapLevels();
-	std::vector<Color4f> image(PixelsBgra.size());
-
-	// Convert to normalized linear colorspace
-	{
-		for (int x = 0; x < Width; x++)
-		{
-			for (int y = 0; y < Height; y++)
-			{
-				uint32_t c8 = PixelsBgra[x * Height + y];
-				Color4f c;
-				c.a = powf(APART(c8) * (1.0f / 255.0f), 2.2f);
-				c.r = powf(RPART(c8) * (1.0f / 255.0f), 2.2f);
-				c.g = powf(GPART(c8) * (1.0f / 255.0f), 2.2f);
-				c.b = powf(BPART(c8) * (1.0f / 255.0f), 2.2f);
-				image[x * Height + y] = c;
-			}
-		}
-	}
-
-	// Generate mipmaps
-	{
-		std::vector<Color4f> smoothed(Width * Height);
-		Color4f *src = image.data();
-		Color4f *dest = src + Width * Height;
-		for (int i = 1; i < levels; i++)
-		{
-			int srcw = MAX(Width >> (i - 1), 1);
-			int srch = MAX(Height >> (i - 1), 1);
-			int w = MAX(Width >> i, 1);
-			int h = MAX(Height >> i, 1);
-
-			// Downscale
-			for (int x = 0; x < w; x++)
-			{
-				int sx0 = x * 2;
-				int sx1 = MIN((x + 1) * 2, srcw - 1);
-				for (int y = 0; y < h; y++)
-				{
-					int sy0 = y * 2;
-					int sy1 = MIN((y + 1) * 2, srch - 1);
-
-					Color4f src00 = src[sy0 + sx0 * srch];
-					Color4f src01 = src[sy1 + sx0 * srch];
-					Color4f src10 = src[sy0 + sx1 * srch];
-					Color4f src11 = src[sy1 + sx1 * srch];
-					Color4f c = (src00 + src01 + src10 + src11) * 0.25f;
-
-					dest[y + x * h] = c;
-				}
-			}
-
-			// Sharpen filter with a 3x3 kernel:
-			for (int x = 0; x < w; x++)
-			{
-				for (int y = 0; y < h; y++)
-				{
-					Color4f c = { 0.0f, 0.0f, 0.0f, 0.0f };
-					for (int kx = -1; kx < 2; kx++)
-					{
-						for (int ky = -1; ky < 2; ky++)
-						{
-							int a = y + ky;
-							int b = x + kx;
-							if (a < 0) a = h - 1;
-							if (a == h) a = 0;
-							if (b < 0) b = w - 1;
-							if (b == w) b = 0;
-							c = c + dest[a + b * h];
-						}
-					}
-					c = c * (1.0f / 9.0f);
-					smoothed[y + x * h] = c;
-				}
-			}
-			float k = 0.08f;
-			for (int j = 0; j < w * h; j++)
-				dest[j] = dest[j] + (dest[j] - smoothed[j]) * k;
-
-			src = dest;
-			dest += w * h;
-		}
-	}
-
-	// Convert to bgra8 sRGB colorspace
-	{
-		Color4f *src = image.data() + Width * Height;
-		uint32_t *dest = PixelsBgra.data() + Width * Height;
-		for (int i = 1; i < levels; i++)
-		{
-			int w = MAX(Width >> i, 1);
-			int h = MAX(Height >> i, 1);
-			for (int j = 0; j < w * h; j++)
-			{
-				uint32_t a = (uint32_t)clamp(powf(MAX(src[j].a, 0.0f), 1.0f / 2.2f) * 255.0f + 0.5f, 0.0f, 255.0f);
-				uint32_t r = (uint32_t)clamp(powf(MAX(src[j].r, 0.0f), 1.0f / 2.2f) * 255.0f + 0.5f, 0.0f, 255.0f);
-				uint32_t g = (uint32_t)clamp(powf(MAX(src[j].g, 0.0f), 1.0f / 2.2f) * 255.0f + 0.5f, 0.0f, 255.0f);
-				uint32_t b = (uint32_t)clamp(powf(MAX(src[j].b, 0.0f), 1.0f / 2.2f) * 255.0f + 0.5f, 0.0f, 255.0f);
-				dest[j] = (a << 24) | (r << 16) | (g << 8) | b;
-			}
-			src += w * h;
-			dest += w * h;
-		}
-	}
+	GenerateBgraMipmapChain(PixelsBgra.data(), Width, Height, MipmapLevels());
 }
 
 //==========================================================================
@@ -875,18 +788,28 @@ void FTexture::FillBuffer(uint8_t *buff, int pitch, int height, FTextureFormat f
 //
 //===========================================================================
 
+// The precache pipeline composes textures on worker threads, which may
+// share patches whose pixels get created on first use. Each texture has
+// its own lock so workers only wait on each other for the same patch.
+const uint8_t *FTexture::GetPixelsLocked()
+{
+	std::lock_guard<std::mutex> lock(PixelsMutex);
+	return GetPixels(DefaultRenderStyle());
+}
+
 int FTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf)
 {
-	PalEntry *palette = screen->GetPalette();
+	// Work on a copy so that this does not alter the shared palette.
+	PalEntry palette[256];
+	memcpy(palette, screen->GetPalette(), sizeof(palette));
 	for(int i=1;i<256;i++) palette[i].a = 255;	// set proper alpha values
-	bmp->CopyPixelData(x, y, GetPixels(DefaultRenderStyle()), Width, Height, Height, 1, rotate, palette, inf);
-	for(int i=1;i<256;i++) palette[i].a = 0;
+	bmp->CopyPixelData(x, y, GetPixelsLocked(), Width, Height, Height, 1, rotate, palette, inf);
 	return 0;
 }
 
 int FTexture::CopyTrueColorTranslated(FBitmap *bmp, int x, int y, int rotate, PalEntry *remap, FCopyInfo *inf)
 {
-	bmp->CopyPixelData(x, y, GetPixels(DefaultRenderStyle()), Width, Height, Height, 1, rotate, remap, inf);
+	bmp->CopyPixelData(x, y, GetPixelsLocked(), Width, Height, Height, 1, rotate, remap, inf);
 	return 0;
 }
 
@@ -1370,6 +1293,18 @@ unsigned char * FTexture::CreateTexBuffer(int translation, int & w, int & h, int
 	int W, H;
 	int isTransparent = -1;
 
+	// CTF_MaybeWarped does nothing for textures that can get precached.
+	for (auto &pb : PrecacheBuffers)
+	{
+		if (pb.Buffer != nullptr && pb.Translation == translation && pb.Flags == (flags & ~CTF_MaybeWarped))
+		{
+			buffer = pb.Buffer;
+			w = pb.Width;
+			h = pb.Height;
+			pb.Buffer = nullptr;
+			return buffer;
+		}
+	}
 
 	if ((flags & CTF_CheckHires) && translation != STRange_AlphaTexture)
 	{
@@ -1454,6 +1389,65 @@ unsigned char * FTexture::CreateTexBuffer(int translation, int & w, int & h, int
 	return buffer;
 }
 
+//===========================================================================
+// 
+// Queues a CreateTexBuffer call for BuildPrecacheBuffers. Returns true
+// for the texture's first request, so that the caller can schedule it.
+//
+//===========================================================================
+
+bool FTexture::RequestPrecacheBuffer(int translation, int flags)
+{
+	if (bHasCanvas || bWarped) return false;
+
+	for (auto &pb : PrecacheBuffers)
+	{
+		if (pb.Translation == translation && pb.Flags == flags) return false;
+	}
+	if ((flags & CTF_CheckHires) && translation != STRange_AlphaTexture)
+	{
+		ResolveHiresTexture();
+	}
+	FPrecacheBuffer pb = { translation, flags, 0, 0, nullptr };
+	PrecacheBuffers.Push(pb);
+	return PrecacheBuffers.Size() == 1;
+}
+
+//===========================================================================
+// 
+// Builds all requested buffers. This is safe to run on a worker thread,
+// as long as no other thread uses this texture and lumps are read
+// through the lump cache.
+//
+//===========================================================================
+
+void FTexture::BuildPrecacheBuffers()
+{
+	for (auto &pb : PrecacheBuffers)
+	{
+		int w = 0, h = 0;
+		unsigned char *buffer = CreateTexBuffer(pb.Translation, w, h, pb.Flags);
+		pb.Width = w;
+		pb.Height = h;
+		pb.Buffer = buffer;
+	}
+}
+
+//===========================================================================
+// 
+// Frees all buffers CreateTexBuffer did not pick up.
+//
+//===========================================================================
+
+void FTexture::FreePrecacheBuffers()
+{
+	for (auto &pb : PrecacheBuffers)
+	{
+		delete[] pb.Buffer;
+	}
+	PrecacheBuffers.Clear();
+}
+
 //===========================================================================
 // 
 // Dummy texture for the 0-entry.
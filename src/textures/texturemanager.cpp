@@ -52,6 +52,7 @@
 #include "r_renderer.h"
 #include "r_sky.h"
 #include "vm.h"
+#include "d_profile.h"
 
 FTextureManager TexMan;
 
@@ -1019,12 +1020,15 @@ void FTextureManager::Init()
 	int wadcnt = Wads.GetNumWads();
 	for(int i = 0; i< wadcnt; i++)
 	{
+		FProfileScope wadscope("AddTexturesForWad", "startup", Wads.GetWadFullName(i));
 		AddTexturesForWad(i);
 	}
+	FProfileScope phase("ResolvePatches");
 	for (unsigned i = 0; i < Textures.Size(); i++)
 	{
 		Textures[i].Texture->ResolvePatches();
 	}
+	phase.End();
 
 	// Add one marker so that the last WAD is easier to handle and treat
 	// Build tiles as a completely separate block.
@@ -1061,12 +1065,15 @@ void FTextureManager::Init()
 		}
 	}
 
+	phase.Next("InitAnimated");
 	InitAnimated();
 	InitAnimDefs();
 	FixAnimations();
 	InitSwitchList();
+	phase.Next("InitPalettedVersions");
 	InitPalettedVersions();
 	AdjustSpriteOffsets();
+	phase.End();
 	// Add auto materials to each texture after everything has been set up.
 	// Textures array can be reallocated in process, so ranged for loop is not suitable.
 	// There is no need to process discovered material textures here,
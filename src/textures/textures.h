@@ -43,6 +43,8 @@
 #include "r_data/renderstyle.h"
 #include "r_data/r_translate.h"
 #include <vector>
+#include <atomic>
+#include <mutex>
 
 typedef TMap<int, bool> SpriteHits;
 
@@ -304,6 +306,9 @@ public:
 	// Returns the whole texture, stored in column-major order, in BGRA8 format
 	virtual const uint32_t *GetPixelsBgra();
 
+	// Same, but also makes sure the mipmap levels after the texture have been generated
+	const uint32_t *GetPixelsBgraWithMipmaps();
+
 	// Returns true if GetPixelsBgra includes mipmaps
 	virtual bool Mipmapped() { return true; }
 
@@ -453,10 +458,14 @@ protected:
 	}
 
 	std::vector<uint32_t> PixelsBgra;
+	std::atomic<bool> BgraMipmapsPending { false };
+	std::mutex PixelsMutex;
+
+	const uint8_t *GetPixelsLocked();
 
 	void GenerateBgraFromBitmap(const FBitmap &bitmap);
 	void CreatePixelsBgraWithMipmaps();
-	void GenerateBgraMipmaps();
+	virtual void GenerateBgraMipmaps();
 	void GenerateBgraMipmapsFast();
 	int MipmapLevels() const;
 
@@ -465,9 +474,25 @@ public:
 	unsigned char * CreateTexBuffer(int translation, int & w, int & h, int flags = 0);
 	bool GetTranslucency();
 
+	// For the precache pipeline: Buffers get requested on the main thread, built
+	// on a worker thread and then picked up by CreateTexBuffer on the main thread.
+	bool RequestPrecacheBuffer(int translation, int flags);
+	void BuildPrecacheBuffers();
+	void FreePrecacheBuffers();
+
 private:
+	struct FPrecacheBuffer
+	{
+		int Translation;
+		int Flags;
+		int Width, Height;
+		unsigned char *Buffer;
+	};
+	TArray<FPrecacheBuffer> PrecacheBuffers;
+
 	int CheckDDPK3();
 	int CheckExternalFile(bool & hascolorkey);
+	void ResolveHiresTexture();
 	unsigned char *LoadHiresTexture(int *width, int *height);
 
 	bool bSWSkyColorDone = false;
@@ -728,6 +753,7 @@ public:
 
 	virtual int CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate=0, FCopyInfo *inf = NULL) override;
 	virtual int CopyTrueColorTranslated(FBitmap *bmp, int x, int y, int rotate, PalEntry *remap, FCopyInfo *inf = NULL) override;
+	const uint8_t *GetPixels(FRenderStyle style) override;
 	const uint32_t *GetPixelsBgra() override;
 	bool CheckModified (FRenderStyle) override;
 
@@ -743,6 +769,8 @@ protected:
 	FTexture *SourcePic;
 
 	uint8_t *MakeTexture (FRenderStyle style) override;
+	void GenerateBgraMipmaps() override;
+	void Warp(uint8_t *Pixels, FRenderStyle style);
 	int NextPo2 (int v); // [mxd]
 	void SetupMultipliers (int width, int height); // [mxd]
 };
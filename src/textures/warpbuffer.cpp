@@ -0,0 +1,293 @@
+/*
+** warpbuffer.cpp
+** Texture warping for the software renderer and legacy hardware
+**
+**---------------------------------------------------------------------------
+** Copyright 2005-2016 Randy Heit
+** Copyright 2005-2016 Christoph Oelckers et.al.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Both warp types boil down to picking one source texel per destination
+** texel, so the work is split into computing a table of source indices,
+** which is vectorized, and a plain gather done by WarpBuffer.
+**
+*/
+
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
+#include "textures/warpbuffer.h"
+#include "templates.h"
+#include "x86.h"
+
+//==========================================================================
+//
+// The original code, still used for textures too small for the single
+// wraparound the faster code relies on.
+//
+//==========================================================================
+
+template<class TYPE> 
+static void WarpBufferC(TYPE *Pixels, const TYPE *source, int width, int height, int xmul, int ymul, uint64_t time, float Speed, int warptype)
+{
+	int ymask = height - 1;
+	int x, y;
+
+	if (warptype == 1)
+	{
+		TYPE *buffer = (TYPE *)alloca(sizeof(TYPE) * MAX(width, height));
+		// [mxd] Rewrote to fix animation for NPo2 textures
+		unsigned timebase = unsigned(time * Speed * 32 / 28);
+		for (y = height - 1; y >= 0; y--)
+		{
+			int xf = (TexMan.sintable[((timebase + y*ymul) >> 2)&TexMan.SINMASK] >> 11) % width;
+			if (xf < 0) xf += width;
+			int xt = xf;
+			const TYPE *sourcep = source + y;
+			TYPE *dest = Pixels + y;
+			for (xt = width; xt; xt--, xf = (xf + 1) % width, dest += height)
+				*dest = sourcep[xf + ymask * xf];
+		}
+		timebase = unsigned(time * Speed * 23 / 28);
+		for (x = width - 1; x >= 0; x--)
+		{
+			int yf = (TexMan.sintable[((time + (x + 17)*xmul) >> 2)&TexMan.SINMASK] >> 11) % height;
+			if (yf < 0) yf += height;
+			int yt = yf;
+			const TYPE *sourcep = Pixels + (x + ymask * x);
+			TYPE *dest = buffer;
+			for (yt = height; yt; yt--, yf = (yf + 1) % height)
+				*dest++ = sourcep[yf];
+			memcpy(Pixels + (x + ymask*x), buffer, height * sizeof(TYPE));
+		}
+	}
+	else if (warptype == 2)
+	{
+		unsigned timebase = unsigned(time * Speed * 40 / 28);
+		// [mxd] Rewrote to fix animation for NPo2 textures
+		for (x = 0; x < width; x++)
+		{
+			TYPE *dest = Pixels + (x + ymask * x);
+			for (y = 0; y < height; y++)
+			{
+				int xt = (x + 128
+					+ ((TexMan.sintable[((y*ymul + timebase * 5 + 900) >> 2) & TexMan.SINMASK]) >> 13)
+					+ ((TexMan.sintable[((x*xmul + timebase * 4 + 300) >> 2) & TexMan.SINMASK]) >> 13)) % width;
+
+				int yt = (y + 128
+					+ ((TexMan.sintable[((y*ymul + timebase * 3 + 700) >> 2) & TexMan.SINMASK]) >> 13)
+					+ ((TexMan.sintable[((x*xmul + timebase * 4 + 1200) >> 2) & TexMan.SINMASK]) >> 13)) % height;
+
+				*dest++ = source[(xt + ymask * xt) + yt];
+			}
+		}
+	}
+	else
+	{
+		// should never happen, just in case...
+		memcpy(Pixels, source, width*height * sizeof(TYPE));
+	}
+}
+
+
+//==========================================================================
+//
+// Warp type 1 shifts every row sideways and then every column vertically.
+// Both shifts are folded into one lookup: for texel x of a row the
+// source is offset[y] + x * height, minus width * height once x reaches
+// limit[y], the column at which the row wraps around.
+//
+//==========================================================================
+
+static void WarpColumn1_C(int *dest, const int *offset, const int *limit, int count, int x, int xh, int wh)
+{
+	for (int i = 0; i < count; i++)
+	{
+		dest[i] = offset[i] + xh - (x >= limit[i] ? wh : 0);
+	}
+}
+
+#ifndef NO_SSE
+static void WarpColumn1_SSE2(int *dest, const int *offset, const int *limit, int count, int x, int xh, int wh)
+{
+	const __m128i vx = _mm_set1_epi32(x);
+	const __m128i vxh = _mm_set1_epi32(xh);
+	const __m128i vwh = _mm_set1_epi32(wh);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i nowrap = _mm_cmplt_epi32(vx, _mm_loadu_si128((const __m128i *)(limit + i)));
+		__m128i index = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(offset + i)), vxh);
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_sub_epi32(index, _mm_andnot_si128(nowrap, vwh)));
+	}
+	WarpColumn1_C(dest + i, offset + i, limit + i, count - i, x, xh, wh);
+}
+#endif
+
+static void WarpIndices1(int *indices, int width, int height, int xmul, int ymul, uint64_t time, float Speed, bool sse2)
+{
+	const int wh = width * height;
+	TArray<int> offset(height, true), limit(height, true);
+
+	unsigned timebase = unsigned(time * Speed * 32 / 28);
+	for (int y = 0; y < height; y++)
+	{
+		int xf = (TexMan.sintable[((timebase + y*ymul) >> 2)&TexMan.SINMASK] >> 11) % width;
+		if (xf < 0) xf += width;
+		offset[y] = xf * height + y;
+		limit[y] = width - xf;
+	}
+
+	auto column = sse2 ? WarpColumn1_SSE2 : WarpColumn1_C;
+	for (int x = 0; x < width; x++)
+	{
+		int yf = (TexMan.sintable[((time + (x + 17)*xmul) >> 2)&TexMan.SINMASK] >> 11) % height;
+		if (yf < 0) yf += height;
+
+		int *dest = indices + x * height;
+		column(dest, &offset[yf], &limit[yf], height - yf, x, x * height, wh);
+		column(dest + height - yf, &offset[0], &limit[0], yf, x, x * height, wh);
+	}
+}
+
+//==========================================================================
+//
+// Warp type 2 adds two sines to each coordinate, one depending on x and
+// one on y, so all sine lookups can be done up front. The sines are at
+// most 2 in either direction, so a single wraparound is enough once the
+// rest has been reduced modulo the size.
+//
+//==========================================================================
+
+struct FWarpRows2
+{
+	const int *xsine, *xsineh, *ybase;
+};
+
+static void WarpColumn2_C(int *dest, const FWarpRows2 &rows, int count, int xbase, int width, int height)
+{
+	const int xbaseh = xbase * height;
+	const int wh = width * height;
+	for (int i = 0; i < count; i++)
+	{
+		int xt = xbase + rows.xsine[i];
+		int index = xbaseh + rows.xsineh[i];
+		if (xt < 0) index += wh;
+		else if (xt >= width) index -= wh;
+
+		int yt = rows.ybase[i];
+		if (yt < 0) yt += height;
+		else if (yt >= height) yt -= height;
+		dest[i] = index + yt;
+	}
+}
+
+#ifndef NO_SSE
+static void WarpColumn2_SSE2(int *dest, const FWarpRows2 &rows, int count, int xbase, int width, int height)
+{
+	const __m128i vxbase = _mm_set1_epi32(xbase);
+	const __m128i vxbaseh = _mm_set1_epi32(xbase * height);
+	const __m128i vwh = _mm_set1_epi32(width * height);
+	const __m128i vwidth = _mm_set1_epi32(width - 1);
+	const __m128i vheight = _mm_set1_epi32(height);
+	const __m128i vheightm1 = _mm_set1_epi32(height - 1);
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i xt = _mm_add_epi32(vxbase, _mm_loadu_si128((const __m128i *)(rows.xsine + i)));
+		__m128i index = _mm_add_epi32(vxbaseh, _mm_loadu_si128((const __m128i *)(rows.xsineh + i)));
+		index = _mm_add_epi32(index, _mm_and_si128(_mm_cmplt_epi32(xt, zero), vwh));
+		index = _mm_sub_epi32(index, _mm_and_si128(_mm_cmpgt_epi32(xt, vwidth), vwh));
+
+		__m128i yt = _mm_loadu_si128((const __m128i *)(rows.ybase + i));
+		yt = _mm_add_epi32(yt, _mm_and_si128(_mm_cmplt_epi32(yt, zero), vheight));
+		yt = _mm_sub_epi32(yt, _mm_and_si128(_mm_cmpgt_epi32(yt, vheightm1), vheight));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_add_epi32(index, yt));
+	}
+	FWarpRows2 rest = { rows.xsine + i, rows.xsineh + i, rows.ybase + i };
+	WarpColumn2_C(dest + i, rest, count - i, xbase, width, height);
+}
+#endif
+
+static void WarpIndices2(int *indices, int width, int height, int xmul, int ymul, uint64_t time, float Speed, bool sse2)
+{
+	TArray<int> xsine(height, true), xsineh(height, true), ybase(height, true), yrow(height, true);
+
+	unsigned timebase = unsigned(time * Speed * 40 / 28);
+	for (int y = 0; y < height; y++)
+	{
+		xsine[y] = TexMan.sintable[((y*ymul + timebase * 5 + 900) >> 2) & TexMan.SINMASK] >> 13;
+		xsineh[y] = xsine[y] * height;
+		yrow[y] = (y + 128 + (TexMan.sintable[((y*ymul + timebase * 3 + 700) >> 2) & TexMan.SINMASK] >> 13)) % height;
+	}
+
+	auto column = sse2 ? WarpColumn2_SSE2 : WarpColumn2_C;
+	for (int x = 0; x < width; x++)
+	{
+		int xbase = (x + 128 + (TexMan.sintable[((x*xmul + timebase * 4 + 300) >> 2) & TexMan.SINMASK] >> 13)) % width;
+		int ysine = TexMan.sintable[((x*xmul + timebase * 4 + 1200) >> 2) & TexMan.SINMASK] >> 13;
+		for (int y = 0; y < height; y++)
+		{
+			ybase[y] = yrow[y] + ysine;
+		}
+		FWarpRows2 rows = { &xsine[0], &xsineh[0], &ybase[0] };
+		column(indices + x * height, rows, height, xbase, width, height);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void GetWarpIndices(int *indices, int width, int height, int xmul, int ymul, uint64_t time, float Speed, int warptype)
+{
+	bool sse2 = false;
+#ifndef NO_SSE
+	sse2 = !!CPU.bSSE2;
+#endif
+
+	if (warptype == 1 && width >= 4 && height >= 4)
+	{
+		WarpIndices1(indices, width, height, xmul, ymul, time, Speed, sse2);
+	}
+	else if (warptype == 2 && width >= 4 && height >= 4)
+	{
+		WarpIndices2(indices, width, height, xmul, ymul, time, Speed, sse2);
+	}
+	else
+	{
+		TArray<int> identity(width * height, true);
+		for (int i = 0; i < width * height; i++)
+		{
+			identity[i] = i;
+		}
+		WarpBufferC(indices, &identity[0], width, height, xmul, ymul, time, Speed, warptype);
+	}
+}
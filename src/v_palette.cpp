@@ -97,9 +97,17 @@ CCMD (bumpgamma)
 /* Palette management stuff */
 /****************************/
 
+int BestColor_SSE2 (const PalEntry *pal, int r, int g, int b, int first, int num);
+
 int BestColor (const uint32_t *pal_in, int r, int g, int b, int first, int num)
 {
 	const PalEntry *pal = (const PalEntry *)pal_in;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__i386__) || defined(__amd64__)
+	if (num - first >= 8 && ((r | g | b) & ~255) == 0)
+	{
+		return BestColor_SSE2 (pal, r, g, b, first, num);
+	}
+#endif
 	int bestcolor = first;
 	int bestdist = 257 * 257 + 257 * 257 + 257 * 257;
 
@@ -1429,6 +1429,20 @@ void V_Init2()
 	setsizeneeded = true;
 }
 
+//
+// V_InitHeadless
+//
+// Used instead of V_Init2 when nothing will be shown. The frame buffer
+// from V_Init stays, so no window or video device is opened, and only
+// rendering into canvases works.
+//
+
+void V_InitHeadless()
+{
+	FBaseCVar::ResetColors ();
+	V_OutputResized (screen->GetWidth(), screen->GetHeight());
+}
+
 void V_Shutdown()
 {
 	if (screen)
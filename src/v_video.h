@@ -543,6 +543,9 @@ void V_Init (bool restart);
 // Initializes graphics mode for the first time.
 void V_Init2 ();
 
+// Skips the graphics mode setup for programs that only render offscreen.
+void V_InitHeadless ();
+
 void V_Shutdown ();
 
 class FScanner;
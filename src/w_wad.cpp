@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <atomic>
 
 #include "doomtype.h"
 #include "m_argv.h"
@@ -1336,6 +1337,8 @@ DEFINE_ACTION_FUNCTION(_Wads, ReadLump)
 	ACTION_RETURN_STRING(isLumpValid ? Wads.ReadLump(lump).GetString() : FString());
 }
 
+static std::atomic<int> ThreadedAccess;
+
 //==========================================================================
 //
 // OpenLumpReader
@@ -1353,6 +1356,10 @@ FileReader FWadCollection::OpenLumpReader(int lump)
 	}
 
 	auto rl = LumpInfo[lump].lump;
+	if (ThreadedAccess > 0)
+	{
+		return rl->NewReader();
+	}
 	auto rd = rl->GetReader();
 
 	if (rl->RefCount == 0 && rd != nullptr && !rd->GetBuffer() && !(rl->Flags & (LUMPF_BLOODCRYPT | LUMPF_COMPRESSED)))
@@ -1387,6 +1394,26 @@ FileReader FWadCollection::ReopenLumpReader(int lump, bool alwayscache)
 	return rl->NewReader();	// This always gets a reader to the cache
 }
 
+//==========================================================================
+//
+// BeginThreadedAccess / EndThreadedAccess
+//
+// Lump caching is serialized, so reading through the cache is safe from
+// any thread. The direct readers returned by OpenLumpReader all share
+// their resource file's reader and its position.
+//
+//==========================================================================
+
+void FWadCollection::BeginThreadedAccess()
+{
+	ThreadedAccess++;
+}
+
+void FWadCollection::EndThreadedAccess()
+{
+	ThreadedAccess--;
+}
+
 //==========================================================================
 //
 // GetFileReader
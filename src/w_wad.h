@@ -154,6 +154,11 @@ public:
 	FileReader OpenLumpReader(int lump);		// opens a reader that redirects to the containing file's one.
 	FileReader ReopenLumpReader(int lump, bool alwayscache = false);		// opens an independent reader.
 
+	// While worker threads are reading lumps, all lump readers go through
+	// the lump cache instead of the resource files' shared file readers.
+	void BeginThreadedAccess();
+	void EndThreadedAccess();
+
 	int FindLump (const char *name, int *lastlump, bool anyns=false);		// [RH] Find lumps with duplication
 	int FindLumpMulti (const char **names, int *lastlump, bool anyns = false, int *nameindex = NULL); // same with multiple possible names
 	bool CheckLumpName (int lump, const char *name);	// [RH] True if lump's name == name
@@ -65,16 +65,31 @@ void DumpCPUInfo(const CPUInfo *cpu)
 						 "xchgl\t%%ebx, %1\n\t" \
 		: "=a" ((output)[0]), "=r" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) \
 		: "a" (func));
+#define __cpuidex(output, func, subfunc) \
+	__asm__ __volatile__("xchgl\t%%ebx, %1\n\t" \
+						 "cpuid\n\t" \
+						 "xchgl\t%%ebx, %1\n\t" \
+		: "=a" ((output)[0]), "=r" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) \
+		: "a" (func), "c" (subfunc));
 #else
 #define __cpuid(output, func) __asm__ __volatile__("cpuid" : "=a" ((output)[0]),\
 	"=b" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) : "a" (func));
+#define __cpuidex(output, func, subfunc) __asm__ __volatile__("cpuid" : "=a" ((output)[0]),\
+	"=b" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) : "a" (func), "c" (subfunc));
 #endif
+
+static inline uint64_t _xgetbv(unsigned int index)
+{
+	uint32_t eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (index));
+	return ((uint64_t)edx << 32) | eax;
+}
 #endif
 
 void CheckCPUID(CPUInfo *cpu)
 {
 	int foo[4];
-	unsigned int maxext;
+	unsigned int maxbasic, maxext;
 
 	memset(cpu, 0, sizeof(*cpu));
 
@@ -126,6 +141,7 @@ haveid:
 
 	// Get vendor ID
 	__cpuid(foo, 0);
+	maxbasic = (unsigned int)foo[0];
 	cpu->dwVendorID[0] = foo[1];
 	cpu->dwVendorID[1] = foo[3];
 	cpu->dwVendorID[2] = foo[2];
@@ -144,6 +160,18 @@ haveid:
 
 	cpu->HyperThreading = (foo[3] & (1 << 28)) > 0;
 
+	// AVX is only usable if the OS saves the YMM registers on context switches.
+	if (cpu->bAVX && !(cpu->bOSXSAVE && (_xgetbv(0) & 6) == 6))
+	{
+		cpu->bAVX = 0;
+	}
+	if (cpu->bAVX && maxbasic >= 7)
+	{
+		int foo7[4];
+		__cpuidex(foo7, 7, 0);
+		cpu->bAVX2 = (foo7[1] & (1 << 5)) > 0;
+	}
+
 	// If CLFLUSH instruction is supported, get the real cache line size.
 	if (foo[3] & (1 << 19))
 	{
@@ -250,6 +278,8 @@ void DumpCPUInfo(const CPUInfo *cpu)
 		if (cpu->bSSSE3)		Printf(" SSSE3");
 		if (cpu->bSSE41)		Printf(" SSE4.1");
 		if (cpu->bSSE42)		Printf(" SSE4.2");
+		if (cpu->bAVX)			Printf(" AVX");
+		if (cpu->bAVX2)			Printf(" AVX2");
 		if (cpu->b3DNow)		Printf(" 3DNow!");
 		if (cpu->b3DNowPlus)	Printf(" 3DNow!+");
 		if (cpu->HyperThreading)	Printf(" HyperThreading");
@@ -334,4 +364,65 @@ void DoBlending_SSE2(const PalEntry *from, PalEntry *to, int count, int r, int g
 		}
 	}
 }
+
+// Same result as BestColor: the first of the closest colors in [first, num).
+// r, g and b must be in the 0-255 range.
+int BestColor_SSE2(const PalEntry *pal, int r, int g, int b, int first, int num)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgbmask = _mm_set1_epi32(0xffffff);
+	const __m128i query = _mm_unpacklo_epi8(_mm_set1_epi32((r << 16) | (g << 8) | b), zero);
+	const __m128i four = _mm_set1_epi32(4);
+	__m128i index = _mm_setr_epi32(first, first + 1, first + 2, first + 3);
+	__m128i bestdist = _mm_set1_epi32(0x7fffffff);
+	__m128i bestindex = zero;
+	int color;
+
+	// Each lane keeps the first closest color of every fourth palette entry.
+	for (color = first; color + 4 <= num; color += 4)
+	{
+		__m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i *)(pal + color)), rgbmask);
+		__m128i d0 = _mm_sub_epi16(_mm_unpacklo_epi8(c, zero), query);
+		__m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(c, zero), query);
+		d0 = _mm_madd_epi16(d0, d0);	// b*b+g*g, r*r of two colors
+		d1 = _mm_madd_epi16(d1, d1);
+		__m128 s0 = _mm_castsi128_ps(d0), s1 = _mm_castsi128_ps(d1);
+		__m128i dist = _mm_add_epi32(
+			_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))),
+			_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+		__m128i better = _mm_cmplt_epi32(dist, bestdist);
+		bestdist = _mm_or_si128(_mm_and_si128(better, dist), _mm_andnot_si128(better, bestdist));
+		bestindex = _mm_or_si128(_mm_and_si128(better, index), _mm_andnot_si128(better, bestindex));
+		index = _mm_add_epi32(index, four);
+	}
+
+	int dists[4], indices[4];
+	_mm_storeu_si128((__m128i *)dists, bestdist);
+	_mm_storeu_si128((__m128i *)indices, bestindex);
+
+	int bestcolor = first;
+	int best = 257 * 257 + 257 * 257 + 257 * 257;
+	for (int i = 0; i < 4; i++)
+	{
+		if (dists[i] < best || (dists[i] == best && indices[i] < bestcolor))
+		{
+			best = dists[i];
+			bestcolor = indices[i];
+		}
+	}
+	for (; color < num; color++)
+	{
+		int x = r - pal[color].r;
+		int y = g - pal[color].g;
+		int z = b - pal[color].b;
+		int dist = x*x + y*y + z*z;
+		if (dist < best)
+		{
+			best = dist;
+			bestcolor = color;
+		}
+	}
+	return bestcolor;
+}
 #endif